@@ -0,0 +1,455 @@
+// jrisc_bench: reproducible synthetic workloads for the interpreter, the memory accessors and the disassembler.
+// Every workload is generated from a fixed seed, loaded through Debugger::loadBin() and run with
+// Debugger::execute() for a fixed instruction budget, so two builds can be compared run for run. The throughput
+// workloads run with the idle loop skip off; the polling loop runs with it unless --no-idle-skip, and is then
+// reported as poll_idle_skip since its rate measures the fast-forward.
+//
+// Usage: jrisc_bench [--json] [--iterations N] [--budget INSTRUCTIONS] [--image-size BYTES] [--filter NAME] [--shadow] [--coverage] [--mix] [--no-idle-skip]
+#include <QApplication>
+#include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "debugger.h"
+#include "version.h"
+
+namespace {
+
+// Jaguar RISC registers used by the workloads
+const int G_FLAGS = 0xF02100;
+const int G_MTXC = 0xF02104;
+const int G_MTXA = 0xF02108;
+const int G_RAM = 0xF03000;
+const int DRAM_BUFFER = 0x100000;
+const int CODE_ADDRESS = 0x4000;
+
+// Deterministic generator, identical on every platform and compiler
+class XorShift {
+public:
+    explicit XorShift(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+
+private:
+    uint32_t state;
+};
+
+// Minimal JRISC assembler, enough to build the synthetic loops
+class Program {
+public:
+    explicit Program(int origin) : origin(origin) {}
+
+    int here() const { return origin + static_cast<int>(bytes.size()); }
+    void op(int opcode, int reg1, int reg2) { word(static_cast<uint16_t>((opcode << 10) | ((reg1 & 31) << 5) | (reg2 & 31))); }
+    // movei: the debugger reads the low word first
+    void movei(uint32_t value, int reg) {
+        op(38, 0, reg);
+        word(static_cast<uint16_t>(value & 0xFFFF));
+        word(static_cast<uint16_t>(value >> 16));
+    }
+    // jr to an absolute target, offset counted from the word following the jr
+    void jr(int condition, int target) {
+        int offset = (target - (here() + 2)) / 2;
+        op(53, offset & 31, condition);
+    }
+    void nop() { op(57, 0, 0); }
+    void word(uint16_t w) {
+        bytes.push_back(static_cast<uint8_t>(w >> 8));
+        bytes.push_back(static_cast<uint8_t>(w & 0xFF));
+    }
+    const std::vector<uint8_t>& data() const { return bytes; }
+
+private:
+    int origin;
+    std::vector<uint8_t> bytes;
+};
+
+enum Opcode {
+    ADD = 0, ADDQ = 2, SUB = 4, SUBQ = 6, AND = 9, OR = 10, XOR = 11, BTST = 13, IMULT = 17, IMULTN = 18, RESMAC = 19, IMACN = 20,
+    SHLQ = 24, SHRQ = 25, CMPQ = 31, MOVE = 34, MOVETA = 36, MOVEI = 38, LOAD = 41,
+    JUMP = 52, JR = 53, MMULT = 54, LOAD_R14_RN = 58, STORE_R14_RN = 60, NOP = 57, STORE = 47
+};
+const int CC_T = 0, CC_NE = 1, CC_EQ = 2;
+
+// Result of one workload
+struct Result {
+    QString name;
+    QString unit;
+    uint64_t work = 0;          // instructions, memory operations or listing lines per iteration
+    uint64_t instructions = 0;
+    std::vector<double> seconds;
+};
+
+// Write the program to a temporary file and load it like a user would
+bool LoadProgram(Debugger& debugger, QTemporaryFile& file, const std::vector<uint8_t>& bytes, int address) {
+    if (!file.open())
+        return false;
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<qint64>(bytes.size()));
+    file.flush();
+    file.close();
+    if (!debugger.loadBin(file.fileName(), address))
+        return false;
+    debugger.reset();
+    return true;
+}
+
+// Loop closing sequence: jump back through r10, nop in the delay slot
+void CloseLoop(Program& p) {
+    p.op(JUMP, 10, CC_T);
+    p.nop();
+}
+
+// ALU-heavy loop: arithmetic, logic, shifts and multiplies with flag updates
+Program AluLoop(XorShift& rng) {
+    Program p(CODE_ADDRESS);
+    for (int r = 1; r < 10; ++r)
+        p.movei(rng.next(), r);
+    int loop = p.here() + 6;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    static const int alu[] = { ADD, SUB, AND, OR, XOR, IMULT, ADD, SUB };
+    for (int i = 0; i < 48; ++i) {
+        int kind = rng.below(10);
+        int a = 1 + rng.below(9), b = 1 + rng.below(9);
+        if (kind < 8)
+            p.op(alu[kind], a, b);
+        else if (kind == 8)
+            p.op(ADDQ + 4 * static_cast<int>(rng.below(2)), 1 + rng.below(31), b);
+        else
+            p.op(SHLQ + static_cast<int>(rng.below(2)), 1 + rng.below(31), b);
+    }
+    CloseLoop(p);
+    return p;
+}
+
+// Load/store stream through r14+rn over a 2KB window at 'buffer'; 8 memory operations per iteration
+Program MemoryLoop(int buffer, uint64_t& memoryOpsPerLoop, uint64_t& instructionsPerLoop) {
+    Program p(CODE_ADDRESS);
+    p.movei(static_cast<uint32_t>(buffer), 14);
+    p.movei(0x7FC, 5);                        // offset mask
+    p.movei(0x12345678, 2);
+    p.op(XOR, 4, 4);                          // r4 = 0
+    int loop = p.here() + 6;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    for (int i = 0; i < 4; ++i) {
+        p.op(STORE_R14_RN, 4, 2);
+        p.op(LOAD_R14_RN, 4, 3);
+        p.op(ADDQ, 4, 4);
+        p.op(AND, 5, 4);
+    }
+    CloseLoop(p);
+    memoryOpsPerLoop = 8;
+    instructionsPerLoop = 4 * 4 + 2;
+    return p;
+}
+
+// Branch-heavy code: short taken and not-taken jr with useful delay slots
+Program BranchLoop(XorShift& rng) {
+    Program p(CODE_ADDRESS);
+    p.op(XOR, 1, 1);
+    int loop = p.here() + 6;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    for (int i = 0; i < 12; ++i) {
+        p.op(ADDQ, 1, 1);
+        p.op(BTST, rng.below(3), 1);
+        int skip = p.here() + 6;
+        p.jr(rng.below(2) ? CC_EQ : CC_NE, skip);
+        p.op(ADDQ, 1, 2);                     // delay slot, always executed
+        p.op(ADDQ, 1, 3);                     // skipped when the branch is taken
+    }
+    CloseLoop(p);
+    return p;
+}
+
+// movei-dense code: every other instruction carries a 32-bit immediate
+Program MoveiLoop(XorShift& rng) {
+    Program p(CODE_ADDRESS);
+    int loop = p.here() + 6;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    for (int i = 0; i < 24; ++i) {
+        int r = 1 + rng.below(9);
+        p.movei(rng.next(), r);
+        p.op(ADD, r, 1 + rng.below(9));
+    }
+    CloseLoop(p);
+    return p;
+}
+
+// Register bank switching: each store to G_FLAGS flips REGPAGE, so the loop alternates banks
+Program BankSwitchLoop() {
+    Program p(CODE_ADDRESS);
+    p.movei(G_FLAGS, 20);
+    p.movei(0x4000, 21);                      // REGPAGE set: switch to bank 1
+    p.op(XOR, 22, 22);
+    p.op(MOVETA, 20, 20);                     // bank 1 gets the same G_FLAGS pointer
+    p.op(MOVETA, 22, 21);                     // and stores 0 to come back to bank 0
+    int loop = p.here() + 6 + 2;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    p.op(MOVETA, 10, 10);                     // loop address valid in both banks
+    for (int i = 0; i < 8; ++i) {
+        p.op(STORE, 20, 21);
+        p.op(ADDQ, 1, 1);
+    }
+    CloseLoop(p);
+    return p;
+}
+
+// Polling loop on a DRAM word nothing writes, the case the idle loop detection fast-forwards
+Program PollLoop() {
+    Program p(CODE_ADDRESS);
+    p.movei(DRAM_BUFFER, 20);
+    int loop = p.here();
+    p.op(LOAD, 20, 21);
+    p.op(CMPQ, 0, 21);
+    p.jr(CC_EQ, loop);
+    p.nop();
+    return p;
+}
+
+// Transform kernel: 4x4 matrix in GPU RAM times the vectors packed in bank 1, plus a MAC dot product
+Program MatrixLoop(XorShift& rng) {
+    Program p(CODE_ADDRESS);
+    p.movei(G_MTXC, 20);
+    p.movei(4, 21);                           // 4 elements, row stepping
+    p.op(STORE, 20, 21);
+    p.movei(G_MTXA, 20);
+    p.movei(G_RAM + 0x800, 21);
+    p.op(STORE, 20, 21);
+    for (int r = 1; r < 10; ++r) {
+        p.movei(rng.next(), r);
+        p.op(MOVETA, r, r);
+    }
+    int loop = p.here() + 6;
+    p.movei(static_cast<uint32_t>(loop), 10);
+    for (int i = 0; i < 8; ++i) {
+        p.op(MMULT, 1 + 2 * rng.below(4), 11 + rng.below(4));
+        p.op(IMULTN, 1 + rng.below(9), 1 + rng.below(9));
+        p.op(IMACN, 1 + rng.below(9), 1 + rng.below(9));
+        p.op(RESMAC, 0, 15);
+    }
+    CloseLoop(p);
+    return p;
+}
+
+// Random but decodable image for the disassembler
+std::vector<uint8_t> RandomImage(XorShift& rng, int size) {
+    Program p(DRAM_BUFFER);
+    p.nop();                                  // never looks like an object file header
+    while (static_cast<int>(p.data().size()) + 6 <= size) {
+        int opcode = rng.below(64);
+        if (opcode == MOVEI)
+            p.movei(rng.next(), rng.below(32));
+        else
+            p.op(opcode, rng.below(32), rng.below(32));
+    }
+    return p.data();
+}
+
+// Time 'iterations' runs of 'budget' instructions of an already loaded program
+bool TimeExecution(Debugger& debugger, Result& result, int iterations, uint64_t budget) {
+    for (int i = 0; i < iterations; ++i) {
+        debugger.reset();
+        QElapsedTimer timer;
+        timer.start();
+        uint64_t executed = debugger.execute(budget);
+        qint64 ns = timer.nsecsElapsed();
+        if (executed != budget) {
+            std::fprintf(stderr, "%s: stopped after %llu instructions\n", qPrintable(result.name),
+                         static_cast<unsigned long long>(executed));
+            return false;
+        }
+        result.seconds.push_back(ns / 1e9);
+    }
+    result.instructions = budget;
+    return true;
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    bool json = false;
+    int iterations = 5;
+    uint64_t budget = 2000000;
+    int imageSize = 4 * 1024 * 1024;
+    QString filter;
+    bool shadow = false;
+    bool coverage = false;
+    bool mix = false;
+    bool idleSkip = true;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--json")
+            json = true;
+        else if ((args[i] == "--iterations") && (i + 1 < args.size()))
+            iterations = std::max(1, args[++i].toInt());
+        else if ((args[i] == "--budget") && (i + 1 < args.size()))
+            budget = std::max(1ULL, args[++i].toULongLong());
+        else if ((args[i] == "--image-size") && (i + 1 < args.size()))
+            imageSize = std::max(1024, args[++i].toInt());
+        else if ((args[i] == "--filter") && (i + 1 < args.size()))
+            filter = args[++i];
+        else if (args[i] == "--shadow")
+            shadow = true;
+        else if (args[i] == "--coverage")
+            coverage = true;
+        else if (args[i] == "--mix")
+            mix = true;
+        else if (args[i] == "--no-idle-skip")
+            idleSkip = false;
+        else {
+            std::fprintf(stderr, "Usage: jrisc_bench [--json] [--iterations N] [--budget INSTRUCTIONS] "
+                                 "[--image-size BYTES] [--filter NAME] [--shadow] [--coverage] [--mix] [--no-idle-skip]\n");
+            return 2;
+        }
+    }
+
+    Debugger debugger;
+    debugger.setGPUMode(true);
+    debugger.setMemoryWarningEnabled(true);   // suppress the local RAM access dialogs
+    if (shadow) {
+        debugger.setShadowCheck(true);        // cost of the checker mode
+        debugger.setInteractive(false);
+    }
+    debugger.setCoverage(coverage);
+    debugger.setInstructionMix(mix);
+    std::vector<Result> results;
+    bool ok = true;
+
+    // Interpreter workloads, instructions per second
+    struct Workload { const char* name; Program (*build)(XorShift&); bool idle; };
+    const Workload workloads[] = {
+        { "alu", AluLoop, false },
+        { "branch", BranchLoop, false },
+        { "movei", MoveiLoop, false },
+        { "matrix", MatrixLoop, false },
+        { "bank_switch", [](XorShift&) { return BankSwitchLoop(); }, false },
+        { "poll", [](XorShift&) { return PollLoop(); }, true },
+    };
+    for (const Workload& w : workloads) {
+        if (!filter.isEmpty() && !QString(w.name).contains(filter))
+            continue;
+        XorShift rng(0xC0FFEE);
+        Program p = w.build(rng);
+        QTemporaryFile file;
+        Result r;
+        bool skip = idleSkip && w.idle;
+        debugger.setIdleSkip(skip);
+        r.name = skip ? QString(w.name) + "_idle_skip" : QString(w.name);
+        r.unit = "instructions";
+        r.work = budget;
+        ok = LoadProgram(debugger, file, p.data(), CODE_ADDRESS) && TimeExecution(debugger, r, iterations, budget) && ok;
+        results.push_back(r);
+    }
+
+    // Memory path, ns per memory operation
+    debugger.setIdleSkip(false);
+    const struct { const char* name; int buffer; } streams[] = { { "mem_gpu_ram", G_RAM + 0x800 }, { "mem_dram", DRAM_BUFFER } };
+    for (const auto& s : streams) {
+        if (!filter.isEmpty() && !QString(s.name).contains(filter))
+            continue;
+        uint64_t memoryOps = 0, loopInstructions = 0;
+        Program p = MemoryLoop(s.buffer, memoryOps, loopInstructions);
+        QTemporaryFile file;
+        Result r;
+        r.name = s.name;
+        r.unit = "memory_ops";
+        ok = LoadProgram(debugger, file, p.data(), CODE_ADDRESS) && TimeExecution(debugger, r, iterations, budget) && ok;
+        r.work = budget / loopInstructions * memoryOps;
+        results.push_back(r);
+    }
+
+    // Disassembler, listing lines per second
+    if (filter.isEmpty() || QString("disassemble").contains(filter)) {
+        XorShift rng(0xD15A5);
+        std::vector<uint8_t> image = RandomImage(rng, imageSize);
+        QTemporaryFile file;
+        Result r;
+        r.name = "disassemble";
+        r.unit = "lines";
+        if (LoadProgram(debugger, file, image, DRAM_BUFFER)) {
+            for (int i = 0; i < iterations; ++i) {
+                QElapsedTimer timer;
+                timer.start();
+                QStringList lines = debugger.disassemble(DRAM_BUFFER, static_cast<int>(image.size()));
+                r.seconds.push_back(timer.nsecsElapsed() / 1e9);
+                r.work = static_cast<uint64_t>(lines.size());
+            }
+        }
+        else {
+            ok = false;
+        }
+        results.push_back(r);
+    }
+
+    QJsonArray jsonResults;
+    QTextStream out(stdout);
+    if (!json)
+        out << "jrisc_bench " << APP_VERSION << ", " << iterations << " iterations, median\n";
+    for (const Result& r : results) {
+        double seconds = Median(r.seconds);
+        double rate = (seconds > 0) ? r.work / seconds : 0.0;
+        double nsPerOp = (r.work > 0) ? seconds * 1e9 / r.work : 0.0;
+        double ips = (seconds > 0) ? r.instructions / seconds : 0.0;
+        if (json) {
+            QJsonObject o;
+            o["name"] = r.name;
+            o["unit"] = r.unit;
+            o["work"] = static_cast<double>(r.work);
+            o["seconds_median"] = seconds;
+            o["per_second"] = rate;
+            o["ns_per_unit"] = nsPerOp;
+            if (r.instructions)
+                o["instructions_per_second"] = ips;
+            QJsonArray samples;
+            for (double s : r.seconds)
+                samples.append(s);
+            o["samples"] = samples;
+            jsonResults.append(o);
+        }
+        else {
+            out << QString("%1 %2 %3/s  %4 ns/%5")
+                       .arg(r.name, -14)
+                       .arg(QString::number(rate / 1e6, 'f', 2), 10)
+                       .arg("M" + r.unit)
+                       .arg(QString::number(nsPerOp, 'f', 2), 8)
+                       .arg(r.unit == "memory_ops" ? "memory op" : r.unit.left(r.unit.size() - 1));
+            if (r.instructions && (r.unit != "instructions"))
+                out << QString("  (%1 MIPS)").arg(QString::number(ips / 1e6, 'f', 2));
+            out << "\n";
+        }
+    }
+    if (json) {
+        QJsonObject root;
+        root["version"] = QString(APP_VERSION);
+        root["iterations"] = iterations;
+        root["budget"] = static_cast<double>(budget);
+        root["image_size"] = imageSize;
+        root["shadow"] = shadow;
+        root["coverage"] = coverage;
+        root["mix"] = mix;
+        root["idle_skip"] = idleSkip;
+        root["results"] = jsonResults;
+        out << QJsonDocument(root).toJson();
+    }
+    out.flush();
+    return ok ? 0 : 1;
+}
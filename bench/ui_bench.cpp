@@ -0,0 +1,200 @@
+// ui_bench: latency of the main window paths engineers wait on, under the Qt offscreen platform. A synthetic image
+// of each size is loaded through MainWindow::loadBin(), then the views are refreshed with updateUI() and the
+// program is stepped through the onStep() slot. Every sample includes the events the call posted (layout and
+// painting of the offscreen window), and the report gives the p50 and p99 of each path per program size. Each
+// refresh rebuilds the whole code view, so the default sizes finish in seconds; --large adds 100k and 1M.
+//
+// Usage: ui_bench [--json] [--iterations N] [--loads N] [--sizes INSTRUCTIONS,...] [--large]
+#include <QApplication>
+#include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "mainwindow.h"
+#include "version.h"
+
+namespace {
+
+const int CODE_ADDRESS = 0x4000;
+
+// Deterministic generator, identical on every platform and compiler
+class XorShift {
+public:
+    explicit XorShift(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+
+private:
+    uint32_t state;
+};
+
+void Word(std::vector<uint8_t>& bytes, uint16_t w) {
+    bytes.push_back(static_cast<uint8_t>(w >> 8));
+    bytes.push_back(static_cast<uint8_t>(w & 0xFF));
+}
+
+void Op(std::vector<uint8_t>& bytes, int opcode, int reg1, int reg2) {
+    Word(bytes, static_cast<uint16_t>((opcode << 10) | ((reg1 & 31) << 5) | (reg2 & 31)));
+}
+
+// One loop of 'instructions' instructions: register-only ALU operations, so stepping never leaves the image,
+// touches memory or raises a diagnostic, then a jump back through r10
+std::vector<uint8_t> Image(int instructions) {
+    enum { ADD = 0, ADDQ = 2, SUB = 4, AND = 9, OR = 10, XOR = 11, SHLQ = 24, MOVEI = 38, JUMP = 52, NOP = 57 };
+    static const int alu[] = { ADD, SUB, AND, OR, XOR, ADD };
+    XorShift rng(0x0B1E55);
+    std::vector<uint8_t> bytes;
+    Op(bytes, NOP, 0, 0); // never looks like an object file header
+    int loop = CODE_ADDRESS + 2 + 6;
+    Op(bytes, MOVEI, 0, 10);
+    Word(bytes, static_cast<uint16_t>(loop & 0xFFFF));
+    Word(bytes, static_cast<uint16_t>(loop >> 16));
+    for (int i = 4; i < instructions; ++i) {
+        int kind = rng.below(8);
+        int a = 1 + rng.below(9), b = 1 + rng.below(9);
+        if (kind < 6)
+            Op(bytes, alu[kind], a, b);
+        else if (kind == 6)
+            Op(bytes, ADDQ, 1 + rng.below(31), b);
+        else
+            Op(bytes, SHLQ, 1 + rng.below(31), b);
+    }
+    Op(bytes, JUMP, 10, 0);
+    Op(bytes, NOP, 0, 0);
+    return bytes;
+}
+
+// Milliseconds of a call and of the events it posted
+template <typename Call>
+double Time(Call call) {
+    QElapsedTimer timer;
+    timer.start();
+    call();
+    QApplication::processEvents();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// Nearest-rank percentile
+double Percentile(std::vector<double> values, double p) {
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+    return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Samples of one path at one program size
+struct Result {
+    QString name;
+    int instructions;
+    std::vector<double> ms;
+};
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    bool json = false;
+    int iterations = 20;
+    int loads = 3;
+    std::vector<int> sizes = { 1000, 10000 };
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--json")
+            json = true;
+        else if ((args[i] == "--iterations") && (i + 1 < args.size()))
+            iterations = std::max(1, args[++i].toInt());
+        else if ((args[i] == "--loads") && (i + 1 < args.size()))
+            loads = std::max(1, args[++i].toInt());
+        else if ((args[i] == "--sizes") && (i + 1 < args.size())) {
+            sizes.clear();
+            for (const QString& size : args[++i].split(','))
+                sizes.push_back(std::max(16, size.toInt()));
+        }
+        else if (args[i] == "--large") {
+            sizes.push_back(100000);
+            sizes.push_back(1000000);
+        }
+        else {
+            std::fprintf(stderr, "Usage: ui_bench [--json] [--iterations N] [--loads N] [--sizes INSTRUCTIONS,...] [--large]\n");
+            return 2;
+        }
+    }
+
+    MainWindow window;
+    window.show();
+    QApplication::processEvents();
+    std::vector<Result> results;
+    bool ok = true;
+
+    for (int size : sizes) {
+        std::vector<uint8_t> image = Image(size);
+        QTemporaryFile file;
+        if (!file.open())
+            return 1;
+        file.write(reinterpret_cast<const char*>(image.data()), static_cast<qint64>(image.size()));
+        file.close();
+
+        Result load = { "load", size, {} }, update = { "update_ui", size, {} }, step = { "step", size, {} };
+        for (int i = 0; i < loads; ++i)
+            load.ms.push_back(Time([&] { ok = window.loadBin(file.fileName(), CODE_ADDRESS) && ok; }));
+        for (int i = 0; i < iterations; ++i)
+            update.ms.push_back(Time([&] { window.updateUI(); }));
+        for (int i = 0; i < iterations; ++i)
+            step.ms.push_back(Time([&] { QMetaObject::invokeMethod(&window, "onStep", Qt::DirectConnection); }));
+        results.push_back(load);
+        results.push_back(update);
+        results.push_back(step);
+    }
+
+    QJsonArray jsonResults;
+    QTextStream out(stdout);
+    if (!json)
+        out << "ui_bench " << APP_VERSION << ", " << loads << " loads, " << iterations << " refreshes and steps\n";
+    for (const Result& r : results) {
+        double p50 = Percentile(r.ms, 0.5), p99 = Percentile(r.ms, 0.99), max = Percentile(r.ms, 1.0);
+        if (json) {
+            QJsonObject o;
+            o["name"] = r.name;
+            o["instructions"] = r.instructions;
+            o["samples"] = static_cast<int>(r.ms.size());
+            o["p50_ms"] = p50;
+            o["p99_ms"] = p99;
+            o["max_ms"] = max;
+            jsonResults.append(o);
+        }
+        else {
+            out << QString("%1 %2 instructions  p50 %3 ms  p99 %4 ms  max %5 ms\n")
+                       .arg(r.name, -10)
+                       .arg(r.instructions, 8)
+                       .arg(QString::number(p50, 'f', 3), 9)
+                       .arg(QString::number(p99, 'f', 3), 9)
+                       .arg(QString::number(max, 'f', 3), 9);
+        }
+    }
+    if (json) {
+        QJsonObject root;
+        root["version"] = QString(APP_VERSION);
+        root["iterations"] = iterations;
+        root["loads"] = loads;
+        root["results"] = jsonResults;
+        out << QJsonDocument(root).toJson();
+    }
+    out.flush();
+    return ok ? 0 : 1;
+}
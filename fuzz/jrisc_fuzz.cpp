@@ -0,0 +1,707 @@
+// jrisc_fuzz: differential fuzzer for the instruction semantics.
+// Random instruction sequences and register/flag states are run through the production Debugger::step() path
+// and through the independent reference model below; registers, flags, PC, G_HIDATA/G_REMAIN and the scratch
+// memory must match bit for bit. Cases are generated and run in preallocated batches (no allocation in the
+// hot loop); a divergent case is minimized before it is reported.
+//
+// --dsp runs the DSP decode table instead of the GPU one.
+//
+// Usage: jrisc_fuzz [--cases N] [--seed S] [--max-length INSTRUCTIONS] [--dsp] [--keep-going]
+#include <QApplication>
+#include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
+#include "debugger.h"
+
+namespace {
+
+const int G_MTXC = 0xF02104;
+const int G_MTXA = 0xF02108;
+const int G_HIDATA = 0xF02118;
+const int G_REMAIN = 0xF0211C;
+const int D_MTXC = 0xF1A104;
+const int D_MTXA = 0xF1A108;
+const int D_MOD = 0xF1A118;
+const int D_REMAIN = 0xF1A11C;
+const int CODE_WINDOW = 0x8000;             // nop filled, the sequence starts at CODE_WINDOW + CODE_OFFSET
+const int CODE_WINDOW_SIZE = 0x400;
+const int CODE_OFFSET = 0x100;
+const int SCRATCH = 0x10000;                // every load and store stays in this window
+const int SCRATCH_SIZE = 0x200;             // small, so that loads and stores alias often
+const int MAX_INSTRUCTIONS = 16;
+const int BATCH_SIZE = 1024;
+const uint16_t NOP = 57 << 10;
+bool DSPMode = false;
+
+// Register roles: memory and jump operands use dedicated registers that the generated code never writes
+const int BASE_REGS[] = { 14, 15 };         // r14/r15 indexed addressing bases
+const int POINTER_REGS[] = { 20, 21, 22, 23 };
+const int OFFSET_REGS[] = { 24, 25 };
+const int JUMP_REG = 26;
+const int WRITABLE_REGS[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 16, 17, 18, 19, 27, 28, 29, 30, 31 };
+
+// Machine state compared after each case
+struct MachineState {
+    uint32_t regs[2][32];
+    uint32_t z, c, n;
+    uint32_t bank;
+    uint32_t pc;
+    uint32_t hidata, remain;
+    uint8_t scratch[SCRATCH_SIZE];
+};
+
+// One generated case: the instruction sequence and the initial state (scratch memory is shared by all cases)
+struct Instruction {
+    uint16_t word;
+    uint32_t immediate;                     // movei only
+};
+
+struct FuzzCase {
+    Instruction code[MAX_INSTRUCTIONS];
+    int count;
+    uint32_t regs[2][32];
+    uint32_t flags;                         // Z bit 0, C bit 1, N bit 2, REGPAGE bit 14
+    uint32_t hidata, remain;
+    uint32_t mtxc, mtxa;                    // mmult matrix, always inside the scratch window
+    uint32_t mod;                           // D_MOD mask of addqmod/subqmod
+};
+
+// Deterministic generator
+class XorShift {
+public:
+    explicit XorShift(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<uint32_t>(state >> 16);
+    }
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>((static_cast<uint64_t>(next()) * n) >> 32); }
+    template <size_t N> int pick(const int (&values)[N]) { return values[below(N)]; }
+
+private:
+    uint64_t state;
+};
+
+uint8_t InitialScratch[SCRATCH_SIZE];
+
+// Register values biased towards the flag and shift edges
+uint32_t RandomValue(XorShift& rng) {
+    static const uint32_t edges[] = { 0, 1, 2, 31, 32, 33, 0xFFFF, 0x8000, 0x7FFF, 0x10000, 0x7FFFFFFF, 0x80000000,
+                                      0x80000001, 0xFFFFFFFF, 0xFFFFFFFE, 0xFFFFFFE0, 0xFFFFFFDF, 0xFF, 0x100, 0xFFFFFF };
+    uint32_t r = rng.next();
+    switch (r & 3) {
+    case 0: return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+    case 1: return static_cast<uint32_t>(static_cast<int32_t>((r >> 2) & 127) - 64);
+    default: return rng.next();
+    }
+}
+
+// Generate an instruction of any implemented opcode with operands respecting the register roles
+Instruction RandomInstruction(XorShift& rng) {
+    static const int opcodes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+                                   26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+                                   47, 48, 49, 50, 51, 52, 53, 54, 57, 58, 59, 60, 61, 62, 63 };
+    int opcode = rng.pick(opcodes);
+    int reg1 = rng.below(32);
+    int reg2 = rng.pick(WRITABLE_REGS);
+    bool dspOnly = DSPMode && ((opcode == 42) || (opcode == 48)); // sat32s and mirror on the DSP
+    switch (dspOnly ? -1 : opcode) {
+    case 13: case 30: case 31:              // btst, cmp, cmpq only read reg2
+        reg2 = rng.below(32);
+        break;
+    case 39: case 40: case 41: case 42:     // loads through a pointer
+        reg1 = rng.pick(POINTER_REGS);
+        break;
+    case 45: case 46: case 47: case 48:     // stores through a pointer, any value
+        reg1 = rng.pick(POINTER_REGS);
+        reg2 = rng.below(32);
+        break;
+    case 49: case 50:
+        reg2 = rng.below(32);
+        break;
+    case 58: case 59:
+        reg1 = rng.pick(OFFSET_REGS);
+        break;
+    case 60: case 61:
+        reg1 = rng.pick(OFFSET_REGS);
+        reg2 = rng.below(32);
+        break;
+    case 52:                                // jump (r26), any condition code
+        reg1 = JUMP_REG;
+        reg2 = rng.below(32);
+        break;
+    case 53:                                // jr, any offset and condition code
+        reg2 = rng.below(32);
+        break;
+    case 57:
+        reg1 = reg2 = 0;
+        break;
+    }
+    Instruction i;
+    i.word = static_cast<uint16_t>((opcode << 10) | (reg1 << 5) | reg2);
+    i.immediate = (opcode == 38) ? RandomValue(rng) : 0;
+    return i;
+}
+
+void RandomCase(XorShift& rng, int maxLength, FuzzCase& fc) {
+    fc.count = 1 + rng.below(maxLength);
+    for (int i = 0; i < fc.count; ++i)
+        fc.code[i] = RandomInstruction(rng);
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int r = 0; r < 32; ++r)
+            fc.regs[bank][r] = RandomValue(rng);
+        for (int r : BASE_REGS)
+            fc.regs[bank][r] = SCRATCH + rng.below(SCRATCH_SIZE / 2);
+        for (int r : POINTER_REGS)
+            fc.regs[bank][r] = SCRATCH + rng.below(SCRATCH_SIZE - 8);
+        for (int r : OFFSET_REGS)
+            fc.regs[bank][r] = rng.below(SCRATCH_SIZE / 8) & ~3u;
+        fc.regs[bank][JUMP_REG] = CODE_WINDOW + (rng.below(CODE_WINDOW_SIZE / 2) & ~1u);
+    }
+    fc.flags = (rng.next() & 7) | ((rng.next() & 1) << 14);
+    fc.hidata = RandomValue(rng);
+    fc.remain = RandomValue(rng);
+    fc.mtxc = (1 + rng.below(8)) | (rng.below(2) << 4);    // 1 to 8 elements, row or column stepping
+    fc.mtxa = SCRATCH + (rng.below(SCRATCH_SIZE - 4 * 8 * 8) & ~3u);
+    fc.mod = (rng.next() & 1) ? (~0u << rng.below(32)) : RandomValue(rng);
+}
+
+// Write the sequence as the loader would place it; returns the number of bytes
+int EncodeCase(const FuzzCase& fc, uint8_t* dst) {
+    int size = 0;
+    auto put = [&](uint16_t w) {
+        dst[size++] = static_cast<uint8_t>(w >> 8);
+        dst[size++] = static_cast<uint8_t>(w & 0xFF);
+    };
+    for (int i = 0; i < fc.count; ++i) {
+        put(fc.code[i].word);
+        if ((fc.code[i].word >> 10) == 38) {
+            put(static_cast<uint16_t>(fc.code[i].immediate & 0xFFFF));  // low word first, as the debugger reads it
+            put(static_cast<uint16_t>(fc.code[i].immediate >> 16));
+        }
+    }
+    return size;
+}
+
+bool InCodeWindow(uint32_t pc) {
+    return (pc >= static_cast<uint32_t>(CODE_WINDOW)) && (pc + 6 <= static_cast<uint32_t>(CODE_WINDOW + CODE_WINDOW_SIZE));
+}
+
+// Reference model: a direct transcription of the instruction descriptions, on unsigned 32-bit values
+class ReferenceModel {
+public:
+    ReferenceModel() {
+        for (int i = 0; i < CODE_WINDOW_SIZE; i += 2) {
+            code[i] = NOP >> 8;
+            code[i + 1] = NOP & 0xFF;
+        }
+    }
+
+    // Returns false when the sequence escaped the modelled memory (a jump into a movei immediate can decode
+    // to anything); such cases are skipped, without running the production path
+    bool run(const FuzzCase& fc, int steps, MachineState& s) {
+        uint8_t* seq = code + CODE_OFFSET;
+        int size = EncodeCase(fc, seq);
+        std::memcpy(s.regs, fc.regs, sizeof(s.regs));
+        s.z = fc.flags & 1;
+        s.c = (fc.flags >> 1) & 1;
+        s.n = (fc.flags >> 2) & 1;
+        s.bank = (fc.flags >> 14) & 1;
+        s.pc = CODE_WINDOW + CODE_OFFSET;
+        s.hidata = fc.hidata;
+        s.remain = fc.remain;
+        std::memcpy(s.scratch, InitialScratch, SCRATCH_SIZE);
+        pending = false;
+        escaped = false;
+        accumulator = 0;
+        mtxc = fc.mtxc;
+        mtxa = fc.mtxa;
+        mod = fc.mod;
+        for (int i = 0; (i < steps) && InCodeWindow(s.pc) && !escaped; ++i)
+            step(s);
+        for (int i = 0; i < size; i += 2) {
+            seq[i] = NOP >> 8;
+            seq[i + 1] = NOP & 0xFF;
+        }
+        escapes += escaped;
+        return !escaped;
+    }
+
+    unsigned long long escapes = 0;
+
+private:
+    uint16_t fetch(uint32_t adrs) const {
+        uint32_t o = adrs - CODE_WINDOW;
+        return static_cast<uint16_t>((code[o] << 8) | code[o + 1]);
+    }
+    uint8_t* at(MachineState& s, uint32_t adrs) {
+        if ((adrs < static_cast<uint32_t>(SCRATCH)) || (adrs > static_cast<uint32_t>(SCRATCH + SCRATCH_SIZE - 4))) {
+            escaped = true;
+            return dummy;
+        }
+        return s.scratch + (adrs - SCRATCH);
+    }
+    uint32_t read32(MachineState& s, uint32_t adrs) {
+        uint8_t* p = at(s, adrs & ~3u);
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+    uint32_t read16(MachineState& s, uint32_t adrs) {
+        uint8_t* p = at(s, adrs & ~1u);
+        return (uint32_t(p[0]) << 8) | p[1];
+    }
+    void write32(MachineState& s, uint32_t adrs, uint32_t v) {
+        uint8_t* p = at(s, adrs & ~3u);
+        p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+    }
+    void write16(MachineState& s, uint32_t adrs, uint32_t v) {
+        uint8_t* p = at(s, adrs & ~1u);
+        p[0] = v >> 8; p[1] = v;
+    }
+    static void setZN(MachineState& s, uint32_t v) {
+        s.z = (v == 0);
+        s.n = v >> 31;
+    }
+    static bool condition(const MachineState& s, int cc) {
+        // bit 0: Z clear, bit 1: Z set, bit 2: C clear, bit 3: C set, bit 4 selects N instead of C
+        static const uint8_t valid[] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 20, 21, 22, 24, 25, 26 };
+        if (std::find(std::begin(valid), std::end(valid), cc) == std::end(valid))
+            return false;
+        uint32_t cn = (cc & 16) ? s.n : s.c;
+        if ((cc & 1) && s.z) return false;
+        if ((cc & 2) && !s.z) return false;
+        if ((cc & 4) && cn) return false;
+        if ((cc & 8) && !cn) return false;
+        return true;
+    }
+    static uint32_t clampSigned(uint32_t v, int32_t hi) {
+        int32_t x = static_cast<int32_t>(v);
+        return static_cast<uint32_t>(x < 0 ? 0 : (x > hi ? hi : x));
+    }
+
+    static uint32_t mirror(uint32_t v) {
+        uint32_t m = 0;
+        for (int i = 0; i < 32; ++i)
+            m |= ((v >> i) & 1) << (31 - i);
+        return m;
+    }
+
+    // Opcodes the DSP decodes differently from the GPU; false for the shared ones
+    bool stepDSP(MachineState& s, int op, int q, uint32_t ra, uint32_t& rb) {
+        switch (op) {
+        case 19: rb = uint32_t(accumulator); return true;
+        case 20: {                          // imacn, 40-bit accumulator
+            uint64_t sum = uint64_t(accumulator + int32_t(int16_t(ra)) * int16_t(rb));
+            accumulator = int64_t(sum << 24) >> 24;
+            return true;
+        }
+        case 32: {                          // subqmod
+            uint32_t t = rb - q;
+            s.c = uint32_t(q) > rb;
+            rb = (t & ~mod) | (rb & mod);
+            setZN(s, rb);
+            return true;
+        }
+        case 63: {                          // addqmod
+            uint64_t t = uint64_t(q) + rb;
+            s.c = uint32_t(t >> 32);
+            rb = (uint32_t(t) & ~mod) | (rb & mod);
+            setZN(s, rb);
+            return true;
+        }
+        case 33: {                          // sat16s
+            int32_t x = int32_t(rb);
+            rb = uint32_t(x < -32768 ? -32768 : (x > 32767 ? 32767 : x));
+            setZN(s, rb);
+            return true;
+        }
+        case 42: {                          // sat32s
+            int64_t guard = accumulator >> 32;
+            if (guard < -1) rb = 0x80000000u;
+            else if (guard > 0) rb = 0x7FFFFFFFu;
+            setZN(s, rb);
+            return true;
+        }
+        case 48: rb = mirror(rb); setZN(s, rb); return true;
+        case 62: return true;               // illegal
+        default: return false;
+        }
+    }
+
+    void step(MachineState& s) {
+        uint16_t w = fetch(s.pc);
+        s.pc += 2;
+        int op = w >> 10, a = (w >> 5) & 31, b = w & 31;
+        uint32_t* R = s.regs[s.bank];
+        uint32_t* other = s.regs[s.bank ^ 1];
+        uint32_t ra = R[a];
+        uint32_t& rb = R[b];
+        int q = a ? a : 32;                 // addq/subq immediates, 0 means 32
+        if (DSPMode && stepDSP(s, op, q, ra, rb))
+            op = -1;
+        switch (op) {
+        case 0: { uint64_t t = uint64_t(ra) + rb; s.c = uint32_t(t >> 32); rb = uint32_t(t); setZN(s, rb); break; }
+        case 1: { uint64_t t = uint64_t(ra) + rb + s.c; s.c = uint32_t(t >> 32); rb = uint32_t(t); setZN(s, rb); break; }
+        case 2: { uint64_t t = uint64_t(q) + rb; s.c = uint32_t(t >> 32); rb = uint32_t(t); setZN(s, rb); break; }
+        case 3: rb += q; break;
+        case 4: s.c = ra > rb; rb -= ra; setZN(s, rb); break;
+        case 5: { uint32_t cin = s.c; s.c = uint64_t(ra) + cin > rb; rb = rb - ra - cin; setZN(s, rb); break; }
+        case 6: s.c = uint32_t(q) > rb; rb -= q; setZN(s, rb); break;
+        case 7: rb -= q; break;
+        case 8: rb = 0 - rb; setZN(s, rb); break;
+        case 9: rb &= ra; setZN(s, rb); break;
+        case 10: rb |= ra; setZN(s, rb); break;
+        case 11: rb ^= ra; setZN(s, rb); break;
+        case 12: rb = ~rb; setZN(s, rb); break;
+        case 13: s.z = ((rb >> a) & 1) == 0; break;
+        case 14: rb |= 1u << a; setZN(s, rb); break;
+        case 15: rb &= ~(1u << a); setZN(s, rb); break;
+        case 16: rb = (ra & 0xFFFF) * (rb & 0xFFFF); setZN(s, rb); break;
+        case 17: rb = uint32_t(int32_t(int16_t(ra & 0xFFFF)) * int32_t(int16_t(rb & 0xFFFF))); setZN(s, rb); break;
+        case 18: accumulator = int32_t(int16_t(ra)) * int16_t(rb); setZN(s, uint32_t(accumulator)); break;
+        case 19: rb = uint32_t(accumulator); break;
+        case 20: accumulator = int32_t(uint32_t(accumulator) + uint32_t(int32_t(int16_t(ra)) * int16_t(rb))); break;
+        case 54: {                          // mmult, GPU 32-bit sum
+            int width = mtxc & 15;
+            uint32_t stride = (mtxc & 16) ? width * 4 : 4;
+            uint32_t sum = 0;
+            for (int i = 0; i < width; ++i) {
+                uint32_t v = other[(a + i / 2) & 31];
+                sum += uint32_t(int32_t(int16_t((i & 1) ? v >> 16 : v)) * int16_t(read16(s, mtxa + i * stride + 2)));
+            }
+            rb = sum;
+            setZN(s, rb);
+            break;
+        }
+        case 21: {                          // div: remainder kept in the hardware's signed form
+            uint32_t quotient = ra ? rb / ra : 0;
+            uint32_t rest = ra ? rb % ra : 0;
+            rb = quotient;
+            s.remain = (quotient & 1) ? rest : rest - ra;
+            break;
+        }
+        case 22: s.c = rb >> 31; if (s.c) rb = 0 - rb; s.n = 0; s.z = (rb == 0); break;
+        case 23: case 26: {                 // sh, sha: positive counts shift right, negative counts shift left
+            int32_t count = int32_t(ra);
+            if ((count > 32) || (count < -32)) count = 0;
+            if (count >= 0) {
+                s.c = rb & 1;
+                if (op == 23)
+                    rb = (count == 32) ? 0 : rb >> count;
+                else
+                    rb = (count == 32) ? ((rb >> 31) ? 0xFFFFFFFF : 0) : uint32_t(int32_t(rb) >> count);
+            }
+            else {
+                s.c = rb >> 31;
+                rb = (count == -32) ? 0 : rb << -count;
+            }
+            setZN(s, rb);
+            break;
+        }
+        case 24: s.c = rb >> 31; rb = (a == 0) ? 0 : rb << (32 - a); setZN(s, rb); break;
+        case 25: s.c = rb & 1; rb >>= a; setZN(s, rb); break;
+        case 27: s.c = rb & 1; rb = uint32_t(int32_t(rb) >> a); setZN(s, rb); break;
+        case 28: case 29: {
+            int count = (op == 28) ? (ra & 31) : a;
+            s.c = rb >> 31;
+            if (count) rb = (rb >> count) | (rb << (32 - count));
+            setZN(s, rb);
+            break;
+        }
+        case 30: s.c = ra > rb; setZN(s, rb - ra); break;
+        case 31: s.c = uint32_t(a) > rb; setZN(s, rb - a); break;
+        case 32: rb = clampSigned(rb, 255); setZN(s, rb); break;
+        case 33: rb = clampSigned(rb, 65535); setZN(s, rb); break;
+        case 62: rb = clampSigned(rb, 16777215); setZN(s, rb); break;
+        case 34: rb = ra; break;
+        case 35: rb = a; break;
+        case 36: other[b] = ra; break;
+        case 37: rb = other[a]; break;
+        case 38: rb = fetch(s.pc) | (uint32_t(fetch(s.pc + 2)) << 16); s.pc += 4; break;
+        case 39: rb = *at(s, ra); break;
+        case 40: rb = read16(s, ra); break;
+        case 41: rb = read32(s, ra); break;
+        case 42: s.hidata = read32(s, ra); rb = read32(s, ra + 4); break;
+        case 43: rb = read32(s, R[14] + a * 4); break;
+        case 44: rb = read32(s, R[15] + a * 4); break;
+        case 58: rb = read32(s, R[14] + ra); break;
+        case 59: rb = read32(s, R[15] + ra); break;
+        case 45: *at(s, ra) = uint8_t(rb); break;
+        case 46: write16(s, ra, rb); break;
+        case 47: write32(s, ra, rb); break;
+        case 48: write32(s, ra, s.hidata); write32(s, ra + 4, rb); break;
+        case 49: write32(s, R[14] + a * 4, rb); break;
+        case 50: write32(s, R[15] + a * 4, rb); break;
+        case 60: write32(s, R[14] + ra, rb); break;
+        case 61: write32(s, R[15] + ra, rb); break;
+        case 51: rb = s.pc - 2; break;
+        case 52: if (condition(s, b)) { pending = true; target = ra; } break;
+        case 53: if (condition(s, b)) { pending = true; target = s.pc + uint32_t(a > 15 ? a - 32 : a) * 2; } break;
+        case 63:
+            if (a == 0)
+                rb = ((rb & 0x3C00000) >> 10) | ((rb & 0x001E000) >> 5) | (rb & 0xFF);
+            else
+                rb = ((rb << 10) & 0x3C00000) | ((rb << 5) & 0x001E000) | (rb & 0xFF);
+            break;
+        default:
+            break;
+        }
+        // A jump takes effect after its delay slot; a jump in the delay slot replaces it
+        if ((op != 52) && (op != 53) && pending) {
+            s.pc = target;
+            pending = false;
+            escaped |= !InCodeWindow(target);
+        }
+    }
+
+    uint8_t code[CODE_WINDOW_SIZE];
+    uint8_t dummy[4];
+    bool escaped = false;
+    bool pending = false;
+    uint32_t target = 0;
+    int64_t accumulator = 0;
+    uint32_t mtxc = 0, mtxa = 0, mod = 0;
+};
+
+// Production path: the Debugger instance stepped exactly as Debugger::execute() does
+class ProductionModel {
+public:
+    explicit ProductionModel(Debugger& debugger) : debugger(debugger) {}
+
+    void run(const FuzzCase& fc, int steps, MachineState& s) {
+        uint8_t* seq = MemoryBuffer.data() + CODE_WINDOW + CODE_OFFSET;
+        int size = EncodeCase(fc, seq);
+        std::memcpy(MemoryBuffer.data() + SCRATCH, InitialScratch, SCRATCH_SIZE);
+        PutLong(G_HIDATA, fc.hidata);
+        PutLong(DSPMode ? D_REMAIN : G_REMAIN, fc.remain);
+        PutLong(DSPMode ? D_MTXC : G_MTXC, fc.mtxc);
+        PutLong(DSPMode ? D_MTXA : G_MTXA, fc.mtxa);
+        PutLong(D_MOD, fc.mod);
+        debugger.reset();
+        for (int bank = 0; bank < 2; ++bank)
+            for (int r = 0; r < 32; ++r)
+                debugger.setRegBankRegisterValue(bank, r, static_cast<int>(fc.regs[bank][r]));
+        debugger.setFlagsValue(fc.flags);
+        debugger.setPCValue(CODE_WINDOW + CODE_OFFSET);
+        for (int i = 0; (i < steps) && InCodeWindow(static_cast<uint32_t>(debugger.getPCValue())); ++i)
+            debugger.step(static_cast<uint16_t>(debugger.ReadWord(debugger.getPCValue(), true)), true);
+
+        for (int bank = 0; bank < 2; ++bank)
+            for (int r = 0; r < 32; ++r)
+                s.regs[bank][r] = static_cast<uint32_t>(debugger.getRegBankRegisterValue(bank, r));
+        uint32_t flags = debugger.getFlagsValue();
+        s.z = flags & 1;
+        s.c = (flags >> 1) & 1;
+        s.n = (flags >> 2) & 1;
+        s.bank = (flags >> 14) & 1;
+        s.pc = static_cast<uint32_t>(debugger.getPCValue());
+        s.hidata = GetLong(G_HIDATA);
+        s.remain = GetLong(DSPMode ? D_REMAIN : G_REMAIN);
+        std::memcpy(s.scratch, MemoryBuffer.data() + SCRATCH, SCRATCH_SIZE);
+        for (int i = 0; i < size; i += 2) {
+            seq[i] = NOP >> 8;
+            seq[i + 1] = NOP & 0xFF;
+        }
+    }
+
+private:
+    static void PutLong(int adrs, uint32_t v) {
+        uint8_t* p = MemoryBuffer.data() + adrs;
+        p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+    }
+    static uint32_t GetLong(int adrs) {
+        const uint8_t* p = MemoryBuffer.data() + adrs;
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    Debugger& debugger;
+};
+
+bool SameState(const MachineState& a, const MachineState& b) {
+    return (std::memcmp(a.regs, b.regs, sizeof(a.regs)) == 0) && (a.z == b.z) && (a.c == b.c) && (a.n == b.n) &&
+        (a.bank == b.bank) && (a.pc == b.pc) && (a.hidata == b.hidata) && (a.remain == b.remain) &&
+        (std::memcmp(a.scratch, b.scratch, SCRATCH_SIZE) == 0);
+}
+
+int Steps(const FuzzCase& fc) {
+    return fc.count + 2;                    // let a trailing jump and its delay slot resolve
+}
+
+bool Diverges(ReferenceModel& ref, ProductionModel& prod, const FuzzCase& fc, MachineState& expected, MachineState& actual) {
+    if (!ref.run(fc, Steps(fc), expected))
+        return false;
+    prod.run(fc, Steps(fc), actual);
+    return !SameState(expected, actual);
+}
+
+// Shrink a divergent case: drop instructions, then clear the registers and flags that do not matter
+void Minimize(ReferenceModel& ref, ProductionModel& prod, FuzzCase& fc, MachineState& expected, MachineState& actual) {
+    bool progress = true;
+    auto accept = [&](const FuzzCase& candidate) {
+        if (!Diverges(ref, prod, candidate, expected, actual))
+            return;
+        fc = candidate;
+        progress = true;
+    };
+    while (progress) {
+        progress = false;
+        for (int i = fc.count - 1; (i >= 0) && (fc.count > 1); --i) {
+            FuzzCase candidate = fc;
+            std::copy(fc.code + i + 1, fc.code + fc.count, candidate.code + i);
+            candidate.count--;
+            accept(candidate);
+        }
+        for (int bank = 0; bank < 2; ++bank) {
+            for (int r : WRITABLE_REGS) {
+                FuzzCase candidate = fc;
+                candidate.regs[bank][r] = 0;
+                if (fc.regs[bank][r])
+                    accept(candidate);
+            }
+        }
+        FuzzCase candidate = fc;
+        candidate.hidata = 0;
+        if (fc.hidata)
+            accept(candidate);
+        candidate = fc;
+        candidate.remain = 0;
+        if (fc.remain)
+            accept(candidate);
+        for (uint32_t flag = 1; flag <= 4; flag <<= 1) {
+            candidate = fc;
+            candidate.flags &= ~flag;
+            if (fc.flags & flag)
+                accept(candidate);
+        }
+    }
+    Diverges(ref, prod, fc, expected, actual);
+}
+
+
+QString Hex(uint32_t v) {
+    return QString("$%1").arg(QString::number(v, 16).toUpper().rightJustified(8, '0'));
+}
+
+void Report(QTextStream& out, Debugger& debugger, const FuzzCase& fc, const MachineState& expected, const MachineState& actual) {
+    out << "Divergent case:\n";
+    int size = EncodeCase(fc, MemoryBuffer.data() + CODE_WINDOW + CODE_OFFSET);
+    for (const QString& line : debugger.disassemble(CODE_WINDOW + CODE_OFFSET, size))
+        out << "    " << line << "\n";
+    for (int i = 0; i < size; i += 2) {
+        MemoryBuffer[CODE_WINDOW + CODE_OFFSET + i] = NOP >> 8;
+        MemoryBuffer[CODE_WINDOW + CODE_OFFSET + i + 1] = NOP & 0xFF;
+    }
+    out << "  initial flags " << Hex(fc.flags) << ", G_HIDATA " << Hex(fc.hidata) << ", G_REMAIN " << Hex(fc.remain)
+        << ", G_MTXC " << Hex(fc.mtxc) << ", G_MTXA " << Hex(fc.mtxa)
+        << ", D_MOD " << Hex(fc.mod) << "\n";
+    for (int bank = 0; bank < 2; ++bank)
+        for (int r = 0; r < 32; ++r)
+            if (fc.regs[bank][r])
+                out << QString("  bank %1 r%2 = %3\n").arg(bank).arg(r).arg(Hex(fc.regs[bank][r]));
+    out << "  expected (reference) / actual (step):\n";
+    for (int bank = 0; bank < 2; ++bank)
+        for (int r = 0; r < 32; ++r)
+            if (expected.regs[bank][r] != actual.regs[bank][r])
+                out << QString("    bank %1 r%2: %3 / %4\n").arg(bank).arg(r).arg(Hex(expected.regs[bank][r])).arg(Hex(actual.regs[bank][r]));
+    if ((expected.z != actual.z) || (expected.c != actual.c) || (expected.n != actual.n) || (expected.bank != actual.bank))
+        out << QString("    Z C N bank: %1 %2 %3 %4 / %5 %6 %7 %8\n").arg(expected.z).arg(expected.c).arg(expected.n).arg(expected.bank)
+                   .arg(actual.z).arg(actual.c).arg(actual.n).arg(actual.bank);
+    if (expected.pc != actual.pc)
+        out << "    pc: " << Hex(expected.pc) << " / " << Hex(actual.pc) << "\n";
+    if (expected.hidata != actual.hidata)
+        out << "    G_HIDATA: " << Hex(expected.hidata) << " / " << Hex(actual.hidata) << "\n";
+    if (expected.remain != actual.remain)
+        out << "    G_REMAIN: " << Hex(expected.remain) << " / " << Hex(actual.remain) << "\n";
+    for (int i = 0; i < SCRATCH_SIZE; ++i)
+        if (expected.scratch[i] != actual.scratch[i])
+            out << QString("    memory %1: $%2 / $%3\n").arg(Hex(SCRATCH + i))
+                       .arg(QString::number(expected.scratch[i], 16).toUpper().rightJustified(2, '0'))
+                       .arg(QString::number(actual.scratch[i], 16).toUpper().rightJustified(2, '0'));
+    out.flush();
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    unsigned long long cases = 10000000ULL;
+    unsigned long long seed = 1;
+    int maxLength = 8;
+    bool keepGoing = false;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if ((args[i] == "--cases") && (i + 1 < args.size()))
+            cases = args[++i].toULongLong();
+        else if ((args[i] == "--seed") && (i + 1 < args.size()))
+            seed = args[++i].toULongLong();
+        else if ((args[i] == "--max-length") && (i + 1 < args.size()))
+            maxLength = std::max(1, std::min(MAX_INSTRUCTIONS, args[++i].toInt()));
+        else if (args[i] == "--keep-going")
+            keepGoing = true;
+        else if (args[i] == "--dsp")
+            DSPMode = true;
+        else {
+            std::fprintf(stderr, "Usage: jrisc_fuzz [--cases N] [--seed S] [--max-length INSTRUCTIONS] [--dsp] [--keep-going]\n");
+            return 2;
+        }
+    }
+
+    // A nop filled code window loaded like a program, so step() runs in its normal state
+    QTemporaryFile file;
+    if (!file.open())
+        return 2;
+    std::vector<uint8_t> window(CODE_WINDOW_SIZE);
+    for (int i = 0; i < CODE_WINDOW_SIZE; i += 2) {
+        window[i] = NOP >> 8;
+        window[i + 1] = NOP & 0xFF;
+    }
+    file.write(reinterpret_cast<const char*>(window.data()), CODE_WINDOW_SIZE);
+    file.close();
+    Debugger debugger;
+    debugger.setGPUMode(!DSPMode);
+    debugger.setMemoryWarningEnabled(true);
+    if (!debugger.loadBin(file.fileName(), CODE_WINDOW))
+        return 2;
+
+    XorShift rng(seed);
+    for (int i = 0; i < SCRATCH_SIZE; ++i)
+        InitialScratch[i] = static_cast<uint8_t>(rng.next());
+
+    ReferenceModel ref;
+    ProductionModel prod(debugger);
+    std::vector<FuzzCase> batch(BATCH_SIZE);
+    MachineState expected, actual;
+    QTextStream out(stdout);
+    unsigned long long done = 0, failures = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (done < cases) {
+        int n = static_cast<int>(std::min<unsigned long long>(BATCH_SIZE, cases - done));
+        for (int i = 0; i < n; ++i)
+            RandomCase(rng, maxLength, batch[i]);
+        for (int i = 0; i < n; ++i) {
+            if (!Diverges(ref, prod, batch[i], expected, actual))
+                continue;
+            ++failures;
+            FuzzCase fc = batch[i];
+            Minimize(ref, prod, fc, expected, actual);
+            out << "Case " << (done + i) << " (seed " << seed << ")\n";
+            Report(out, debugger, fc, expected, actual);
+            if (!keepGoing)
+                return 1;
+        }
+        done += n;
+    }
+    double seconds = timer.nsecsElapsed() / 1e9;
+    out << done << " cases, " << failures << " divergent, " << ref.escapes << " skipped, " << QString::number(done / seconds / 1e6, 'f', 2) << " M cases/s\n";
+    return failures ? 1 : 0;
+}
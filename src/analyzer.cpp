@@ -0,0 +1,520 @@
+#include "analyzer.h"
+#include "debugger.h"
+#include <QTextStream>
+#include <algorithm>
+
+// Cycles an operation holds the issue slot: one through the pipeline, movei fetches two more words, the
+// matrix unit reads its elements
+static const uint8_t IssueCycles[OperationCount] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // add .. bclr
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // mult .. cmpq
+    1, 1, 1, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // sat8 .. store
+    1, 1, 1, 1, 1, 1, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // storep .. pack
+    1, 1, 1, 1, 1, 1, 1, 1                              // subqmod .. illegal
+};
+
+// Cycles from issue until the result can be read: local RAM loads 2, loadp 3, div 18, everything else 1
+static int ResultLatency(int operation) {
+    switch (operation) {
+    case 39: case 40: case 41: case 43: case 44: case 58: case 59: return 2;
+    case 42: return 3;
+    case 21: return 18;
+    default: return 1;
+    }
+}
+
+static bool IsBranch(int operation) {
+    return (operation == 52) || (operation == 53);
+}
+
+// Registers of the current bank read and written by an operation, as bit masks
+void OperationRegisters(int operation, int reg1, int reg2, uint32_t& reads, uint32_t& writes) {
+    uint32_t r1 = 1u << reg1;
+    uint32_t r2 = 1u << reg2;
+    const uint32_t r14 = 1u << 14;
+    const uint32_t r15 = 1u << 15;
+    reads = 0;
+    writes = 0;
+    switch (operation) {
+    case 0: case 1: case 4: case 5: case 9: case 10: case 11: case 16: case 17: case 21: case 23: case 26: case 28:
+        reads = r1 | r2; writes = r2; break;
+    case 2: case 3: case 6: case 7: case 8: case 12: case 14: case 15: case 22: case 24: case 25: case 27: case 29:
+    case 32: case 33: case 62: case 63: case OpSubqmod: case OpAddqmod: case OpSat16s: case OpSat32s: case OpMirror:
+        reads = r2; writes = r2; break;
+    case 13: case 31: // btst, cmpq
+        reads = r2; break;
+    case 18: case 20: case 30: case OpImacn40: // imultn, imacn, cmp
+        reads = r1 | r2; break;
+    case 34: case 39: case 40: case 41: case 42: case 55: case 56: // move, loads through a register, mtoi, normi
+        reads = r1; writes = r2; break;
+    case 19: case 35: case 37: case 38: case 51: case 54: case OpResmac40: // only write reg2
+        writes = r2; break;
+    case 36: case 52: // moveta, jump
+        reads = r1; break;
+    case 43: reads = r14; writes = r2; break;
+    case 44: reads = r15; writes = r2; break;
+    case 58: reads = r1 | r14; writes = r2; break;
+    case 59: reads = r1 | r15; writes = r2; break;
+    case 45: case 46: case 47: case 48: reads = r1 | r2; break;
+    case 49: reads = r2 | r14; break;
+    case 50: reads = r2 | r15; break;
+    case 60: reads = r1 | r2 | r14; break;
+    case 61: reads = r1 | r2 | r15; break;
+    default: break;
+    }
+}
+
+
+// Forget the previous analysis
+void ProgramAnalysis::clear() {
+    blockList.clear();
+    loopList.clear();
+    unattributed = 0;
+}
+
+
+// Build the blocks, the control-flow graph, the dominator tree and the loops of the text segments
+void ProgramAnalysis::analyze(const uint8_t* memory, const std::vector<Segment>& segments, const uint8_t* operations,
+                              const SymbolTable& symbols) {
+    clear();
+    std::vector<Instruction> code;
+    for (const Segment& seg : segments) {
+        if (seg.kind == SegmentKind::Text)
+            Decode(memory, seg, operations, code);
+    }
+    if (code.empty())
+        return;
+    std::sort(code.begin(), code.end(), [](const Instruction& a, const Instruction& b) { return a.address < b.address; });
+    BuildBlocks(code, segments, symbols);
+    ComputeDominators();
+    FindLoops();
+}
+
+
+// Decode one segment; jump targets are known when a movei in the same straight-line code loaded the register
+void ProgramAnalysis::Decode(const uint8_t* memory, const Segment& segment, const uint8_t* operations,
+                             std::vector<Instruction>& code) {
+    int moveiValue[32];
+    uint32_t moveiKnown = 0;
+    int adrs = segment.address;
+    int end = segment.address + segment.size;
+    while (adrs + 1 < end) {
+        const uint8_t* walk = memory + adrs;
+        Instruction in;
+        in.address = adrs;
+        in.size = 2;
+        in.operation = operations[walk[0] >> 2];
+        in.reg1 = ((walk[0] << 3) & 31) | (walk[1] >> 5);
+        in.reg2 = walk[1] & 31;
+        in.target = -1;
+        uint32_t reads, writes;
+        OperationRegisters(in.operation, in.reg1, in.reg2, reads, writes);
+        moveiKnown &= ~writes;
+        switch (in.operation) {
+        case 38: // movei
+            in.size = 6;
+            if (adrs + 6 <= end) {
+                moveiValue[in.reg2] = (walk[2] << 8) | walk[3] | (walk[4] << 24) | (walk[5] << 16);
+                moveiKnown |= 1u << in.reg2;
+            }
+            break;
+        case 53: // jr
+            in.target = adrs + 2 + ((in.reg1 > 15) ? in.reg1 - 32 : in.reg1) * 2;
+            moveiKnown = 0;
+            break;
+        case 52: // jump
+            if (moveiKnown & (1u << in.reg1))
+                in.target = moveiValue[in.reg1];
+            moveiKnown = 0;
+            break;
+        default:
+            break;
+        }
+        code.push_back(in);
+        adrs += in.size;
+    }
+}
+
+
+// Split the code at the leaders (segment and symbol starts, branch targets, instructions after a delay slot)
+// and link the blocks
+void ProgramAnalysis::BuildBlocks(const std::vector<Instruction>& code, const std::vector<Segment>& segments,
+                                  const SymbolTable& symbols) {
+    int count = static_cast<int>(code.size());
+    auto find = [&](int address) {
+        auto it = std::lower_bound(code.begin(), code.end(), address,
+                                   [](const Instruction& in, int a) { return in.address < a; });
+        return ((it != code.end()) && (it->address == address)) ? static_cast<int>(it - code.begin()) : -1;
+    };
+    auto contiguous = [&](int i) { // instruction i + 1 follows instruction i in memory
+        return (i + 1 < count) && (code[i + 1].address == code[i].address + code[i].size);
+    };
+
+    std::vector<char> leader(count, 0);
+    leader[0] = 1;
+    for (int i = 0; i < count; ++i) {
+        if ((i > 0) && !contiguous(i - 1))
+            leader[i] = 1;
+        if (symbols.at(code[i].address))
+            leader[i] = 1;
+        if (IsBranch(code[i].operation)) {
+            int t = (code[i].target >= 0) ? find(code[i].target) : -1;
+            if (t >= 0)
+                leader[t] = 1;
+            if (i + 2 < count)
+                leader[i + 2] = 1;
+        }
+    }
+    for (const Segment& seg : segments) {
+        int s = find(seg.address);
+        if (s >= 0)
+            leader[s] = 1;
+    }
+
+    // Blocks end on the delay slot of their branch, or before the next leader
+    std::vector<int> blockOf(count, -1);
+    std::vector<int> lastOf;
+    std::vector<int> branchOf;
+    for (int first = 0; first < count;) {
+        int last = first;
+        int branch = -1;
+        for (;;) {
+            if (IsBranch(code[last].operation) && (branch < 0)) {
+                branch = last;
+                if (contiguous(last) && !leader[last + 1])
+                    ++last; // delay slot
+                break;
+            }
+            if (!contiguous(last) || leader[last + 1])
+                break;
+            ++last;
+        }
+        BasicBlock block;
+        block.start = code[first].address;
+        block.end = code[last].address + code[last].size;
+        block.instructions = last - first + 1;
+        block.branch = (branch >= 0) ? code[branch].address : -1;
+        EstimateCycles(block, code, first, last);
+        for (int i = first; i <= last; ++i)
+            blockOf[i] = static_cast<int>(blockList.size());
+        blockList.push_back(block);
+        lastOf.push_back(last);
+        branchOf.push_back(branch);
+        first = last + 1;
+    }
+
+    for (int b = 0; b < static_cast<int>(blockList.size()); ++b) {
+        BasicBlock& block = blockList[b];
+        int last = lastOf[b];
+        int branch = branchOf[b];
+        bool fallthrough = true;
+        if (branch >= 0) {
+            const Instruction& in = code[branch];
+            int t = (in.target >= 0) ? find(in.target) : -1;
+            if (t >= 0)
+                block.successors.push_back(blockOf[t]);
+            block.indirect = (in.target < 0);
+            fallthrough = (in.reg2 != 0); // condition code 0 always jumps
+        }
+        if (fallthrough && contiguous(last))
+            block.successors.push_back(blockOf[last + 1]);
+        std::sort(block.successors.begin(), block.successors.end());
+        block.successors.erase(std::unique(block.successors.begin(), block.successors.end()), block.successors.end());
+        for (int s : block.successors)
+            blockList[s].predecessors.push_back(b);
+    }
+}
+
+
+// Issue the block on a register scoreboard starting with every register ready; a read of a register whose
+// load or divide has not completed, or a second divide while the unit is busy, stalls the pipeline
+void ProgramAnalysis::EstimateCycles(BasicBlock& block, const std::vector<Instruction>& code, int first, int last) {
+    int ready[32] = {};
+    bool fromDivide[32] = {};
+    int divideFree = 0;
+    int t = 0;
+    for (int i = first; i <= last; ++i) {
+        const Instruction& in = code[i];
+        uint32_t reads, writes;
+        OperationRegisters(in.operation, in.reg1, in.reg2, reads, writes);
+        int start = t;
+        int reg = -1;
+        for (int r = 0; r < 32; ++r) {
+            if ((reads & (1u << r)) && (ready[r] > start)) {
+                start = ready[r];
+                reg = r;
+            }
+        }
+        bool divide = (reg >= 0) && fromDivide[reg];
+        if ((in.operation == 21) && (divideFree > start)) {
+            start = divideFree;
+            reg = in.reg2;
+            divide = true;
+        }
+        if (start > t) {
+            block.stalls.push_back({ in.address, start - t, reg, divide });
+            block.stallCycles += start - t;
+        }
+        t = start + IssueCycles[in.operation];
+        int latency = ResultLatency(in.operation);
+        for (int r = 0; r < 32; ++r) {
+            if (writes & (1u << r)) {
+                ready[r] = start + latency;
+                fromDivide[r] = (in.operation == 21);
+            }
+        }
+        if (in.operation == 21)
+            divideFree = start + latency;
+    }
+    block.cycles = t;
+}
+
+
+// Immediate dominators (Cooper, Harvey and Kennedy), over a virtual root linked to every entry block
+void ProgramAnalysis::ComputeDominators() {
+    int n = static_cast<int>(blockList.size());
+    std::vector<int> postIndex(n + 1, -1);
+    std::vector<int> order; // postorder
+    std::vector<std::pair<int, size_t>> stack;
+    auto visit = [&](int root) {
+        postIndex[root] = -2; // on the stack
+        stack.push_back({ root, 0 });
+        while (!stack.empty()) {
+            int b = stack.back().first;
+            size_t& next = stack.back().second;
+            if (next < blockList[b].successors.size()) {
+                int s = blockList[b].successors[next++];
+                if (postIndex[s] == -1) {
+                    postIndex[s] = -2;
+                    stack.push_back({ s, 0 });
+                }
+            }
+            else {
+                postIndex[b] = static_cast<int>(order.size());
+                order.push_back(b);
+                stack.pop_back();
+            }
+        }
+    };
+    std::vector<int> idom(n + 1, -1);
+    for (int b = 0; b < n; ++b) {
+        if (blockList[b].predecessors.empty()) {
+            visit(b);
+            idom[b] = n;
+        }
+    }
+    // Cycles entered only through unknown jumps: their first block becomes an entry
+    for (int b = 0; b < n; ++b) {
+        if (postIndex[b] == -1) {
+            visit(b);
+            idom[b] = n;
+        }
+    }
+    postIndex[n] = n;
+    idom[n] = n;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (postIndex[a] < postIndex[b]) a = idom[a];
+            while (postIndex[b] < postIndex[a]) b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = static_cast<int>(order.size()) - 1; i >= 0; --i) {
+            int b = order[i];
+            if (idom[b] == n)
+                continue;
+            int newIdom = -1;
+            for (int p : blockList[b].predecessors) {
+                if (idom[p] < 0)
+                    continue;
+                newIdom = (newIdom < 0) ? p : intersect(p, newIdom);
+            }
+            if ((newIdom >= 0) && (idom[b] != newIdom)) {
+                idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    for (int b = 0; b < n; ++b)
+        blockList[b].idom = (idom[b] == n) ? -1 : idom[b];
+}
+
+
+// Whether block a dominates block b
+bool ProgramAnalysis::Dominates(int a, int b) const {
+    for (; b >= 0; b = blockList[b].idom) {
+        if (b == a)
+            return true;
+    }
+    return false;
+}
+
+
+// Natural loops of the back edges (edges to a dominator), merged by header and nested by containment
+void ProgramAnalysis::FindLoops() {
+    int n = static_cast<int>(blockList.size());
+    std::vector<int> loopOfHeader(n, -1);
+    for (int u = 0; u < n; ++u) {
+        for (int h : blockList[u].successors) {
+            if (!Dominates(h, u))
+                continue;
+            if (loopOfHeader[h] < 0) {
+                loopOfHeader[h] = static_cast<int>(loopList.size());
+                Loop loop;
+                loop.header = h;
+                loop.blocks.push_back(h);
+                loopList.push_back(loop);
+            }
+            Loop& loop = loopList[loopOfHeader[h]];
+            loop.latches.push_back(u);
+            std::vector<int> work;
+            if (std::find(loop.blocks.begin(), loop.blocks.end(), u) == loop.blocks.end()) {
+                loop.blocks.push_back(u);
+                work.push_back(u);
+            }
+            while (!work.empty()) {
+                int b = work.back();
+                work.pop_back();
+                for (int p : blockList[b].predecessors) {
+                    if (std::find(loop.blocks.begin(), loop.blocks.end(), p) == loop.blocks.end()) {
+                        loop.blocks.push_back(p);
+                        work.push_back(p);
+                    }
+                }
+            }
+        }
+    }
+
+    for (Loop& loop : loopList) {
+        std::sort(loop.blocks.begin() + 1, loop.blocks.end());
+        loop.cycles = 0;
+        for (int b : loop.blocks)
+            loop.cycles += blockList[b].cycles;
+        loop.cycles += TakenJumpCycles; // the back edge
+    }
+    // The enclosing loop is the smallest other loop holding the header
+    int count = static_cast<int>(loopList.size());
+    for (int i = 0; i < count; ++i) {
+        Loop& inner = loopList[i];
+        for (int j = 0; j < count; ++j) {
+            const Loop& outer = loopList[j];
+            if ((i == j) || (outer.blocks.size() <= inner.blocks.size()) ||
+                (std::find(outer.blocks.begin(), outer.blocks.end(), inner.header) == outer.blocks.end()))
+                continue;
+            if ((inner.parent < 0) || (outer.blocks.size() < loopList[inner.parent].blocks.size()))
+                inner.parent = j;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        Loop& loop = loopList[i];
+        loop.depth = 1;
+        for (int p = loop.parent; p >= 0; p = loopList[p].parent)
+            ++loop.depth;
+        for (int b : loop.blocks) {
+            int& current = blockList[b].loop;
+            if ((current < 0) || (loopList[current].blocks.size() > loop.blocks.size()))
+                current = i;
+        }
+    }
+}
+
+
+// Block holding the address, -1 if none
+int ProgramAnalysis::blockAt(int address) const {
+    auto it = std::upper_bound(blockList.begin(), blockList.end(), address,
+                               [](int a, const BasicBlock& block) { return a < block.start; });
+    if (it == blockList.begin())
+        return -1;
+    --it;
+    return (address < it->end) ? static_cast<int>(it - blockList.begin()) : -1;
+}
+
+
+// Sum the bus wait states the interpreter charged per instruction address into the blocks and loops
+void ProgramAnalysis::setBusCycles(const std::function<uint64_t(int)>& perInstruction, uint64_t total) {
+    unattributed = total;
+    for (BasicBlock& block : blockList) {
+        block.busCycles = 0;
+        for (int adrs = block.start; adrs < block.end; adrs += 2)
+            block.busCycles += perInstruction(adrs);
+        unattributed -= std::min(unattributed, block.busCycles);
+    }
+    for (Loop& loop : loopList) {
+        loop.busCycles = 0;
+        for (int b : loop.blocks)
+            loop.busCycles += blockList[b].busCycles;
+    }
+}
+
+
+// Plain text report: loops innermost first with their blocks and stalls, then every block with its successors
+QString ProgramAnalysis::report(const SymbolTable& symbols) const {
+    QString text;
+    QTextStream out(&text);
+    auto hex = [](int value) { return QString("$%1").arg(value, 8, 16, QChar('0')).toUpper(); };
+    auto blockLine = [&](const BasicBlock& block) {
+        QString line = QString("%1-%2  %3  %4 instructions  %5 cycles (%6 stalled)")
+            .arg(hex(block.start)).arg(hex(block.end)).arg(symbols.symbolize(block.start))
+            .arg(block.instructions).arg(block.cycles).arg(block.stallCycles);
+        if (block.busCycles)
+            line += QString("  bus %1").arg(block.busCycles);
+        return line;
+    };
+    int indirect = 0;
+    for (const BasicBlock& block : blockList)
+        indirect += block.indirect;
+    out << "Static analysis: " << blockList.size() << " blocks, " << loopList.size() << " loops, "
+        << indirect << " unresolved jumps\n";
+    out << "Cycles assume local RAM and no bus contention; a taken jump adds " << TakenJumpCycles << ".\n";
+    out << "Bus: external bus wait states measured by the last runs, all executions of the block.\n";
+    if (unattributed)
+        out << "Bus wait states of code outside the analyzed blocks: " << unattributed << "\n";
+
+    std::vector<int> order(loopList.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = static_cast<int>(i);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (loopList[a].depth != loopList[b].depth)
+            return loopList[a].depth > loopList[b].depth;
+        return blockList[loopList[a].header].start < blockList[loopList[b].header].start;
+    });
+    if (!order.empty())
+        out << "\nLoops, innermost first:\n";
+    for (int i : order) {
+        const Loop& loop = loopList[i];
+        const BasicBlock& header = blockList[loop.header];
+        out << "  Loop at " << hex(header.start) << "  " << symbols.symbolize(header.start) << ", depth " << loop.depth
+            << ", " << loop.blocks.size() << " blocks, ~" << loop.cycles << " cycles per iteration";
+        if (loop.busCycles)
+            out << ", " << loop.busCycles << " bus cycles lost";
+        out << "\n";
+        for (int b : loop.blocks) {
+            const BasicBlock& block = blockList[b];
+            out << "    " << blockLine(block) << "\n";
+            for (const Stall& stall : block.stalls)
+                out << "      " << hex(stall.address) << " waits " << stall.cycles << ((stall.cycles > 1) ? " cycles" : " cycle")
+                    << " for r" << stall.reg << (stall.divide ? " (divide)\n" : " (load)\n");
+        }
+    }
+
+    out << "\nBlocks:\n";
+    for (const BasicBlock& block : blockList) {
+        out << "  " << blockLine(block);
+        if (block.loop >= 0)
+            out << "  loop depth " << loopList[block.loop].depth;
+        if (!block.successors.empty()) {
+            out << "  ->";
+            for (int s : block.successors)
+                out << " " << hex(blockList[s].start);
+        }
+        if (block.indirect)
+            out << "  -> ?";
+        out << "\n";
+    }
+    out.flush();
+    return text;
+}
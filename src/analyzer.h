@@ -0,0 +1,95 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "loader.h"
+#include "symbols.h"
+
+// Registers of the current bank an operation reads and writes, as bit masks; moveta and movefa only count
+// their access to the current bank
+void OperationRegisters(int operation, int reg1, int reg2, uint32_t& reads, uint32_t& writes);
+
+// A pipeline stall the cost model predicts inside a block
+struct Stall {
+    int address;            // instruction that waits
+    int cycles;
+    int reg;                // register it waits for
+    bool divide;            // divide result or divide unit busy, otherwise a load result
+};
+
+// A basic block: straight-line code from a leader to the delay slot of its jump, or to the next leader
+struct BasicBlock {
+    int start;              // address of the first instruction
+    int end;                // address after the last instruction
+    int instructions = 0;
+    int cycles = 0;         // estimated, stalls included, taken-jump refill excluded
+    int stallCycles = 0;
+    std::vector<Stall> stalls;
+    uint64_t busCycles = 0; // measured: external bus wait states charged to the block's instructions
+    std::vector<int> successors;    // block indices
+    std::vector<int> predecessors;
+    int branch = -1;        // address of the jump/jr ending the block, -1 if it falls through
+    bool indirect = false;  // ends in a jump through a register of unknown value
+    int idom = -1;          // immediate dominator, -1 for an entry block
+    int loop = -1;          // innermost loop holding the block, -1 if none
+};
+
+// A natural loop: the blocks reaching a back edge to the header without passing through it
+struct Loop {
+    int header;             // block index
+    std::vector<int> blocks;        // header first, then by address
+    std::vector<int> latches;       // sources of the back edges
+    int parent = -1;        // enclosing loop, -1 if none
+    int depth = 1;
+    int cycles = 0;         // one iteration through every block of the body, plus the back edge refill
+    uint64_t busCycles = 0; // measured, all iterations
+};
+
+// ProgramAnalysis: static control-flow and cost analysis of the loaded text segments.
+// Instructions are decoded like the disassembler does, with the decode table of the selected core; jr targets
+// and jump (rN) targets loaded by a movei in the same straight-line code become edges. Dominators give the
+// natural loops. Block cycles come from a per-operation cost table with a register scoreboard: a load result
+// is ready two cycles after issue, a divide result after 18, so a consumer placed too early stalls.
+class ProgramAnalysis {
+public:
+    void analyze(const uint8_t* memory, const std::vector<Segment>& segments, const uint8_t* operations,
+                 const SymbolTable& symbols);
+    void clear();
+
+    const std::vector<BasicBlock>& blocks() const { return blockList; }
+    const std::vector<Loop>& loops() const { return loopList; }
+    // Block holding the address, -1 if none
+    int blockAt(int address) const;
+    // Sum the bus wait states the interpreter charged per instruction address into the blocks and loops; the
+    // rest of the total was charged outside the analyzed blocks
+    void setBusCycles(const std::function<uint64_t(int)>& perInstruction, uint64_t total);
+    // Bus wait states of instructions outside the analyzed blocks (code run from outside the text segments)
+    uint64_t unattributedBusCycles() const { return unattributed; }
+    // Plain text report: loops innermost first with their blocks, then every block
+    QString report(const SymbolTable& symbols) const;
+
+    // Cycle cost of a taken jump or jr: the prefetch queue is refilled
+    static const int TakenJumpCycles = 2;
+
+private:
+    struct Instruction {
+        int address;
+        int size;
+        uint8_t operation;
+        uint8_t reg1;
+        uint8_t reg2;
+        int target;         // jump/jr target, -1 when unknown
+    };
+
+    void Decode(const uint8_t* memory, const Segment& segment, const uint8_t* operations, std::vector<Instruction>& code);
+    void BuildBlocks(const std::vector<Instruction>& code, const std::vector<Segment>& segments, const SymbolTable& symbols);
+    void EstimateCycles(BasicBlock& block, const std::vector<Instruction>& code, int first, int last);
+    void ComputeDominators();
+    void FindLoops();
+    bool Dominates(int a, int b) const;
+
+    std::vector<BasicBlock> blockList;
+    std::vector<Loop> loopList;
+    uint64_t unattributed = 0;
+};
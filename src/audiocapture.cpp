@@ -0,0 +1,225 @@
+#include <chrono>
+#include <cmath>
+#include "audiocapture.h"
+#include "pacer.h"
+
+// Output samples kept before a write to the file
+static const size_t FlushSamples = 64 * 1024;
+// Size of the RIFF and fmt chunks before the samples
+static const int WavHeaderSize = 44;
+
+
+// Little-endian fields of the WAV header
+static void Put16(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+static void Put32(uint8_t* p, uint32_t value) {
+    Put16(p, value & 0xFFFF);
+    Put16(p + 2, value >> 16);
+}
+
+
+// 16-bit stereo PCM header for 'dataBytes' bytes of samples
+static QByteArray WavHeader(int rate, uint32_t dataBytes) {
+    uint8_t h[WavHeaderSize] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' };
+    Put32(h + 4, dataBytes + WavHeaderSize - 8);
+    Put32(h + 16, 16);          // fmt chunk size
+    Put16(h + 20, 1);           // PCM
+    Put16(h + 22, 2);           // channels
+    Put32(h + 24, rate);
+    Put32(h + 28, rate * 4);    // bytes per second
+    Put16(h + 32, 4);           // bytes per frame
+    Put16(h + 34, 16);          // bits per sample
+    h[36] = 'd'; h[37] = 'a'; h[38] = 't'; h[39] = 'a';
+    Put32(h + 40, dataBytes);
+    return QByteArray(reinterpret_cast<const char*>(h), WavHeaderSize);
+}
+
+
+// Frames per second of the I2S clock for a frame period in cycles
+static int NativeRate(uint64_t period) {
+    return static_cast<int>(std::lround(JaguarClockHz / period));
+}
+
+
+// A capture still running completes its file up to the last store
+AudioCapture::~AudioCapture() {
+    if (active)
+        stop(lastCycle);
+}
+
+
+// Open the file with an empty header, then start the writer from the current DAC state
+bool AudioCapture::start(const QString& filename, int rate, AudioClock frameClock, int sclk, uint64_t cycle) {
+    if (active)
+        stop(lastCycle);
+    error.clear();
+    period = 64 * (static_cast<uint64_t>(sclk & 0xFF) + 1);
+    resample = rate > 0;
+    outputRate = resample ? rate : NativeRate(period);
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail(QString("Cannot write %1").arg(filename));
+    file.write(WavHeader(outputRate, 0));
+
+    clock = frameClock;
+    nextFrame = cycle + period;
+    frameCycle = lastCycle = cycle;
+    left = right = 0;
+    havePrevious = false;
+    outputPeriod = resample ? JaguarClockHz / rate : 0.0;
+    nextOutput = 0.0;
+    samples.clear();
+    frames.store(0, std::memory_order_relaxed);
+    waits = 0;
+    ring.reset();
+    active = true;
+    writer = std::thread(&AudioCapture::Run, this);
+    return true;
+}
+
+
+// Queue the end of the stream, wait for the writer, then fill in the sizes of the header
+bool AudioCapture::stop(uint64_t cycle) {
+    if (!active)
+        return true;
+    Store end = { cycle, 0, End };
+    if (!ring.push(end))
+        WaitForRoom(end);
+    writer.join();
+    active = false;
+    uint64_t dataBytes = frames.load(std::memory_order_relaxed) * 4;
+    if (dataBytes > 0xFFFFFFFFull - WavHeaderSize)
+        dataBytes = 0xFFFFFFFFull - WavHeaderSize;
+    if (file.seek(0))
+        file.write(WavHeader(outputRate.load(std::memory_order_relaxed), static_cast<uint32_t>(dataBytes)));
+    bool ok = error.isEmpty() && (file.error() == QFile::NoError);
+    if (!ok && error.isEmpty())
+        error = QString("Error while writing %1").arg(file.fileName());
+    file.close();
+    return ok;
+}
+
+
+// Producer: the writer is a whole ring behind; yield until it makes room
+void AudioCapture::WaitForRoom(const Store& s) {
+    ++waits;
+    while (!ring.push(s))
+        std::this_thread::yield();
+}
+
+
+// Writer: drain the ring in batches, sleeping while it is empty, until the end of the stream
+void AudioCapture::Run() {
+    std::vector<Store> batch(4096);
+    for (;;) {
+        size_t count = ring.pop(batch.data(), batch.size());
+        if (!count) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!Apply(batch[i])) {
+                Flush();
+                return;
+            }
+        }
+    }
+}
+
+
+// Apply one store to the DAC state, producing the frames it ends; false at the end of the stream
+bool AudioCapture::Apply(const Store& s) {
+    if (s.cycle < frameCycle) // The cycle count was reset: the frame clock restarts with it
+        nextFrame = s.cycle + period;
+    frameCycle = s.cycle;
+    if (clock == AudioClock::Cycles) {
+        // The DAC outputs the values it holds at each frame of the I2S clock before the store
+        while (nextFrame <= s.cycle) {
+            Frame(nextFrame);
+            nextFrame += period;
+        }
+    }
+    switch (s.kind) {
+    case Left:
+        left = static_cast<int16_t>(s.value & 0xFFFF);
+        break;
+    case Right:
+        right = static_cast<int16_t>(s.value & 0xFFFF);
+        if (clock == AudioClock::Writes) {
+            Frame(nextFrame); // Timed as the I2S interrupt would, one frame period apart
+            nextFrame += period;
+        }
+        break;
+    case Clock:
+        period = 64 * (static_cast<uint64_t>(s.value & 0xFF) + 1);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+
+// A frame of the DAC at a cycle. Without resampling it is written as is, and the file takes the frame rate of
+// the first one: programs usually set SCLK just before they start the DAC. Otherwise the output samples up to
+// it are interpolated between it and the previous frame.
+void AudioCapture::Frame(uint64_t cycle) {
+    if (!resample) {
+        if (!havePrevious) {
+            havePrevious = true;
+            outputRate.store(NativeRate(period), std::memory_order_relaxed);
+        }
+        Emit(left, right);
+        return;
+    }
+    if (!havePrevious || (cycle <= previousCycle)) {
+        havePrevious = true;
+        nextOutput = static_cast<double>(cycle);
+    }
+    else {
+        double span = static_cast<double>(cycle - previousCycle);
+        while (nextOutput < static_cast<double>(cycle)) {
+            double t = (nextOutput - previousCycle) / span;
+            Emit(static_cast<int16_t>(std::lround(previousLeft + (left - previousLeft) * t)),
+                 static_cast<int16_t>(std::lround(previousRight + (right - previousRight) * t)));
+            nextOutput += outputPeriod;
+        }
+    }
+    previousCycle = cycle;
+    previousLeft = left;
+    previousRight = right;
+}
+
+
+// Append an output frame, writing the buffer when it is full
+void AudioCapture::Emit(int16_t leftSample, int16_t rightSample) {
+    samples.push_back(leftSample);
+    samples.push_back(rightSample);
+    if (samples.size() >= FlushSamples)
+        Flush();
+}
+
+
+// Write the buffered samples, little-endian
+void AudioCapture::Flush() {
+    if (samples.empty())
+        return;
+    QByteArray bytes(static_cast<int>(samples.size() * 2), '\0');
+    uint8_t* p = reinterpret_cast<uint8_t*>(bytes.data());
+    for (size_t i = 0; i < samples.size(); ++i)
+        Put16(p + 2 * i, static_cast<uint16_t>(samples[i]));
+    if ((file.write(bytes) != bytes.size()) && error.isEmpty())
+        error = QString("Error while writing %1").arg(file.fileName());
+    frames.fetch_add(samples.size() / 2, std::memory_order_relaxed);
+    samples.clear();
+}
+
+
+// Record an error for errorString(); returns false
+bool AudioCapture::fail(const QString& message) {
+    error = message;
+    return false;
+}
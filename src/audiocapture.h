@@ -0,0 +1,93 @@
+#pragma once
+#include <QString>
+#include <QFile>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "spscring.h"
+
+// Jerry I2S registers: DAC data of the left and right channels, serial clock divider
+const int I2SLeft = 0xF1A148;
+const int I2SRight = 0xF1A14C;
+const int I2SClock = 0xF1A150;
+
+// What times the frames of a capture
+enum class AudioClock {
+    Cycles,     // the I2S frame clock, 64 * (SCLK + 1) cycles: the DAC values are sampled at each frame
+    Writes      // the I2S interrupt: each write to the right channel ends a frame
+};
+
+// AudioCapture: the stores to the I2S DAC registers, streamed to a 16-bit stereo WAV file. The interpreter
+// pushes each store with its cycle into a lock-free ring; a writer thread rebuilds the frames, resamples them
+// to the output rate if one is set, and writes the file. The interpreter only waits if the writer falls a
+// whole ring behind, so the captured stream is complete however long the run.
+class AudioCapture {
+public:
+    static const size_t RingStores = 1 << 18;
+
+    AudioCapture() : ring(RingStores) {}
+    ~AudioCapture();
+    AudioCapture(const AudioCapture&) = delete;
+    AudioCapture& operator=(const AudioCapture&) = delete;
+
+    // Create the file and start the writer; 'rate' 0 keeps the I2S frame rate given by 'sclk'
+    bool start(const QString& filename, int rate, AudioClock clock, int sclk, uint64_t cycle);
+    // Write the frames up to 'cycle' and complete the file
+    bool stop(uint64_t cycle);
+    bool isActive() const { return active; }
+
+    // A store of the interpreter to one of the I2S registers
+    void store(int adrs, int data, uint64_t cycle) {
+        Store s = { cycle, static_cast<uint32_t>(data), static_cast<uint8_t>((adrs - I2SLeft) >> 2) };
+        if (!ring.push(s))
+            WaitForRoom(s);
+        lastCycle = cycle;
+    }
+
+    QString fileName() const { return file.fileName(); }
+    int sampleRate() const { return outputRate.load(std::memory_order_relaxed); }
+    uint64_t framesWritten() const { return frames.load(std::memory_order_relaxed); }
+    uint64_t producerWaits() const { return waits; }
+    QString errorString() const { return error; }
+
+private:
+    enum Kind : uint8_t { Left, Right, Clock, End };
+    struct Store {
+        uint64_t cycle;
+        uint32_t value;
+        uint8_t kind;
+    };
+
+    void WaitForRoom(const Store& s);
+    void Run();
+    bool Apply(const Store& s);
+    void Frame(uint64_t cycle);
+    void Emit(int16_t leftSample, int16_t rightSample);
+    void Flush();
+    bool fail(const QString& message);
+
+    SpscRing<Store> ring;
+    std::thread writer;
+    bool active = false;
+    uint64_t lastCycle = 0;             // producer: cycle of the last store
+    uint64_t waits = 0;                 // producer: stores that found the ring full
+    std::atomic<uint64_t> frames{ 0 };  // frames written to the file
+    QFile file;
+    std::atomic<int> outputRate{ 0 };
+    QString error;
+
+    // Writer state
+    AudioClock clock = AudioClock::Cycles;
+    bool resample = false;
+    uint64_t period = 64;               // cycles per I2S frame
+    uint64_t nextFrame = 0;             // cycle of the next frame, with the I2S frame clock
+    uint64_t frameCycle = 0;            // last store seen
+    int16_t left = 0, right = 0;        // DAC values
+    bool havePrevious = false;          // resampler: the last input frame
+    uint64_t previousCycle = 0;
+    int16_t previousLeft = 0, previousRight = 0;
+    double outputPeriod = 0.0;          // cycles per output sample
+    double nextOutput = 0.0;
+    std::vector<int16_t> samples;       // interleaved, not written yet
+};
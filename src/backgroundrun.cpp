@@ -0,0 +1,72 @@
+#include "backgroundrun.h"
+
+// Bind the runner to the debugger it drives
+BackgroundRun::BackgroundRun(Debugger* debugger) : debugger(debugger) {
+}
+
+
+// Stop and join a run still active
+BackgroundRun::~BackgroundRun() {
+    if (isActive()) {
+        requestStop();
+        join();
+    }
+}
+
+
+// Start the worker thread. Diagnostics are collected instead of shown as message boxes from the worker
+bool BackgroundRun::start() {
+    if (isActive() || !debugger->canRun())
+        return false;
+    stopRequested.store(false, std::memory_order_relaxed);
+    done.store(false, std::memory_order_relaxed);
+    messages.clear();
+    wasInteractive = debugger->isInteractive();
+    debugger->setInteractive(false);
+    // No context object: the functor runs in the emitting (worker) thread
+    diagnostics = QObject::connect(debugger, &Debugger::diagnostic, [this](const QString& text) {
+        std::lock_guard<std::mutex> lock(messageLock);
+        messages << text;
+    });
+    worker = std::thread(&BackgroundRun::Run, this);
+    return true;
+}
+
+
+// Ask the worker to stop after its current chunk
+void BackgroundRun::requestStop() {
+    stopRequested.store(true, std::memory_order_relaxed);
+}
+
+
+// Wait for the worker and give the Debugger back to the caller's thread
+QStringList BackgroundRun::join() {
+    if (worker.joinable())
+        worker.join();
+    QObject::disconnect(diagnostics);
+    debugger->setInteractive(wasInteractive);
+    std::lock_guard<std::mutex> lock(messageLock);
+    QStringList result = messages;
+    messages.clear();
+    return result;
+}
+
+
+// Newest published snapshot, if newer than the last one returned
+bool BackgroundRun::latest(const CoreSnapshot*& snapshot) {
+    if (!snapshots.update())
+        return false;
+    snapshot = &snapshots.front();
+    return true;
+}
+
+
+// Worker: run chunks until the program stops or a stop is requested, publishing the state after each one
+void BackgroundRun::Run() {
+    do {
+        debugger->runSlice(ChunkInstructions, UINT64_MAX);
+        debugger->snapshot(snapshots.back());
+        snapshots.publish();
+    } while ((debugger->getStopReason() == StopReason::Budget) && !stopRequested.load(std::memory_order_relaxed));
+    done.store(true, std::memory_order_release);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "debugger.h"
+#include "triplebuffer.h"
+
+// BackgroundRun: a full-speed run on a worker thread. The worker executes chunks of instructions and, after
+// each one, publishes a CoreSnapshot through a triple buffer and checks for a stop request; the interpreter
+// loop itself is unchanged. While the run is active the worker owns the Debugger: the UI only reads
+// snapshots. Diagnostics raised during the run are collected and handed over once it is joined.
+class BackgroundRun {
+public:
+    explicit BackgroundRun(Debugger* debugger);
+    ~BackgroundRun();
+    BackgroundRun(const BackgroundRun&) = delete;
+    BackgroundRun& operator=(const BackgroundRun&) = delete;
+
+    // Start the worker; false if a run is already active or nothing is loaded
+    bool start();
+    // Ask the worker to stop after its current chunk
+    void requestStop();
+    // The worker was started and not joined yet
+    bool isActive() const { return worker.joinable(); }
+    // The worker has returned; join() will not wait
+    bool finished() const { return done.load(std::memory_order_acquire); }
+    // Wait for the worker; returns the diagnostics of the run
+    QStringList join();
+    // Newest snapshot published by the worker; false if there is nothing new since the last call
+    bool latest(const CoreSnapshot*& snapshot);
+
+    // Instructions between two snapshots and stop request checks (a few ms at full speed)
+    static const uint64_t ChunkInstructions = 256 * 1024;
+
+private:
+    void Run();
+
+    Debugger* debugger;
+    std::thread worker;
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<bool> done{ false };
+    bool wasInteractive = true;
+    TripleBuffer<CoreSnapshot> snapshots;
+    std::mutex messageLock;
+    QStringList messages;
+    QMetaObject::Connection diagnostics;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// CoreState: register file and flags of the emulated GPU/DSP, laid out for the interpreter loop.
+// Both banks sit in one fixed array; 'active' and 'alternate' are swapped on a bank switch so instructions
+// never index by the bank number. Flags are kept in the form the last instruction produced them and only
+// derived when a condition, addc/subc or the UI reads them:
+//   Z = (zResult == 0), N = (nResult < 0), C = bit 32 of the 33-bit add/sub result in 'carry'.
+struct alignas(64) CoreState {
+    int32_t regs[2][32];
+    int32_t* active = regs[0];      // bank selected by REGPAGE
+    int32_t* alternate = regs[1];   // target of moveta, source of movefa
+    int bank = 0;
+    uint32_t zResult = 1;
+    int32_t nResult = 0;
+    uint64_t carry = 0;
+    int64_t accumulator = 0;        // imultn/imacn sum read back by resmac
+
+    CoreState() { reset(); }
+    CoreState(const CoreState&) = delete;
+    CoreState& operator=(const CoreState&) = delete;
+
+    void reset() {
+        std::memset(regs, 0, sizeof(regs));
+        selectBank(0);
+        setFlags(0, 0, 0);
+        accumulator = 0;
+    }
+
+    void selectBank(int b) {
+        bank = b & 1;
+        active = regs[bank];
+        alternate = regs[bank ^ 1];
+    }
+
+    int z() const { return zResult == 0; }
+    int n() const { return nResult < 0; }
+    int c() const { return static_cast<int>((carry >> 32) & 1); }
+
+    void setFlags(int zf, int cf, int nf) {
+        zResult = zf ? 0 : 1;
+        nResult = nf ? -1 : 0;
+        setCarry(cf);
+    }
+    void setCarry(int cf) { carry = static_cast<uint64_t>(cf & 1) << 32; }
+
+    // Z and N from the result
+    void setResult(int32_t value) {
+        zResult = static_cast<uint32_t>(value);
+        nResult = value;
+    }
+
+    // b + a + carry in, all flags
+    int32_t add(int32_t a, int32_t b, uint32_t carryIn = 0) {
+        carry = static_cast<uint64_t>(static_cast<uint32_t>(a)) + static_cast<uint32_t>(b) + carryIn;
+        setResult(static_cast<int32_t>(carry));
+        return static_cast<int32_t>(carry);
+    }
+
+    // b - a - borrow in, all flags; the borrow lands in bit 32 as the 64-bit difference wraps
+    int32_t sub(int32_t a, int32_t b, uint32_t borrowIn = 0) {
+        carry = static_cast<uint64_t>(static_cast<uint32_t>(b)) - static_cast<uint32_t>(a) - borrowIn;
+        setResult(static_cast<int32_t>(carry));
+        return static_cast<int32_t>(carry);
+    }
+};
@@ -0,0 +1,218 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+#include "coverage.h"
+
+// Number of bits set in a bitmap word
+static int BitCount(uint64_t bits) {
+    int count = 0;
+    for (; bits; bits &= bits - 1)
+        ++count;
+    return count;
+}
+
+// Append a big-endian value
+static void Put32(QByteArray& out, uint32_t value) {
+    char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+    out.append(bytes, 4);
+}
+
+static void Put64(QByteArray& out, uint64_t value) {
+    Put32(out, static_cast<uint32_t>(value >> 32));
+    Put32(out, static_cast<uint32_t>(value));
+}
+
+// Read a big-endian value; the caller checks the size
+static uint64_t Get(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+
+// Allocate the bitmaps, one bit per instruction word
+void Coverage::resize(int size) {
+    size_t words = (static_cast<size_t>(size) / 2 + 63) / 64;
+    executedBits.assign(words, 0);
+    takenBits.assign(words, 0);
+    notTakenBits.assign(words, 0);
+    if (size == 0) {
+        executedBits.shrink_to_fit();
+        takenBits.shrink_to_fit();
+        notTakenBits.shrink_to_fit();
+    }
+}
+
+
+// Forget what was recorded
+void Coverage::clear() {
+    std::fill(executedBits.begin(), executedBits.end(), 0);
+    std::fill(takenBits.begin(), takenBits.end(), 0);
+    std::fill(notTakenBits.begin(), notTakenBits.end(), 0);
+}
+
+
+// Count the instructions executed and the branch outcomes seen
+void Coverage::totals(int& instructions, int& takenBranches, int& notTakenBranches) const {
+    instructions = takenBranches = notTakenBranches = 0;
+    for (size_t i = 0; i < executedBits.size(); ++i) {
+        if (!executedBits[i])
+            continue;
+        instructions += BitCount(executedBits[i]);
+        takenBranches += BitCount(takenBits[i]);
+        notTakenBranches += BitCount(notTakenBits[i]);
+    }
+}
+
+
+// Write the magic, the version, the image hash, the bitmap size, then every non-empty word: index and the three
+// bitmaps
+bool Coverage::save(const QString& filename) const {
+    QByteArray out;
+    Put32(out, Magic);
+    Put32(out, Version);
+    Put64(out, image);
+    Put32(out, static_cast<uint32_t>(executedBits.size()));
+    for (size_t i = 0; i < executedBits.size(); ++i) {
+        if (!executedBits[i])
+            continue;
+        Put32(out, static_cast<uint32_t>(i));
+        Put64(out, executedBits[i]);
+        Put64(out, takenBits[i]);
+        Put64(out, notTakenBits[i]);
+    }
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(QString("Cannot write %1").arg(filename));
+    if (file.write(out) != out.size())
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// OR the bitmaps of a file written by save(); nothing is merged unless the whole file is valid
+bool Coverage::merge(const QString& filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(QString("Cannot open %1").arg(filename));
+    QByteArray data = file.readAll();
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.constData());
+    const int headerSize = 20, recordSize = 4 + 3 * 8;
+    if ((data.size() < 8) || (Get(p, 4) != Magic))
+        return fail("Not a coverage file.");
+    if (Get(p + 4, 4) != Version)
+        return fail(QString("Coverage file version %1 is not supported (expected %2).").arg(Get(p + 4, 4)).arg(Version));
+    if (data.size() < headerSize)
+        return fail("Corrupt coverage file.");
+    uint64_t fileImage = Get(p + 8, 8);
+    if (image && fileImage && (fileImage != image))
+        return fail(QString("%1 was recorded for another image.").arg(filename));
+    if (Get(p + 16, 4) != executedBits.size())
+        return fail("The coverage file was recorded for another memory size.");
+    if ((data.size() - headerSize) % recordSize)
+        return fail("Corrupt coverage file.");
+    for (const uint8_t* r = p + headerSize; r < p + data.size(); r += recordSize) {
+        if (Get(r, 4) >= executedBits.size())
+            return fail("Corrupt coverage file.");
+    }
+    if (!image)
+        image = fileImage;
+    for (const uint8_t* r = p + headerSize; r < p + data.size(); r += recordSize) {
+        size_t i = static_cast<size_t>(Get(r, 4));
+        executedBits[i] |= Get(r + 4, 8);
+        takenBits[i] |= Get(r + 12, 8);
+        notTakenBits[i] |= Get(r + 20, 8);
+    }
+    return true;
+}
+
+
+// Write the listing, then the lcov records of its instruction lines ("$ADDRESS: text")
+bool Coverage::writeLcov(const QString& filename, const QString& listingFile, const QStringList& listing,
+                         const SymbolTable& symbols, const std::function<bool(int)>& isConditional) const {
+    QFile lst(listingFile);
+    if (!lst.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(listingFile));
+    QTextStream lstOut(&lst);
+    for (const QString& line : listing)
+        lstOut << line << "\n";
+    lstOut.flush();
+    lst.close();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(filename));
+    QTextStream out(&file);
+    out << "TN:\nSF:" << QFileInfo(listingFile).absoluteFilePath() << "\n";
+
+    // Listing line of every instruction
+    std::vector<std::pair<int, int>> lines;
+    for (int i = 0; i < listing.size(); ++i) {
+        const QString& text = listing[i];
+        int colon = text.indexOf(": ");
+        bool ok = false;
+        int adrs = (text.startsWith('$') && (colon > 1)) ? text.mid(1, colon - 1).toInt(&ok, 16) : 0;
+        if (ok)
+            lines.push_back(std::make_pair(adrs, i + 1));
+    }
+
+    // Code symbols starting on an instruction line are the functions
+    QString hits;
+    int functions = 0, functionsHit = 0;
+    for (const Symbol& sym : symbols.all()) {
+        if (sym.kind != SymbolKind::Code)
+            continue;
+        auto line = std::lower_bound(lines.begin(), lines.end(), std::make_pair(sym.address, 0));
+        if ((line == lines.end()) || (line->first != sym.address))
+            continue;
+        bool hit = isExecuted(sym.address);
+        out << "FN:" << line->second << "," << sym.name << "\n";
+        hits += QString("FNDA:%1,%2\n").arg(hit ? 1 : 0).arg(sym.name);
+        ++functions;
+        if (hit)
+            ++functionsHit;
+    }
+    out << hits << "FNF:" << functions << "\nFNH:" << functionsHit << "\n";
+
+    int branches = 0, branchesHit = 0;
+    for (const auto& line : lines) {
+        if (!isConditional(line.first))
+            continue;
+        bool reached = isExecuted(line.first);
+        bool outcomes[2] = { isTaken(line.first), isNotTaken(line.first) };
+        for (int b = 0; b < 2; ++b) {
+            out << "BRDA:" << line.second << ",0," << b << ",";
+            if (reached)
+                out << (outcomes[b] ? 1 : 0);
+            else
+                out << "-";
+            out << "\n";
+            ++branches;
+            if (outcomes[b])
+                ++branchesHit;
+        }
+    }
+    out << "BRF:" << branches << "\nBRH:" << branchesHit << "\n";
+
+    int linesHit = 0;
+    for (const auto& line : lines) {
+        bool hit = isExecuted(line.first);
+        out << "DA:" << line.second << "," << (hit ? 1 : 0) << "\n";
+        if (hit)
+            ++linesHit;
+    }
+    out << "LF:" << lines.size() << "\nLH:" << linesHit << "\nend_of_record\n";
+    out.flush();
+    if (file.error() != QFile::NoError)
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// Record an error for errorString(); returns false
+bool Coverage::fail(const QString& message) const {
+    error = message;
+    return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include "symbols.h"
+
+// Output of a coverage export
+enum class CoverageFormat {
+    Bitmaps,    // the native .jcov file, merged by later runs
+    Lcov        // an lcov tracefile over the listing
+};
+
+// Coverage: instructions executed and outcomes of conditional jr/jump, one bit per instruction word of the
+// address space in three bitmaps. Recording an instruction is a single OR, so the mode can stay on for batch
+// runs. Bitmaps saved by several runs of the same image merge with an OR; the lcov export maps them to the
+// disassembly listing.
+class Coverage {
+public:
+    static const uint32_t Magic = 0x4A524356;  // "JRCV"
+    static const uint32_t Version = 2;
+
+    // Allocate the bitmaps for 'size' bytes, nothing recorded; an empty size frees them
+    void resize(int size);
+    bool isEnabled() const { return !executedBits.empty(); }
+    void clear();
+    // Hash of the image the bitmaps were recorded for, 0 if none is known yet
+    uint64_t getImage() const { return image; }
+    void setImage(uint64_t hash) { image = hash; }
+
+    // Record the instruction at an address, and the outcome of a conditional branch
+    void execute(int adrs) { executedBits[Word(adrs)] |= Bit(adrs); }
+    void branch(int adrs, bool taken) { (taken ? takenBits : notTakenBits)[Word(adrs)] |= Bit(adrs); }
+
+    bool isExecuted(int adrs) const { return Test(executedBits, adrs); }
+    bool isTaken(int adrs) const { return Test(takenBits, adrs); }
+    bool isNotTaken(int adrs) const { return Test(notTakenBits, adrs); }
+    // Instructions executed, branches taken, branches not taken
+    void totals(int& instructions, int& takenBranches, int& notTakenBranches) const;
+
+    // Native file: the image hash and the non-empty bitmap words; merge() ORs a file recorded for the same image
+    // into the bitmaps, or for any image while none is known, and takes its image
+    bool save(const QString& filename) const;
+    bool merge(const QString& filename);
+    // lcov tracefile over a listing written beside it: DA per instruction line, BRDA per conditional branch,
+    // FN/FNDA per code symbol
+    bool writeLcov(const QString& filename, const QString& listingFile, const QStringList& listing,
+                   const SymbolTable& symbols, const std::function<bool(int)>& isConditional) const;
+
+    QString errorString() const { return error; }
+
+private:
+    static size_t Word(int adrs) { return static_cast<size_t>(adrs) >> 7; }
+    static uint64_t Bit(int adrs) { return uint64_t(1) << ((adrs >> 1) & 63); }
+    static bool Test(const std::vector<uint64_t>& bits, int adrs) {
+        return (adrs >= 0) && (Word(adrs) < bits.size()) && (bits[Word(adrs)] & Bit(adrs));
+    }
+    bool fail(const QString& message) const;
+
+    std::vector<uint64_t> executedBits;
+    std::vector<uint64_t> takenBits;
+    std::vector<uint64_t> notTakenBits;
+    uint64_t image = 0;
+    mutable QString error;
+};
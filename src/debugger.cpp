@@ -2,13 +2,21 @@
 #include <QStringList>
 #include <QDebug> // For debugging purposes
 #include <QFile>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QByteArray>
 #include <vector>
 #include <sstream>
 #include <iomanip>
 #include <functional>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
 #include "debugger.h"
+#include "mmult.h"
+#include "savestate.h"
+#include "statediff.h"
+#include "pacer.h"
 
 // Add this near the top, after the includes:
 template <typename T>
@@ -19,6 +27,97 @@ const T& clamp(const T& v, const T& lo, const T& hi) {
 const int MemorySize = 0xF1D000; // Address limit for the RISC processor
 std::vector<uint8_t> MemoryBuffer(MemorySize);
 
+static const uint8_t GPUOperations[64] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+    48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63
+};
+
+// The DSP has modulo addressing, signed saturation and mirror instead of sat8/sat16, loadp/storep,
+// sat24 and pack/unpack, and a 40-bit accumulator
+static const uint8_t DSPOperations[64] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, OpResmac40, OpImacn40, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    OpSubqmod, OpSat16s, 34, 35, 36, 37, 38, 39, 40, 41, OpSat32s, 43, 44, 45, 46, 47,
+    OpMirror, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, OpIllegal, OpAddqmod
+};
+
+// Approximate wait states by region (DRAM, cartridge, TOM, GPU RAM, JERRY, DSP RAM, other). The GPU reaches
+// DRAM over the 64-bit bus, with posted writes; the DSP goes through JERRY's 16-bit bus, so a long takes two
+// transfers; either core reaching the other one's RAM or registers crosses both chips
+static const BusTiming GPUBus[RegionCount] = {
+    { 3, 6, 2 }, { 5, 10, 10 }, { 0, 0, 0 }, { 0, 0, 0 }, { 10, 10, 6 }, { 10, 10, 6 }, { 0, 0, 0 }
+};
+static const BusTiming DSPBus[RegionCount] = {
+    { 5, 10, 4 }, { 8, 16, 16 }, { 10, 10, 6 }, { 10, 10, 6 }, { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }
+};
+
+// Interrupt sources, by number: the vector of source n is at RAM + 0x10 * n
+static const char* const GPUInterrupts[] = { "CPU", "DSP", "Timer", "Object processor", "Blitter" };
+static const char* const DSPInterrupts[] = { "CPU", "I2S", "Timer 1", "Timer 2", "External 0", "External 1" };
+
+const Debugger::CoreModel Debugger::GPUModel = {
+    "GPU", GPUOperations, 0xF02100, 0xF02104, 0xF02108, 0xF02114, 0xF0211C, 0xF03000, 4 * 1024, GPUBus,
+    5, GPUInterrupts
+};
+const Debugger::CoreModel Debugger::DSPModel = {
+    "DSP", DSPOperations, 0xF1A100, 0xF1A104, 0xF1A108, 0xF1A114, 0xF1A11C, 0xF1B000, 8 * 1024, DSPBus,
+    6, DSPInterrupts
+};
+
+// Interrupt bits of FLAGS and CTRL: sources 0-4 have their enable, clear and latch bits in a row, the DSP's
+// source 5 was added above them
+static const int FlagIMASK = 1 << 3;
+static const int CtrlForce0 = 1 << 2; // raises source 0
+static const int InterruptCycles = 3; // the jump to the vector refills the prefetch queue
+
+// Longest loop body, in bytes, the idle loop detection looks at
+static const int IdleLoopBytes = 64;
+
+static int EnableBit(int source) {
+    return (source < 5) ? (1 << (4 + source)) : (1 << 16);
+}
+
+static int ClearBit(int source) {
+    return (source < 5) ? (1 << (9 + source)) : (1 << 17);
+}
+
+static int LatchBit(int source) {
+    return (source < 5) ? (1 << (6 + source)) : (1 << 16);
+}
+
+// FNV-1a of the segment table and the bytes the file provided, to tell whether a load is the same image
+static uint64_t ImageHash(const std::vector<Segment>& segments) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&hash](uint32_t value) {
+        for (int i = 0; i < 4; ++i)
+            hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 0x100000001B3ull;
+    };
+    for (const Segment& seg : segments) {
+        mix(static_cast<uint32_t>(seg.kind));
+        mix(static_cast<uint32_t>(seg.address));
+        mix(static_cast<uint32_t>(seg.size));
+        if (seg.kind == SegmentKind::Bss)
+            continue;
+        const uint8_t* walk = MemoryBuffer.data() + seg.address;
+        for (int i = 0; i < seg.size; ++i)
+            hash = (hash ^ walk[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Approximate cycles per operation with no bus contention: one per instruction through the pipeline, plus the
+// stall a dependent instruction sees (movei fetches two more words, loads wait for local RAM, div takes 18
+// cycles, taken jumps refill the prefetch queue)
+static const uint8_t OperationCycles[OperationCount] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // add .. bclr
+    1, 1, 1, 1, 1, 18, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,    // mult .. cmpq
+    1, 1, 1, 1, 1, 1, 3, 2, 2, 2, 3, 2, 2, 1, 1, 1,     // sat8 .. store
+    1, 1, 1, 1, 3, 3, 4, 1, 1, 1, 2, 2, 1, 1, 1, 1,     // storep .. pack
+    1, 1, 1, 1, 1, 1, 1, 1                              // subqmod .. illegal
+};
+
 // Constructor: Initialize the state
 Debugger::Debugger(QObject* parent)
     : QObject(parent), // Initialize the QObject base class
@@ -29,8 +128,9 @@ Debugger::Debugger(QObject* parent)
       progress(0),
       pc(0),
       programSize(0) {
-    regBank[0].resize(32, 0);
-    regBank[1].resize(32, 0);
+    breakpointMap.resize((MemorySize / 2 + 31) / 32, 0);
+    dirtyPages.resize(((MemorySize >> DirtyPageShift) + 31) / 32, 0);
+    writtenPages.resize(dirtyPages.size(), 0);
 }
 
 // Destructor: Clean up resources if needed
@@ -46,101 +146,290 @@ bool Debugger::canReset() const {
 }
 
 bool Debugger::loadBin(const QString& filename, int address) {
-    int LoadAddress = address;
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::critical(nullptr, "Error", "Error while loading file.");
+    ImageLoader loader;
+    if (!loader.load(filename, address)) {
+        Diagnostic(QMessageBox::Critical, "Error", loader.errorString());
         return false;
     }
 
-    qint64 fileSize = file.size();
-    if (fileSize > (MemorySize - LoadAddress)) {
-        QMessageBox::critical(nullptr, "Error", "File too large!");
-        file.close();
+    segments = loader.segments();
+    loadAddress = loader.entryPoint(); // <-- Store the entry point, used as reset PC
+    programSize = 0;
+    for (const Segment& seg : segments) {
+        if (seg.kind != SegmentKind::Bss)
+            programSize += seg.size;
+    }
+    segmentStart = segmentEnd = 0;
+    for (const Segment& seg : segments)
+        MarkPages(seg.address, seg.size);
+    resetCounters();
+    if (shadow.isEnabled())
+        ShadowDefineLoaded();
+    // Loading the same image again keeps the coverage, so batch runs accumulate; the bitmaps merged before the
+    // first load carry the image they were recorded for
+    uint64_t hash = ImageHash(segments);
+    if (coverage.isEnabled() && coverage.getImage() && (coverage.getImage() != hash)) {
+        coverage.clear(); // Recorded for another image
+        if (!imageHash)
+            Diagnostic(QMessageBox::Warning, "Coverage", "The coverage merged was recorded for another image: it is discarded.");
+    }
+    imageHash = hash;
+    coverage.setImage(hash);
+
+    isReadyToRun = true;
+    isReadyToStep = true;
+    isReadyToSkip = true;
+    isReadyToReset = true;
+
+    // Object file symbols, then a label for every branch target found in the code
+    symbols.clear();
+    symbols.addImported(loader.symbols());
+    CollectBranchLabels();
+    symbols.finalize(segments);
+    profiler.setFunctions(symbols);
+    ResolveHooks(true);
+    RebuildCodeView();
+    return true;
+}
+
+
+// Import symbols from a linker map or symbol listing and refresh the code view
+bool Debugger::loadSymbols(const QString& filename) {
+    QString error;
+    int count = symbols.importMapFile(filename, segments, &error);
+    if (count < 0) {
+        Diagnostic(QMessageBox::Critical, "Error", error);
         return false;
     }
+    symbols.finalize(segments);
+    profiler.setFunctions(symbols);
+    ResolveHooks(true);
+    RebuildCodeView();
+    return true;
+}
 
-    programSize = static_cast<int>(fileSize); // <-- Use member variable
-    int readOffset = LoadAddress;
-
-    QByteArray header = file.read(12);
-    if (header.size() == 12) {
-        int value = (static_cast<uint8_t>(header[0]) << 24) |
-                    (static_cast<uint8_t>(header[1]) << 16) |
-                    (static_cast<uint8_t>(header[2]) << 8)  |
-                    (static_cast<uint8_t>(header[3]));
-        if (value == 0x42533934) {
-            int newAddr = (static_cast<uint8_t>(header[4]) << 24) |
-                          (static_cast<uint8_t>(header[5]) << 16) |
-                          (static_cast<uint8_t>(header[6]) << 8)  |
-                          (static_cast<uint8_t>(header[7]));
-            LoadAddress = newAddr;
-            readOffset = LoadAddress;
-            programSize -= 12; // <-- Update member variable
-            QByteArray rest = file.read(programSize);
-            if (rest.size() != programSize) {
-                QMessageBox::critical(nullptr, "Error", "Error while loading file.");
-                file.close();
-                return false;
-            }
-            if (readOffset + programSize > MemorySize) {
-                QMessageBox::critical(nullptr, "Error", "File too large for memory.");
-                file.close();
-                return false;
-            }
-            std::copy(rest.begin(), rest.end(), MemoryBuffer.begin() + readOffset);
-        } else {
-            file.seek(0);
-            QByteArray all = file.read(programSize);
-            if (all.size() != programSize) {
-                QMessageBox::critical(nullptr, "Error", "Error while loading file.");
-                file.close();
-                return false;
-            }
-            if (readOffset + programSize > MemorySize) {
-                QMessageBox::critical(nullptr, "Error", "File too large for memory.");
-                file.close();
-                return false;
-            }
-            std::copy(all.begin(), all.end(), MemoryBuffer.begin() + readOffset);
-        }
-    } else {
-        file.seek(0);
-        QByteArray all = file.read(programSize);
-        if (all.size() != programSize) {
-            QMessageBox::critical(nullptr, "Error", "Error while loading file.");
-            file.close();
-            return false;
-        }
-        if (readOffset + programSize > MemorySize) {
-            QMessageBox::critical(nullptr, "Error", "File too large for memory.");
-            file.close();
-            return false;
+
+// Save the registers, flags, PC, pending jump, core, segments, symbols and the non-zero memory pages
+bool Debugger::saveState(const QString& filename, bool compress) {
+    MachineSnapshot snapshot;
+    CaptureState(snapshot);
+    SaveStateFile file;
+    if (!file.write(filename, snapshot.state, MemoryBuffer.data(), MemorySize, compress)) {
+        Diagnostic(QMessageBox::Critical, "Error", file.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+// Everything saveState() writes besides the memory; the snapshot memory is left alone
+void Debugger::CaptureState(MachineSnapshot& snapshot) const {
+    MachineState& state = snapshot.state;
+    state.gpuMode = isGPUMode();
+    state.pc = pc;
+    state.jumpTarget = JMPPC;
+    state.jumpPending = jumpbuffered;
+    state.loadAddress = loadAddress;
+    state.cycleCount = cycleCount;
+    std::memcpy(state.regs, core.regs, sizeof(state.regs));
+    state.bank = core.bank;
+    state.zResult = core.zResult;
+    state.nResult = core.nResult;
+    state.carry = core.carry;
+    state.accumulator = core.accumulator;
+    state.segments = segments;
+    state.symbols = symbols.all();
+}
+
+
+// Copy only the pages that may be non-zero; the rest of the snapshot memory stays clear
+void Debugger::captureSnapshot(MachineSnapshot& snapshot) const {
+    CaptureState(snapshot);
+    snapshot.memory.assign(MemorySize, 0);
+    snapshot.pages.resize(dirtyPages.size());
+    for (size_t i = 0; i < dirtyPages.size(); ++i) {
+        snapshot.pages[i] = dirtyPages[i] | writtenPages[i];
+        for (int bit = 0; bit < 32; ++bit) {
+            if (!((snapshot.pages[i] >> bit) & 1))
+                continue;
+            int adrs = static_cast<int>(i * 32 + bit) << DirtyPageShift;
+            int length = std::min(1 << DirtyPageShift, MemorySize - adrs);
+            std::memcpy(snapshot.memory.data() + adrs, MemoryBuffer.data() + adrs, length);
         }
-        std::copy(all.begin(), all.end(), MemoryBuffer.begin() + readOffset);
     }
+}
 
-    loadAddress = LoadAddress; // <-- Store the final load address
 
-    file.close();
+// Read a file written by saveState() for a comparison
+bool Debugger::loadSnapshot(const QString& filename, MachineSnapshot& snapshot) {
+    SaveStateFile file;
+    snapshot.memory.assign(MemorySize, 0);
+    if (!file.read(filename, snapshot.state, snapshot.memory.data(), MemorySize)) {
+        Diagnostic(QMessageBox::Critical, "Error", file.errorString());
+        return false;
+    }
+    snapshot.pages = file.storedPages();
+    return true;
+}
+
+
+// Restore a state written by saveState(); the counters restart, breakpoints and watchpoints are kept
+bool Debugger::loadState(const QString& filename) {
+    MachineState state;
+    SaveStateFile file;
+    if (!file.read(filename, state, MemoryBuffer.data(), MemorySize)) {
+        Diagnostic(QMessageBox::Critical, "Error", file.errorString());
+        return false;
+    }
+    writtenPages = file.storedPages();
+    model = state.gpuMode ? &GPUModel : &DSPModel;
+    std::memcpy(core.regs, state.regs, sizeof(core.regs));
+    core.selectBank(state.bank);
+    core.zResult = state.zResult;
+    core.nResult = state.nResult;
+    core.carry = state.carry;
+    core.accumulator = state.accumulator;
+    pc = state.pc;
+    JMPPC = state.jumpTarget;
+    jumpbuffered = state.jumpPending;
+    loadAddress = state.loadAddress;
+    cycleCount = state.cycleCount;
+    scheduler.restart(cycleCount); // The pattern starts over from the restored cycle count
+    cycleLimit = cycleCount;
+    breakpointPC = -1;
+    handlerSource = -1; // Latches and IMASK come back with the registers in memory
+    stopReason = StopReason::None;
+
+    segments = state.segments;
+    programSize = 0;
+    for (const Segment& seg : segments) {
+        if (seg.kind != SegmentKind::Bss)
+            programSize += seg.size;
+    }
+    segmentStart = segmentEnd = 0;
+    resetCounters();
+    if (shadow.isEnabled()) {
+        // The file does not tell which bytes were written: take them all as initialized
+        shadowFindings.clear();
+        shadowReported.clear();
+        shadowReports.clear();
+        shadow.defineAll();
+    }
     isReadyToRun = true;
     isReadyToStep = true;
     isReadyToSkip = true;
     isReadyToReset = true;
-    codeViewLines = disassemble(address, programSize);
+
+    symbols.clear();
+    for (const Symbol& sym : state.symbols)
+        symbols.add(sym.name, sym.address, sym.kind, sym.size, sym.global);
+    symbols.finalize(segments);
+    profiler.setFunctions(symbols);
+    ResolveHooks(true);
+    RebuildCodeView();
     return true;
 }
 
+
+// Get the symbol table
+const SymbolTable& Debugger::getSymbols() const {
+    return symbols;
+}
+
+
+// Disassemble every text segment, in address order
+void Debugger::RebuildCodeView() {
+    std::vector<Segment> text;
+    for (const Segment& seg : segments) {
+        if (seg.kind == SegmentKind::Text)
+            text.push_back(seg);
+    }
+    std::sort(text.begin(), text.end(), [](const Segment& a, const Segment& b) { return a.address < b.address; });
+    codeViewLines.clear();
+    for (const Segment& seg : text) {
+        if (text.size() > 1)
+            codeViewLines << QString("; %1 $%2-$%3").arg(seg.name)
+                .arg(QString::number(seg.address, 16).toUpper().rightJustified(8, '0'))
+                .arg(QString::number(seg.address + seg.size - 1, 16).toUpper().rightJustified(8, '0'));
+        codeViewLines << disassemble(seg.address, seg.size);
+    }
+}
+
+
+// Add a label for every jr target, and for jump (rN) targets loaded by a preceding movei
+void Debugger::CollectBranchLabels() {
+    for (const Segment& seg : segments) {
+        if (seg.kind != SegmentKind::Text)
+            continue;
+        int moveiValue[32];
+        uint32_t moveiKnown = 0;
+        int adrs = seg.address;
+        int end = seg.address + seg.size;
+        while (adrs + 1 < end) {
+            const uint8_t* walk = MemoryBuffer.data() + adrs;
+            uint8_t opcode = walk[0] >> 2;
+            uint8_t reg1 = ((walk[0] << 3) & 31) | (walk[1] >> 5);
+            uint8_t reg2 = walk[1] & 31;
+            adrs += 2;
+            switch (opcode) {
+            case 53: // jr
+                symbols.addAutoLabel((reg1 > 15) ? adrs - ((32 - reg1) * 2) : adrs + (reg1 * 2));
+                moveiKnown = 0;
+                break;
+            case 52: // jump
+                if (moveiKnown & (1u << reg1))
+                    symbols.addAutoLabel(moveiValue[reg1]);
+                moveiKnown = 0;
+                break;
+            case 38: // movei
+                if (adrs + 4 <= end) {
+                    moveiValue[reg2] = (walk[2] << 8) | walk[3] | (walk[4] << 24) | (walk[5] << 16);
+                    moveiKnown |= 1u << reg2;
+                }
+                adrs += 4;
+                break;
+            default:
+                moveiKnown &= ~(1u << reg2);
+                break;
+            }
+        }
+    }
+}
+
+
+// Find the text segment holding the address, caching its bounds for the run loop
+bool Debugger::InTextSegment(int adrs) {
+    if ((adrs >= segmentStart) && (adrs < segmentEnd))
+        return true;
+    for (const Segment& seg : segments) {
+        if ((seg.kind == SegmentKind::Text) && seg.contains(adrs)) {
+            segmentStart = seg.address;
+            segmentEnd = seg.address + seg.size;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Get the segments placed by the last load
+const std::vector<Segment>& Debugger::getSegments() const {
+    return segments;
+}
+
+
 void Debugger::reset() {
     if (isReadyToReset) {
-        CurRegBank = 0; // Set current register bank to 0
+        core.reset(); // Registers cleared, bank 0, flags cleared
         pc = loadAddress; // Set PC to the last loading address
-        flagZ = 0;
-        flagN = 0;
-        flagC = 0;
-        std::fill(regBank[0].begin(), regBank[0].end(), 0);
-        std::fill(regBank[1].begin(), regBank[1].end(), 0);
         jumpbuffered = false;
+        breakpointPC = -1;
+        if (profiler.isEnabled())
+            profiler.unwind(counters.instructions(), cycleCount);
+        mix.restart();
+        cycleCount = 0;
+        handlerSource = -1;
+        scheduler.restart(0); // The pattern starts over with the cycle count
         // Reset logic...
     }
 }
@@ -151,6 +440,7 @@ void Debugger::step(uint16_t w, bool exec) {
         uint8_t opcode = w >> 10;
         uint8_t reg1 = (w >> 5) & 31;
         uint8_t reg2 = w & 31;
+        uint8_t operation = model->operations[opcode];
         int RegTrace = 1;
 /*
         TreeView* TVReg = nullptr;
@@ -167,83 +457,124 @@ void Debugger::step(uint16_t w, bool exec) {
         pc += 2;
 
         if (exec) {
-            switch (opcode) {
+            cycleCount += OperationCycles[operation];
+            ++counters.opcodes[opcode];
+            if (mix.isEnabled())
+                mix.execute(w, operation, core.bank);
+            instructionPC = pc - 2;
+            if (coverage.isEnabled())
+                coverage.execute(instructionPC);
+            if ((instructionPC < busStart) || (instructionPC >= busEnd))
+                SelectBusTable();
+            if (busFetch) {
+                int waits = busFetch * ((operation == 38) ? 3 : 1); // movei fetches its immediate too
+                cycleCount += waits;
+                counters.busFetchCycles += waits;
+                if (busTable)
+                    busTable[(instructionPC - busStart) / 2] += waits;
+            }
+            switch (operation) {
             case 22: // abs
-                flagN = 0;
-                flagC = (regBank[CurRegBank][reg2] < 0) ? 1 : 0;
-                regBank[CurRegBank][reg2] = std::abs(regBank[CurRegBank][reg2]);
-                flagZ = (regBank[CurRegBank][reg2] == 0) ? 1 : 0;
+                core.setCarry((core.active[reg2] < 0) ? 1 : 0);
+                if (core.active[reg2] < 0)
+                    core.active[reg2] = static_cast<int>(0u - static_cast<uint32_t>(core.active[reg2]));
+                core.zResult = core.active[reg2];
+                core.nResult = 0;
                 break;
             case 0: // add
-                Update_C_Flag_Add(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1] + regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.add(core.active[reg1], core.active[reg2]);
                 break;
             case 1: // addc
-                Update_C_Flag_Add(regBank[CurRegBank][reg1] + flagC, regBank[CurRegBank][reg2]);
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1] + flagC + regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.add(core.active[reg1], core.active[reg2], core.c());
                 break;
             case 2: // addq
                 if (reg1 == 0) reg1 = 32;
-                Update_C_Flag_Add(reg1, regBank[CurRegBank][reg2]);
-                regBank[CurRegBank][reg2] = reg1 + regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.add(reg1, core.active[reg2]);
                 break;
             case 3: // addqt
                 if (reg1 == 0) reg1 = 32;
-                regBank[CurRegBank][reg2] = reg1 + regBank[CurRegBank][reg2];
+                core.active[reg2] = static_cast<int>(reg1 + static_cast<uint32_t>(core.active[reg2]));
                 break;
             case 9: // and
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1] & regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.active[reg1] & core.active[reg2];
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 15: // bclr
-                regBank[CurRegBank][reg2] &= ~(1 << reg1);
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] &= ~(1 << reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 14: // bset
-                regBank[CurRegBank][reg2] |= (1 << reg1);
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] |= (1 << reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 13: // btst
                 RegTrace = 3;
-                flagZ = ((regBank[CurRegBank][reg2] & (1 << reg1)) == 0) ? 1 : 0;
+                core.zResult = core.active[reg2] & (1u << reg1);
                 break;
             case 30: // cmp
                 RegTrace = 3;
-                Update_C_Flag_Sub(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
-                Update_ZN_Flag(regBank[CurRegBank][reg2] - regBank[CurRegBank][reg1]);
+                core.sub(core.active[reg1], core.active[reg2]);
                 break;
             case 31: // cmpq
                 RegTrace = 3;
-                Update_C_Flag_Sub(reg1, regBank[CurRegBank][reg2]);
-                Update_ZN_Flag(regBank[CurRegBank][reg2] - reg1);
+                core.sub(reg1, core.active[reg2]);
                 break;
             case 21: { // div
-                unsigned u32_1 = regBank[CurRegBank][reg1];
-                unsigned u32_2 = regBank[CurRegBank][reg2];
+                unsigned u32_1 = core.active[reg1];
+                unsigned u32_2 = core.active[reg2];
                 unsigned u32_3 = (u32_1 != 0) ? (u32_2 / u32_1) : 0;
-                regBank[CurRegBank][reg2] = u32_3;
+                core.active[reg2] = u32_3;
                 int temp = (u32_1 != 0) ? (u32_2 % u32_1) : 0;
                 if ((u32_3 & 1) == 0)
-                    WriteLong(G_REMAIN, temp - u32_1);
+                    WriteLong(model->remain, temp - u32_1);
                 else
-                    WriteLong(G_REMAIN, temp);
+                    WriteLong(model->remain, temp);
                 break;
             }
             case 17: { // imult
-                int temp = regBank[CurRegBank][reg1] & 0xFFFF;
+                int temp = core.active[reg1] & 0xFFFF;
                 if (temp > 32767) temp -= 65536;
-                regBank[CurRegBank][reg2] &= 0xFFFF;
-                if (regBank[CurRegBank][reg2] > 32767) regBank[CurRegBank][reg2] -= 65536;
-                regBank[CurRegBank][reg2] = temp * regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] &= 0xFFFF;
+                if (core.active[reg2] > 32767) core.active[reg2] -= 65536;
+                core.active[reg2] = temp * core.active[reg2];
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             }
-            case 53: // jr
+            case 18: { // imultn
+                int16_t s16_1 = static_cast<int16_t>(core.active[reg1]);
+                int16_t s16_2 = static_cast<int16_t>(core.active[reg2]);
+                core.accumulator = s16_1 * s16_2;
+                Update_ZN_Flag(static_cast<int>(core.accumulator));
+                break;
+            }
+            case 20: { // imacn, 32-bit GPU accumulator
+                int16_t s16_1 = static_cast<int16_t>(core.active[reg1]);
+                int16_t s16_2 = static_cast<int16_t>(core.active[reg2]);
+                core.accumulator = static_cast<int32_t>(static_cast<uint32_t>(core.accumulator) + static_cast<uint32_t>(s16_1 * s16_2));
+                break;
+            }
+            case OpImacn40: { // imacn, 40-bit DSP accumulator
+                int16_t s16_1 = static_cast<int16_t>(core.active[reg1]);
+                int16_t s16_2 = static_cast<int16_t>(core.active[reg2]);
+                uint64_t sum = static_cast<uint64_t>(core.accumulator + s16_1 * s16_2);
+                core.accumulator = static_cast<int64_t>(sum << 24) >> 24;
+                break;
+            }
+            case 19: // resmac
+                core.active[reg2] = static_cast<int>(core.accumulator);
+                break;
+            case OpResmac40: // resmac, bits 32-39 go to D_MACHI
+                core.active[reg2] = static_cast<int>(core.accumulator);
+                PokeLong(D_MACHI, static_cast<int>(core.accumulator >> 32));
+                break;
+            case 54: // mmult
+                core.active[reg2] = MatrixMultiplyInstruction(reg1);
+                Update_ZN_Flag(core.active[reg2]);
+                break;
+            case 53: { // jr
                 RegTrace = 0;
-                if (JumpConditionMatch(reg2)) {
+                bool taken = JumpConditionMatch(reg2);
+                if (taken) {
                     if (reg1 > 15)
                         JMPPC = pc - ((32 - reg1) * 2);
                     else
@@ -251,223 +582,241 @@ void Debugger::step(uint16_t w, bool exec) {
                     jumpbuffered = true;
                     JumpBuffLabelUpdate();
                 }
+                CoverBranch(reg2, taken);
                 break;
-            case 52: // jump
+            }
+            case 52: { // jump
                 RegTrace = 0;
-                if (JumpConditionMatch(reg2)) {
-                    JMPPC = regBank[CurRegBank][reg1];
+                bool taken = JumpConditionMatch(reg2);
+                if (taken) {
+                    JMPPC = core.active[reg1];
                     jumpbuffered = true;
                     JumpBuffLabelUpdate();
                 }
+                CoverBranch(reg2, taken);
                 break;
+            }
             case 41: // load
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][reg1]);
+                core.active[reg2] = ReadLong(core.active[reg1]);
                 break;
             case 43: // load r14+n
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][14] + reg1 * 4);
+                core.active[reg2] = ReadLong(core.active[14] + reg1 * 4);
                 break;
             case 44: // load r15+n
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][15] + reg1 * 4);
+                core.active[reg2] = ReadLong(core.active[15] + reg1 * 4);
                 break;
             case 58: // load r14+rn
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][14] + regBank[CurRegBank][reg1]);
+                core.active[reg2] = ReadLong(core.active[14] + core.active[reg1]);
                 break;
             case 59: // load r15+rn
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][15] + regBank[CurRegBank][reg1]);
+                core.active[reg2] = ReadLong(core.active[15] + core.active[reg1]);
                 break;
             case 39: // loadb
-                regBank[CurRegBank][reg2] = ReadByte(regBank[CurRegBank][reg1]);
+                core.active[reg2] = ReadByte(core.active[reg1]);
                 break;
             case 40: // loadw
-                regBank[CurRegBank][reg2] = ReadWord(regBank[CurRegBank][reg1], false);
+                core.active[reg2] = ReadWord(core.active[reg1], false);
                 break;
             case 42: // loadp
-                WriteLong(G_HIDATA, ReadLong(regBank[CurRegBank][reg1]));
-                regBank[CurRegBank][reg2] = ReadLong(regBank[CurRegBank][reg1] + 4);
+                WriteLong(G_HIDATA, ReadLong(core.active[reg1]));
+                core.active[reg2] = ReadLong(core.active[reg1] + 4);
                 break;
             case 34: // move
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1];
+                core.active[reg2] = core.active[reg1];
                 break;
             case 51: // move pc
-                regBank[CurRegBank][reg2] = pc - 2;
+                core.active[reg2] = pc - 2;
                 break;
             case 37: // movefa
-                regBank[CurRegBank][reg2] = regBank[CurRegBank ^ 1][reg1];
+                core.active[reg2] = core.alternate[reg1];
                 break;
             case 38: { // movei
-                regBank[CurRegBank][reg2] = ReadWord(pc, true);
-                regBank[CurRegBank][reg2] |= (ReadWord(pc + 2, true) << 16);
+                core.active[reg2] = ReadWord(pc, true);
+                core.active[reg2] |= (ReadWord(pc + 2, true) << 16);
                 pc += 4;
                 break;
             }
             case 35: // moveq
-                regBank[CurRegBank][reg2] = reg1;
+                core.active[reg2] = reg1;
                 break;
             case 36: // moveta
-                regBank[CurRegBank ^ 1][reg2] = regBank[CurRegBank][reg1];
+                core.alternate[reg2] = core.active[reg1];
                 break;
             case 16: { // mult
-                uint16_t u16_1 = regBank[CurRegBank][reg1];
-                uint16_t u16_2 = regBank[CurRegBank][reg2];
-                regBank[CurRegBank][reg2] = u16_1 * u16_2;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                uint32_t u16_1 = core.active[reg1] & 0xFFFF;
+                uint32_t u16_2 = core.active[reg2] & 0xFFFF;
+                core.active[reg2] = static_cast<int>(u16_1 * u16_2);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             }
             case 8: // neg
-                regBank[CurRegBank][reg2] = -regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = static_cast<int>(0u - static_cast<uint32_t>(core.active[reg2]));
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 12: // not
-                regBank[CurRegBank][reg2] = ~regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = ~core.active[reg2];
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 10: // or
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1] | regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.active[reg1] | core.active[reg2];
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 28: // ror
-                flagC = (regBank[CurRegBank][reg2] >> 31) & 1;
-                reg1 = regBank[CurRegBank][reg1] & 31;
-                regBank[CurRegBank][reg2] = (regBank[CurRegBank][reg2] >> reg1) | (regBank[CurRegBank][reg2] << (32 - reg1));
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.setCarry((core.active[reg2] >> 31) & 1);
+                core.active[reg2] = RotateRight(core.active[reg2], core.active[reg1] & 31);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 29: // rorq
-                flagC = (regBank[CurRegBank][reg2] >> 31) & 1;
-                regBank[CurRegBank][reg2] = (regBank[CurRegBank][reg2] >> reg1) | (regBank[CurRegBank][reg2] << (32 - reg1));
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.setCarry((core.active[reg2] >> 31) & 1);
+                core.active[reg2] = RotateRight(core.active[reg2], reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 32: // sat8
-                regBank[CurRegBank][reg2] = clamp(regBank[CurRegBank][reg2], 0, 255);
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = clamp(core.active[reg2], 0, 255);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 33: // sat16
-                regBank[CurRegBank][reg2] = clamp(regBank[CurRegBank][reg2], 0, 65535);
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = clamp(core.active[reg2], 0, 65535);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 62: // sat24
-                regBank[CurRegBank][reg2] = clamp(regBank[CurRegBank][reg2], 0, 16777215);
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = clamp(core.active[reg2], 0, 16777215);
+                Update_ZN_Flag(core.active[reg2]);
+                break;
+            case OpSat16s: // sat16s
+                core.active[reg2] = clamp(core.active[reg2], -32768, 32767);
+                Update_ZN_Flag(core.active[reg2]);
+                break;
+            case OpSat32s: { // sat32s, from the accumulator guard bits
+                int guard = static_cast<int>(core.accumulator >> 32);
+                if (guard < -1)
+                    core.active[reg2] = INT32_MIN;
+                else if (guard > 0)
+                    core.active[reg2] = INT32_MAX;
+                Update_ZN_Flag(core.active[reg2]);
+                break;
+            }
+            case OpMirror: { // mirror
+                uint32_t value = static_cast<uint32_t>(core.active[reg2]);
+                value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+                value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+                value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+                value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+                core.active[reg2] = static_cast<int>((value >> 16) | (value << 16));
+                Update_ZN_Flag(core.active[reg2]);
                 break;
+            }
             case 23: { // sh
-                int temp = regBank[CurRegBank][reg1];
+                int temp = core.active[reg1];
                 if (temp > 32) temp = 0;
                 if (temp < -32) temp = 0;
                 if (temp >= 0) {
-                    flagC = regBank[CurRegBank][reg2] & 1;
-                    regBank[CurRegBank][reg2] >>= temp;
+                    core.setCarry(core.active[reg2] & 1);
+                    core.active[reg2] = ShiftRight(core.active[reg2], temp);
                 }
                 else {
-                    flagC = (regBank[CurRegBank][reg2] >> 31) & 1;
-                    regBank[CurRegBank][reg2] <<= -temp;
+                    core.setCarry((core.active[reg2] >> 31) & 1);
+                    core.active[reg2] = ShiftLeft(core.active[reg2], -temp);
                 }
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             }
             case 26: { // sha
-                int temp = regBank[CurRegBank][reg1];
+                int temp = core.active[reg1];
                 if (temp > 32) temp = 0;
                 if (temp < -32) temp = 0;
                 if (temp >= 0) {
-                    flagC = regBank[CurRegBank][reg2] & 1;
-                    if (regBank[CurRegBank][reg2] < 0)
-                        regBank[CurRegBank][reg2] = (0xFFFFFFFF << (32 - temp)) | (regBank[CurRegBank][reg2] >> temp);
-                    else
-                        regBank[CurRegBank][reg2] >>= temp;
+                    core.setCarry(core.active[reg2] & 1);
+                    core.active[reg2] = ShiftRightArithmetic(core.active[reg2], temp);
                 }
                 else {
-                    flagC = (regBank[CurRegBank][reg2] >> 31) & 1;
-                    regBank[CurRegBank][reg2] <<= -temp;
+                    core.setCarry((core.active[reg2] >> 31) & 1);
+                    core.active[reg2] = ShiftLeft(core.active[reg2], -temp);
                 }
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             }
             case 27: // sharq
-                flagC = regBank[CurRegBank][reg2] & 1;
-                if (regBank[CurRegBank][reg2] < 0)
-                    regBank[CurRegBank][reg2] = (0xFFFFFFFF << (32 - reg1)) | (regBank[CurRegBank][reg2] >> reg1);
-                else
-                    regBank[CurRegBank][reg2] >>= reg1;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.setCarry(core.active[reg2] & 1);
+                core.active[reg2] = ShiftRightArithmetic(core.active[reg2], reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 24: // shlq
-                reg1 = 32 - reg1;
-                flagC = (regBank[CurRegBank][reg2] >> 31) & 1;
-                regBank[CurRegBank][reg2] <<= reg1;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.setCarry((core.active[reg2] >> 31) & 1);
+                core.active[reg2] = ShiftLeft(core.active[reg2], 32 - reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 25: // shrq
-                flagC = regBank[CurRegBank][reg2] & 1;
-                regBank[CurRegBank][reg2] >>= reg1;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.setCarry(core.active[reg2] & 1);
+                core.active[reg2] = ShiftRight(core.active[reg2], reg1);
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             case 47: // store
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
+                WriteLong(core.active[reg1], core.active[reg2]);
                 break;
             case 49: // store r14+n
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][14] + reg1 * 4, regBank[CurRegBank][reg2]);
+                WriteLong(core.active[14] + reg1 * 4, core.active[reg2]);
                 break;
             case 50: // store r15+n
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][15] + reg1 * 4, regBank[CurRegBank][reg2]);
+                WriteLong(core.active[15] + reg1 * 4, core.active[reg2]);
                 break;
             case 60: // store r14+rn
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][14] + regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
+                WriteLong(core.active[14] + core.active[reg1], core.active[reg2]);
                 break;
             case 61: // store r15+rn
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][15] + regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
+                WriteLong(core.active[15] + core.active[reg1], core.active[reg2]);
                 break;
             case 45: // storeb
                 RegTrace = 2;
-                WriteByte(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
+                WriteByte(core.active[reg1], core.active[reg2]);
                 break;
             case 48: // storep
                 RegTrace = 2;
-                WriteLong(regBank[CurRegBank][reg1], ReadLong(G_HIDATA));
-                WriteLong(regBank[CurRegBank][reg1] + 4, regBank[CurRegBank][reg2]);
+                WriteLong(core.active[reg1], ReadLong(G_HIDATA));
+                WriteLong(core.active[reg1] + 4, core.active[reg2]);
                 break;
             case 46: // storew
                 RegTrace = 2;
-                WriteWord(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
+                WriteWord(core.active[reg1], core.active[reg2]);
                 break;
             case 4: // sub
-                Update_C_Flag_Sub(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2]);
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg2] - regBank[CurRegBank][reg1];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.sub(core.active[reg1], core.active[reg2]);
                 break;
             case 5: // subc
-                Update_C_Flag_Sub(regBank[CurRegBank][reg1], regBank[CurRegBank][reg2] + flagC);
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg2] - regBank[CurRegBank][reg1] - flagC;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.sub(core.active[reg1], core.active[reg2], core.c());
                 break;
             case 6: // subq
                 if (reg1 == 0) reg1 = 32;
-                Update_C_Flag_Sub(reg1, regBank[CurRegBank][reg2]);
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg2] - reg1;
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.sub(reg1, core.active[reg2]);
                 break;
             case 7: // subqt
                 if (reg1 == 0) reg1 = 32;
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg2] - reg1;
+                core.active[reg2] = static_cast<int>(static_cast<uint32_t>(core.active[reg2]) - reg1);
+                break;
+            case OpAddqmod: // addqmod
+            case OpSubqmod: // subqmod
+                core.active[reg2] = QuickModulo(operation == OpSubqmod, reg1, core.active[reg2]);
                 break;
             case 63: // pack/unpack
                 if (reg1 == 0)
-                    regBank[CurRegBank][reg2] =
-                    ((regBank[CurRegBank][reg2] & 0x3C00000) >> 10) |
-                    ((regBank[CurRegBank][reg2] & 0x001E000) >> 5) |
-                    (regBank[CurRegBank][reg2] & 0x00000FF);
+                    core.active[reg2] =
+                    ((core.active[reg2] & 0x3C00000) >> 10) |
+                    ((core.active[reg2] & 0x001E000) >> 5) |
+                    (core.active[reg2] & 0x00000FF);
                 else
-                    regBank[CurRegBank][reg2] =
-                    ((regBank[CurRegBank][reg2] << 10) & 0x3C00000) |
-                    ((regBank[CurRegBank][reg2] << 5) & 0x001E000) |
-                    (regBank[CurRegBank][reg2] & 0x00000FF);
+                    core.active[reg2] =
+                    ((static_cast<uint32_t>(core.active[reg2]) << 10) & 0x3C00000) |
+                    ((static_cast<uint32_t>(core.active[reg2]) << 5) & 0x001E000) |
+                    (core.active[reg2] & 0x00000FF);
                 break;
             case 11: // xor
-                regBank[CurRegBank][reg2] = regBank[CurRegBank][reg1] ^ regBank[CurRegBank][reg2];
-                Update_ZN_Flag(regBank[CurRegBank][reg2]);
+                core.active[reg2] = core.active[reg1] ^ core.active[reg2];
+                Update_ZN_Flag(core.active[reg2]);
                 break;
             default:
                 break;
@@ -490,14 +839,19 @@ void Debugger::step(uint16_t w, bool exec) {
 */
         }
         else {
-            if (opcode == 38) // movei
+            if (operation == 38) // movei
                 pc += 4;
         }
 
         // Jump Buffered
         if (opcode != 52 && opcode != 53 && jumpbuffered) {
+            if (exec && profiler.isEnabled())
+                ProfileJump(instructionPC - 2, JMPPC);
+            if ((JMPPC < idle.start) || (JMPPC > idle.end))
+                idle.start = -1; // Code outside the idle loop candidate runs: its totals are not the loop's
             pc = JMPPC;
             jumpbuffered = false;
+            ++counters.delaySlotJumps;
             JumpBuffLabelUpdate();
             CheckGPUPC();
             //UpdateGPUPCView();
@@ -510,33 +864,419 @@ void Debugger::step(uint16_t w, bool exec) {
 void Debugger::CheckGPUPC() {
     if ((pc < 0) || (pc > MemorySize)) {
         std::string str = "GPU PC outside allocated buffer !\nAddress = $" + IntToHex(pc, 8) + "\nResetting GPU !";
-        QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         reset();
     }
 }
 
 
 void Debugger::RunGPU() {
+    execute(UINT64_MAX);
+    EndRun();
+}
+
+
+// Report why the run ended and leave the running state
+void Debugger::EndRun() {
+    if (stopReason == StopReason::ProgramEnd) {
+        std::string str = "Reached program end !\nAddress = $" + IntToHex(pc, 8);
+        Diagnostic(QMessageBox::Warning, "Warning", QString::fromStdString(str));
+    }
+    StopGPU();
+}
+
+
+// Run one time slice of a paced run; the run ends, as with run(), unless the slice stopped on its budget
+uint64_t Debugger::runSlice(uint64_t budget, uint64_t cycleBudget) {
+    uint64_t count = execute(budget, cycleBudget);
+    if (stopReason != StopReason::Budget)
+        EndRun();
+    return count;
+}
+
+
+// Execute up to 'budget' instructions, or 'cycleBudget' modelled cycles, without UI interaction
+// Stops on a breakpoint (except the one the PC is resuming from), outside the text segments,
+// or when the program clears the GO bit of its control register
+uint64_t Debugger::execute(uint64_t budget, uint64_t cycleBudget) {
+    uint64_t count = 0;
+    stopReason = StopReason::None;
+    if (!isReadyToRun)
+        return 0;
+    uint64_t cycleEnd = (cycleBudget > UINT64_MAX - cycleCount) ? UINT64_MAX : cycleCount + cycleBudget;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int ctrl = model->ctrl;
+    MemoryBuffer[ctrl + 3] |= 1; // GO bit, set directly so it is not counted as a program access
+    MarkDirty(ctrl + 3, 1);
+    SyncRegisterBank();
     gpurun = true;
-    WriteLong(G_CTRL, ReadLong(G_CTRL) | 1);
+    int resumePC = breakpointPC;
+    breakpointPC = -1;
+    watchHit.address = -1;
+    cycleLimit = cycleCount; // An interrupt may be pending already
+    idle.start = -1; // The host may have changed the memory
     while (gpurun) {
-        if (pc == breakpointAddress) {
-            StopGPU();
+        if ((count >= budget) || (cycleCount >= cycleLimit)) {
+            if ((count >= budget) || (cycleCount >= cycleEnd)) {
+                stopReason = StopReason::Budget;
+                break;
+            }
+            cycleLimit = std::min(cycleEnd, ServiceEvents());
+            continue;
         }
-        else if (pc >= (loadAddress + programSize)) {
-            std::string str = "Reached program end !\nAddress = $" + IntToHex(pc, 8);
-            // If MessageDlg is not defined, you can use QMessageBox instead:
-            QMessageBox::warning(nullptr, "Warning", QString::fromStdString(str));
-            StopGPU();
+        if (IsBreakpointAddress(pc)) {
+            int hook = hookAt.value(pc, -1);
+            if (((hook < 0) || breakpoints.contains(pc)) && !((count == 0) && (pc == resumePC))) {
+                stopReason = StopReason::Breakpoint;
+                breakpointPC = pc;
+                break;
+            }
+            if ((hook >= 0) && !jumpbuffered) {
+                if (!CallHook(hooks[hook])) {
+                    stopReason = StopReason::Error;
+                    break;
+                }
+                ++count;
+                continue;
+            }
         }
-        else {
-            int w = ReadWord(pc, true);
-            if (w != -1)
-                step((uint16_t)w, true);
+        if (!InTextSegment(pc)) {
+            stopReason = StopReason::ProgramEnd;
+            break;
+        }
+        int w = ReadWord(pc, true);
+        if (w == -1) {
+            stopReason = StopReason::Error;
+            break;
         }
-        //ApplicationProcessMessages();
+        int before = pc;
+        step((uint16_t)w, true);
+        ++count;
+        if (watchHit.address >= 0) {
+            stopReason = StopReason::Watchpoint;
+            break;
+        }
+        if ((pc <= before) && (before - pc < IdleLoopBytes) && idleSkip)
+            count += SkipIdleLoop(pc, before, count, budget);
     }
-    StopGPU();
+    if (stopReason == StopReason::None)
+        stopReason = StopReason::SelfStop;
+    gpurun = false;
+    ++counters.runs;
+    counters.hostNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return count;
+}
+
+
+// Get the reason why the last execute() returned
+StopReason Debugger::getStopReason() const {
+    return stopReason;
+}
+
+
+// Get the modelled cycles executed since the last reset
+uint64_t Debugger::getCycleCount() const {
+    return cycleCount;
+}
+
+
+// Get the performance counters; the cycle count is taken from the cycle counter
+const PerfCounters& Debugger::getCounters() {
+    counters.cycles = cycleCount;
+    return counters;
+}
+
+
+// Clear the performance counters
+void Debugger::resetCounters() {
+    counters.reset();
+    if (profiler.isEnabled())
+        profiler.clear(loadAddress, 0, cycleCount);
+    mix.clear();
+    busCycles.assign(segments.size(), std::vector<uint64_t>());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].kind == SegmentKind::Text)
+            busCycles[i].assign((segments[i].size + 1) / 2, 0);
+    }
+    busTable = nullptr;
+    busStart = busEnd = 0;
+}
+
+
+// Get the external bus wait states charged to the instruction at an address of a text segment
+uint64_t Debugger::getBusCycles(int adrs) const {
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if ((segments[i].kind == SegmentKind::Text) && segments[i].contains(adrs))
+            return busCycles[i][(adrs - segments[i].address) / 2];
+    }
+    return 0;
+}
+
+
+// Copy a block of emulated memory; false if it is not inside the memory buffer
+bool Debugger::readMemory(int adrs, int size, uint8_t* data) const {
+    if ((adrs < 0) || (size < 0) || (size > MemorySize - adrs))
+        return false;
+    std::memcpy(data, MemoryBuffer.data() + adrs, size);
+    return true;
+}
+
+
+// Write a block of emulated memory, then apply the register bank selected by FLAGS
+bool Debugger::writeMemory(int adrs, int size, const uint8_t* data) {
+    if ((adrs < 0) || (size < 0) || (size > MemorySize - adrs))
+        return false;
+    std::memcpy(MemoryBuffer.data() + adrs, data, size);
+    HostWritten(adrs, size);
+    SyncRegisterBank();
+    return true;
+}
+
+
+// Record a write of the host: the bytes count as written for the shadow check, their pages as dirty
+void Debugger::HostWritten(int adrs, int size) {
+    if (shadow.isEnabled())
+        shadow.define(adrs, size);
+    MarkPages(adrs, size);
+}
+
+
+// Mark every page of a range dirty
+void Debugger::MarkPages(int adrs, int size) {
+    for (int page = adrs >> DirtyPageShift; page <= ((adrs + size - 1) >> DirtyPageShift); ++page)
+        MarkDirty(page << DirtyPageShift, 1);
+}
+
+
+// Append the indices of the memory pages written since the last call, and start over
+void Debugger::takeDirtyPages(std::vector<int>& pages) {
+    for (size_t i = 0; i < dirtyPages.size(); ++i) {
+        if (!dirtyPages[i])
+            continue;
+        for (int bit = 0; bit < 32; ++bit) {
+            if ((dirtyPages[i] >> bit) & 1)
+                pages.push_back(static_cast<int>(i * 32) + bit);
+        }
+        writtenPages[i] |= dirtyPages[i];
+        dirtyPages[i] = 0;
+    }
+}
+
+
+// Allocate the shadow memory, with the loaded image as the only bytes written, or free it
+void Debugger::setShadowCheck(bool enabled) {
+    if (enabled == shadow.isEnabled())
+        return;
+    shadow.resize(enabled ? MemorySize : 0);
+    if (enabled)
+        ShadowDefineLoaded();
+}
+
+
+// Allocate the coverage bitmaps, nothing recorded, or free them
+void Debugger::setCoverage(bool enabled) {
+    if (enabled != coverage.isEnabled())
+        coverage.resize(enabled ? MemorySize : 0);
+    coverage.setImage(imageHash);
+}
+
+
+// Merge the coverage saved by another run of the same image
+bool Debugger::mergeCoverage(const QString& filename) {
+    if (!coverage.merge(filename)) {
+        Diagnostic(QMessageBox::Critical, "Error", coverage.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+// Save the coverage bitmaps, or export them for lcov/genhtml through the code view listing and the symbols
+bool Debugger::writeCoverage(const QString& filename, CoverageFormat format) {
+    bool ok;
+    if (format == CoverageFormat::Bitmaps) {
+        ok = coverage.save(filename);
+    } else {
+        QFileInfo info(filename);
+        QString listing = info.path() + "/" + info.completeBaseName() + ".lst";
+        ok = coverage.writeLcov(filename, listing, codeViewLines, symbols, [this](int adrs) { return isConditionalBranch(adrs); });
+    }
+    if (!ok)
+        Diagnostic(QMessageBox::Critical, "Error", coverage.errorString());
+    return ok;
+}
+
+
+// Turning the profiler on starts a tree rooted at the entry point; the function symbols are kept up to date
+void Debugger::setProfiler(bool enabled) {
+    if (enabled == profiler.isEnabled())
+        return;
+    profiler.setEnabled(enabled);
+    if (enabled) {
+        profiler.setFunctions(symbols);
+        profiler.clear(loadAddress, counters.instructions(), cycleCount);
+    }
+}
+
+
+// Write the profile, up to date with the last instruction run
+bool Debugger::writeProfile(const QString& filename) {
+    profiler.account(counters.instructions(), cycleCount);
+    bool ok;
+    if (filename.endsWith(".json", Qt::CaseInsensitive))
+        ok = profiler.writeTrace(filename, symbols, JaguarClockHz);
+    else if (filename.endsWith(".folded", Qt::CaseInsensitive))
+        ok = profiler.writeCollapsed(filename, symbols);
+    else
+        ok = profiler.writeReport(filename, symbols);
+    if (!ok)
+        Diagnostic(QMessageBox::Critical, "Error", profiler.errorString());
+    return ok;
+}
+
+
+static_assert(InstructionMix::Operations == OperationCount, "The mix tables are indexed by operation");
+
+// Turning the mix on allocates its tables for the decode table of the selected core
+void Debugger::setInstructionMix(bool enabled) {
+    if (enabled != mix.isEnabled())
+        mix.setDecodeTable(enabled ? model->operations : nullptr);
+}
+
+
+// Write the operation, pair and register tables
+bool Debugger::writeInstructionMix(const QString& filename) {
+    if (!mix.write(filename)) {
+        Diagnostic(QMessageBox::Critical, "Error", mix.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+// Start the capture from the divider held in SCLK
+bool Debugger::startAudioCapture(const QString& filename, int rate, AudioClock clock) {
+    if (!audio.start(filename, rate, clock, PeekLong(I2SClock), cycleCount)) {
+        Diagnostic(QMessageBox::Critical, "Error", audio.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+// Complete the WAV file with the frames up to the current cycle
+bool Debugger::stopAudioCapture() {
+    if (!audio.stop(cycleCount)) {
+        Diagnostic(QMessageBox::Critical, "Error", audio.errorString());
+        return false;
+    }
+    return true;
+}
+
+
+// Decode the instruction at an address: jr or jump with a condition other than "always"
+bool Debugger::isConditionalBranch(int adrs) const {
+    if ((adrs < 0) || (adrs + 2 > MemorySize))
+        return false;
+    const uint8_t* walk = MemoryBuffer.data() + adrs;
+    uint8_t operation = model->operations[walk[0] >> 2];
+    return ((operation == 52) || (operation == 53)) && (walk[1] & 31);
+}
+
+
+// Declare a buffer; accesses in the red zone around it are reported as overruns
+void Debugger::addShadowBuffer(int address, int length, const QString& name) {
+    shadow.addBuffer(address, length, name);
+}
+
+
+// Remove the declared buffers
+void Debugger::clearShadowBuffers() {
+    shadow.clearBuffers();
+}
+
+
+// Start the shadow over from the loaded image: its segments (bss included, the loader clears it) and the
+// TOM and JERRY registers are initialized, everything else was never written
+void Debugger::ShadowDefineLoaded() {
+    shadow.clear();
+    shadowFindings.clear();
+    shadowReported.clear();
+    shadowReports.clear();
+    for (const Segment& seg : segments)
+        shadow.define(seg.address, seg.size);
+    shadow.define(0xF00000, G_RAM - 0xF00000);
+    shadow.define(0xF10000, D_RAM - 0xF10000);
+}
+
+
+// Count a shadow check failure, and report the first one of its kind made by the instruction
+void Debugger::ShadowFault(int adrs, int size, bool write) {
+    bool overrun = shadow.isPoisoned(adrs, size);
+    if (overrun)
+        ++counters.boundsViolations;
+    else if (!write)
+        ++counters.uninitializedReads;
+    else
+        return;
+    ShadowKind kind = overrun ? ShadowKind::OutOfBounds : ShadowKind::Uninitialized;
+    qint64 key = (static_cast<qint64>(instructionPC) << 2) | (static_cast<int>(kind) << 1) | (write ? 1 : 0);
+    if (shadowReported.contains(key))
+        return;
+    shadowReported.insert(key);
+    int buffer = overrun ? shadow.bufferAt(adrs) : -1;
+    shadowFindings.push_back({ kind, instructionPC, adrs, size, write, buffer });
+
+    std::string str;
+    if (buffer >= 0) {
+        const ShadowMemory::Buffer& b = shadow.getBuffers()[buffer];
+        int distance = (adrs < b.address) ? b.address - adrs : adrs - (b.address + b.length);
+        str = std::string(write ? "Write" : "Read") + " out of bounds of buffer " + b.name.toStdString() + " !\nAddress = $"
+            + IntToHex(adrs, 8) + ", " + std::to_string(distance) + ((adrs < b.address) ? " bytes before its start" : " bytes after its end");
+    } else {
+        str = "Read of uninitialized memory !\nAddress = $" + IntToHex(adrs, 8) + " (" + std::to_string(size) + " bytes)";
+    }
+    str += "\nPC = $" + IntToHex(instructionPC, 8);
+    if (interactive) {
+        ++counters.diagnostics; // Shown together when the run stops: an overrun in a loop is not a box per access
+        shadowReports << QString::fromStdString(str);
+    }
+    else
+        Diagnostic(QMessageBox::Warning, "Shadow memory", QString::fromStdString(str));
+}
+
+
+// Messages of the findings held back since the last call
+QStringList Debugger::takeShadowReports() {
+    QStringList reports;
+    reports.swap(shadowReports);
+    return reports;
+}
+
+
+// Show message boxes for diagnostics (default), or only emit diagnostic() for remote sessions
+void Debugger::setInteractive(bool enabled) {
+    interactive = enabled;
+}
+
+
+// Report a diagnostic to the user, or to the diagnostic() listeners when not interactive
+void Debugger::Diagnostic(QMessageBox::Icon icon, const QString& title, const QString& text) {
+    ++counters.diagnostics;
+    if (!interactive)
+        emit diagnostic(title + ": " + text);
+    else if (icon == QMessageBox::Critical)
+        QMessageBox::critical(nullptr, title, text);
+    else
+        QMessageBox::warning(nullptr, title, text);
+}
+
+
+// Check the per-address breakpoint bitmap (one bit per instruction word)
+bool Debugger::IsBreakpointAddress(int adrs) const {
+    unsigned int index = static_cast<unsigned int>(adrs) >> 1;
+    return (index < breakpointMap.size() * 32) && ((breakpointMap[index >> 5] >> (index & 31)) & 1);
 }
 
 
@@ -595,7 +1335,39 @@ int Debugger::getRegBankRegisterValue(int bank, int reg) const {
         qDebug() << "Invalid bank or register index:" << bank << reg;
         return 0; // Return 0 for invalid access
     }
-	return regBank[bank][reg]; // Return the value of the specified register
+	return core.regs[bank][reg]; // Return the value of the specified register
+}
+
+
+// Set the value of a specific register in the specified bank
+void Debugger::setRegBankRegisterValue(int bank, int reg, int value) {
+    if ((bank < 0) || (bank > 1) || (reg < 0) || (reg >= 32)) {
+        qDebug() << "Invalid bank or register index:" << bank << reg;
+        return;
+    }
+    core.regs[bank][reg] = value;
+}
+
+
+// Get the flags register: Z bit 0, C bit 1, N bit 2, REGPAGE bit 14, other bits from memory
+uint32_t Debugger::getFlagsValue() {
+    uint32_t value = static_cast<uint32_t>(PeekLong(model->flags)) & ~0x4007u;
+    return value | core.z() | (core.c() << 1) | (core.n() << 2) | (core.bank << 14);
+}
+
+
+// Set the flags register; writing it also selects the register bank
+void Debugger::setFlagsValue(uint32_t value) {
+    core.setFlags(value & 1, (value >> 1) & 1, (value >> 2) & 1);
+    PokeLong(model->flags, static_cast<int>(value)); // The host may set IMASK, which a program store cannot
+    SyncRegisterBank();
+    cycleLimit = cycleCount;
+}
+
+
+// Set the program counter
+void Debugger::setPCValue(int value) {
+    pc = value;
 }
 
 
@@ -603,9 +1375,7 @@ int Debugger::getRegBankRegisterValue(int bank, int reg) const {
 QStringList Debugger::getRegBank(int bank) const {
     QStringList list;
     for (int i = 0; i < 32; ++i) {
-        int value = 0;
-        if (bank == 0 && regBank[0].size() == 32) value = regBank[0][i];
-        else if (bank == 1 && regBank[1].size() == 32) value = regBank[1][i];
+        int value = core.regs[bank & 1][i];
         // Register label in lowercase, value in uppercase
         list << QString("r%1: $%2")
             .arg(i, 0, 10)
@@ -623,7 +1393,8 @@ QStringList Debugger::getCodeView() const {
 
 // Get the current flags as a formatted string
 QString Debugger::getFlags() const {
-    return QString("Flags: Z:%1 N:%2 C:%3").arg(flagZ).arg(flagN).arg(flagC);
+    return QString("Flags: Z:%1 N:%2 C:%3 IMASK:%4").arg(core.z()).arg(core.n()).arg(core.c())
+        .arg((PeekLong(model->flags) & FlagIMASK) ? 1 : 0);
 }
 
 
@@ -639,6 +1410,21 @@ int Debugger::getPCValue() const {
 }
 
 
+// Copy the state shown by the live refresh
+void Debugger::snapshot(CoreSnapshot& state) const {
+    std::memcpy(state.regs, core.regs, sizeof(state.regs));
+    state.bank = core.bank;
+    state.pc = pc;
+    state.z = core.z();
+    state.n = core.n();
+    state.c = core.c();
+    state.cycles = cycleCount;
+    state.instructions = counters.instructions();
+    state.counters = counters;
+    state.counters.cycles = cycleCount;
+}
+
+
 // Get the jump address (JMPPC) as a formatted string
 QString Debugger::getJump() const {
     return QString("$%1").arg(JMPPC, 8, 16, QChar('0')).toUpper();
@@ -659,7 +1445,9 @@ QString Debugger::getHiData() const {
 
 // Get the current breakpoint address in a formatted string
 QString Debugger::getBP() const {
-    return QString("$%1").arg(breakpointAddress, 8, 16, QChar('0')).toUpper();
+    QString str = QString("$%1").arg(breakpointAddress, 8, 16, QChar('0')).toUpper();
+    const Symbol* sym = breakpointAddress ? symbols.lookup(breakpointAddress) : nullptr;
+    return sym ? QString("%1 (%2)").arg(str).arg(symbols.symbolize(breakpointAddress)) : str;
 }
 
 
@@ -699,11 +1487,8 @@ void Debugger::editRegister(int bank, const QString& value) {
         qDebug() << "Invalid register value or index:" << value;
         return;
     }
-    if (bank == 0 && regBank[0].size() == 32) {
-        regBank[0][regIndex] = regValue;
-    }
-    else if (bank == 1 && regBank[1].size() == 32) {
-        regBank[1][regIndex] = regValue;
+    if ((bank == 0) || (bank == 1)) {
+        core.regs[bank][regIndex] = regValue;
     }
     else {
         qDebug() << "Invalid bank specified.";
@@ -713,7 +1498,10 @@ void Debugger::editRegister(int bank, const QString& value) {
 
 // Set the Mode (true for GPU, false for DSP)
 void Debugger::setGPUMode(bool isGPUMode) {
-    GPUMode = isGPUMode;
+    model = isGPUMode ? &GPUModel : &DSPModel;
+    busStart = busEnd = 0; // The fetch cost depends on the core
+    if (mix.isEnabled())
+        mix.setDecodeTable(model->operations); // The words recorded decode with the other core's table
 /*
     // Logic to switch between GPU and DSP modes
     if (isGPUMode) {
@@ -730,25 +1518,259 @@ void Debugger::setGPUMode(bool isGPUMode) {
 // Set a breakpoint at a specified address
 void Debugger::setBreakpoint(const QString& address) {
     bool ok = false;
-    QString modifiableAddress = address;
-    int bp = modifiableAddress.remove('$').toInt(&ok, 16);
+    QString modifiableAddress = address.trimmed();
+    if (modifiableAddress.endsWith(':')) // Label line of the code view
+        modifiableAddress.chop(1);
+    int bp = 0;
+    if (!modifiableAddress.startsWith('$') && symbols.find(modifiableAddress, bp))
+        ok = true;
+    else
+        bp = modifiableAddress.remove('$').toInt(&ok, 16);
     if (ok) {
-        if (breakpoints.contains(bp)) {
-            // Remove breakpoint if already set at this address
-            breakpoints.remove(bp);
-            if (breakpointAddress == bp)
-                breakpointAddress = 0;
-        } else {
-            // Set new breakpoint
-            breakpoints.insert(bp);
-            breakpointAddress = bp;
-        }
+        if (breakpoints.contains(bp))
+            removeBreakpoint(bp); // Remove breakpoint if already set at this address
+        else
+            addBreakpoint(bp);
     } else {
         qDebug() << "Invalid address format for breakpoint:" << address;
     }
 }
 
 
+// Set a breakpoint at an address
+void Debugger::addBreakpoint(int address) {
+    breakpoints.insert(address);
+    UpdateStopBit(address);
+    breakpointAddress = address;
+}
+
+
+// Remove the breakpoint at an address
+void Debugger::removeBreakpoint(int address) {
+    breakpoints.remove(address);
+    UpdateStopBit(address);
+    if (breakpointAddress == address)
+        breakpointAddress = 0;
+}
+
+
+// The PC went back to 'start' from 'end': fast-forward the iterations of a loop that stays in the range, stores
+// nothing, calls no hook and leaves the core state unchanged; returns the instructions skipped
+uint64_t Debugger::SkipIdleLoop(int start, int end, uint64_t count, uint64_t budget) {
+    uint64_t stores = 0;
+    for (uint64_t n : counters.stores)
+        stores += n;
+    if ((idle.start != start) || (idle.end != end) || !SameIdleState(stores)) {
+        idle.start = start;
+        idle.end = end;
+        idle.measuring = false;
+        std::memcpy(idle.regs, core.regs, sizeof(idle.regs));
+        idle.bank = core.bank;
+        idle.z = core.z();
+        idle.n = core.n();
+        idle.c = core.c();
+        idle.accumulator = core.accumulator;
+        idle.stores = stores;
+        return 0;
+    }
+    bool covered = busTable && (start >= busStart) && (end + 2 <= busEnd);
+    if (!idle.measuring) {
+        // Breakpoints, hooks, watchpoints and the instruction mix must see every iteration
+        if (!watchpoints.empty() || !covered || mix.isEnabled())
+            return 0;
+        for (int adrs = start; adrs <= end; adrs += 2) {
+            if (IsBreakpointAddress(adrs))
+                return 0;
+        }
+        idle.measuring = true;
+        idle.cycles = cycleCount;
+        idle.count = count;
+        idle.counters = counters;
+        idle.bus.assign(busTable + (start - busStart) / 2, busTable + (end - busStart) / 2 + 1);
+        return 0;
+    }
+    idle.start = -1;
+    uint64_t cycles = cycleCount - idle.cycles;
+    uint64_t instructions = count - idle.count;
+    if (!covered || !cycles || !instructions || (counters.diagnostics != idle.counters.diagnostics))
+        return 0;
+    // Stop short of the first instruction that would reach the limit, so the run loop handles it as usual
+    uint64_t skips = (budget - count) / instructions;
+    if (cycleLimit != UINT64_MAX)
+        skips = std::min(skips, (cycleLimit - cycleCount - 1) / cycles);
+    else if (budget == UINT64_MAX)
+        return 0; // Nothing to wait for: the loop never ends
+    if (!skips)
+        return 0;
+    cycleCount += skips * cycles;
+    for (int i = 0; i < 64; ++i)
+        counters.opcodes[i] += skips * (counters.opcodes[i] - idle.counters.opcodes[i]);
+    for (int i = 0; i < RegionCount; ++i)
+        counters.loads[i] += skips * (counters.loads[i] - idle.counters.loads[i]);
+    counters.busFetchCycles += skips * (counters.busFetchCycles - idle.counters.busFetchCycles);
+    counters.busDataCycles += skips * (counters.busDataCycles - idle.counters.busDataCycles);
+    counters.delaySlotJumps += skips * (counters.delaySlotJumps - idle.counters.delaySlotJumps);
+    counters.uninitializedReads += skips * (counters.uninitializedReads - idle.counters.uninitializedReads);
+    counters.boundsViolations += skips * (counters.boundsViolations - idle.counters.boundsViolations);
+    uint64_t* bus = busTable + (start - busStart) / 2;
+    for (size_t i = 0; i < idle.bus.size(); ++i)
+        bus[i] += skips * (bus[i] - idle.bus[i]);
+    ++counters.idleSkips;
+    counters.idleInstructions += skips * instructions;
+    return skips * instructions;
+}
+
+
+// True if the core is as it was at the head of the idle loop candidate, with no store since
+bool Debugger::SameIdleState(uint64_t stores) const {
+    return (stores == idle.stores) && (core.bank == idle.bank) && (core.z() == idle.z) && (core.n() == idle.n)
+        && (core.c() == idle.c) && (core.accumulator == idle.accumulator)
+        && !std::memcmp(core.regs, idle.regs, sizeof(idle.regs));
+}
+
+
+// Mark the instruction word of an address in the bitmap if a breakpoint or a hook is there
+void Debugger::UpdateStopBit(int adrs) {
+    unsigned int index = static_cast<unsigned int>(adrs) >> 1;
+    if (index >= breakpointMap.size() * 32)
+        return;
+    if (breakpoints.contains(adrs) || hookAt.contains(adrs))
+        breakpointMap[index >> 5] |= 1u << (index & 31);
+    else
+        breakpointMap[index >> 5] &= ~(1u << (index & 31));
+}
+
+
+// Add a native hook; its target is resolved now if a program is loaded, and by every load
+bool Debugger::addHook(const NativeHook& hook) {
+    if (!hook.handler) {
+        Diagnostic(QMessageBox::Critical, "Error", QString("Hook %1 has no handler.").arg(hook.target));
+        return false;
+    }
+    hooks.push_back(hook);
+    ResolveHooks(!segments.empty());
+    return true;
+}
+
+
+// Remove the native hooks
+void Debugger::clearHooks() {
+    hooks.clear();
+    ResolveHooks(false);
+}
+
+
+// Find the address of every hook target: a symbol, else a hex address; report the targets not found
+void Debugger::ResolveHooks(bool report) {
+    QList<int> previous = hookAt.keys();
+    hookAt.clear();
+    for (int adrs : previous)
+        UpdateStopBit(adrs);
+    QStringList missing;
+    for (size_t i = 0; i < hooks.size(); ++i) {
+        NativeHook& hook = hooks[i];
+        QString target = hook.target.trimmed();
+        bool ok = !target.startsWith('$') && symbols.find(target, hook.address);
+        if (!ok)
+            hook.address = target.remove('$').toInt(&ok, 16);
+        if (!ok || (hook.address & 1)) {
+            hook.address = -1;
+            missing << hook.target;
+            continue;
+        }
+        hookAt.insert(hook.address, static_cast<int>(i));
+        UpdateStopBit(hook.address);
+    }
+    if (report && !missing.isEmpty())
+        Diagnostic(QMessageBox::Warning, "Warning", QString("Hook target not found: %1").arg(missing.join(", ")));
+}
+
+
+// Run a native handler in place of the routine at the PC, charge its cycles, and return to the link address
+bool Debugger::CallHook(const NativeHook& hook) {
+    HookContext context(*this, hook.cycles);
+    hook.handler(context);
+    // A failing handler stops on the hooked entry with the stack untouched, so resuming runs the hook again
+    int link = 0;
+    if (context.errorString().isEmpty())
+        link = (hook.link >= 0) ? core.active[hook.link] : static_cast<int>(context.readLong(core.active[31]));
+    if (!context.errorString().isEmpty()) {
+        Diagnostic(QMessageBox::Critical, "Error", QString("Hook %1 at $%2: %3").arg(hook.target)
+            .arg(pc, 8, 16, QChar('0')).arg(context.errorString()));
+        return false;
+    }
+    if (hook.link < 0)
+        core.active[31] += 4;
+    SyncRegisterBank(); // The handler may have written the flags
+    idle.start = -1; // Its writes are not counted as stores: a loop calling it is never idle
+    cycleCount += context.cycles;
+    ++counters.hookCalls;
+    counters.hookCycles += context.cycles;
+    if (profiler.isEnabled())
+        profiler.returnTo(link, counters.instructions(), cycleCount); // Leaves the frame the call pushed, if any
+    pc = link;
+    CheckGPUPC();
+    return true;
+}
+
+
+// A taken jump, once its delay slot ran: a return to a frame of the shadow call stack, or a call. Returns are
+// jump (Rn); calls are jump (Rn) after a "move PC,Rm", returning to the address in Rm, or jumps to a code symbol
+void Debugger::ProfileJump(int from, int target) {
+    uint64_t instructions = counters.instructions();
+    const CallIdioms& idioms = profiler.idioms();
+    bool indirect = model->operations[MemoryBuffer[from] >> 2] == 52;
+    if (indirect && profiler.returnTo(target, instructions, cycleCount))
+        return;
+    if (idioms.link && indirect) {
+        for (int adrs = from - 2; (adrs >= from - 6) && (adrs >= 0); adrs -= 2) {
+            if (model->operations[MemoryBuffer[adrs] >> 2] == 51) {
+                int link = core.active[MemoryBuffer[adrs + 1] & 31];
+                profiler.call(target, link, link + idioms.returnWindow, instructions, cycleCount);
+                return;
+            }
+        }
+    }
+    if (idioms.symbols && profiler.isFunction(target) && (profiler.functionOf(from) != target))
+        profiler.call(target, from + 4, from + 4 + idioms.returnWindow, instructions, cycleCount);
+}
+
+
+// Watch data accesses of the program to a range of addresses
+void Debugger::addWatchpoint(int address, int length, WatchKind kind) {
+    watchpoints.push_back({ address, std::max(length, 1), kind });
+}
+
+
+// Remove a watchpoint set by addWatchpoint()
+void Debugger::removeWatchpoint(int address, int length, WatchKind kind) {
+    length = std::max(length, 1);
+    watchpoints.erase(std::remove_if(watchpoints.begin(), watchpoints.end(), [&](const Watchpoint& w) {
+        return (w.address == address) && (w.length == length) && (w.kind == kind);
+    }), watchpoints.end());
+}
+
+
+// Get the watchpoint access that stopped the last execute(); address is -1 if none
+Debugger::Watchpoint Debugger::getWatchHit() const {
+    return watchHit;
+}
+
+
+// Record an access of the running program that falls in a watchpoint
+void Debugger::WatchAccess(int adrs, int size, WatchKind kind) {
+    if (watchpoints.empty() || !gpurun)
+        return;
+    for (const Watchpoint& w : watchpoints) {
+        bool match = (w.kind == WatchKind::Access) || (w.kind == kind);
+        if (match && (adrs < w.address + w.length) && (w.address < adrs + size)) {
+            watchHit = { std::max(adrs, w.address), size, w.kind };
+            return;
+        }
+    }
+}
+
+
 // Check if a breakpoint is set at a given address
 bool Debugger::hasBreakpoint(int address) const {
     return breakpoints.contains(address);
@@ -766,8 +1788,15 @@ QStringList Debugger::disassemble(int loadAddress, int programSize) const {
 
     int total = (programSize > 0) ? programSize : 1;
     int processed = 0;
+    int moveiValue[32];
+    uint32_t moveiKnown = 0;
 
     while (size > 1) {
+        // Label line for a symbol starting here
+        if (const Symbol* sym = symbols.at(adrs)) {
+            result << QString("%1:").arg(sym->name);
+            moveiKnown = 0;
+        }
         int ecart = 0;
         uint8_t w1 = *walk++;
         uint8_t w2 = *walk++;
@@ -776,7 +1805,7 @@ QStringList Debugger::disassemble(int loadAddress, int programSize) const {
         uint8_t reg1 = ((w1 << 3) & 31) | (w2 >> 5);
         uint8_t reg2 = w2 & 31;
         QString instr, js;
-        switch (opcode) {
+        switch (model->operations[opcode]) {
         case 22: instr = QString("abs    r%1").arg(reg2); break;
         case 0: instr = QString("add    r%1,r%2").arg(reg1).arg(reg2); break;
         case 1: instr = QString("addc   r%1,r%2").arg(reg1).arg(reg2); break;
@@ -790,19 +1819,23 @@ QStringList Debugger::disassemble(int loadAddress, int programSize) const {
         case 31: instr = QString("cmpq   #%1,r%2").arg(reg1).arg(reg2); break;
         case 21: instr = QString("div    r%1,r%2").arg(reg1).arg(reg2); break;
         case 17: instr = QString("imult  r%1,r%2").arg(reg1).arg(reg2); break;
+        case 18: instr = QString("imultn r%1,r%2").arg(reg1).arg(reg2); break;
+        case 20: instr = QString("imacn  r%1,r%2").arg(reg1).arg(reg2); break;
+        case 19: instr = QString("resmac r%1").arg(reg2); break;
+        case 54: instr = QString("mmult  r%1,r%2").arg(reg1).arg(reg2); break;
         case 53:
             instr = "jr     ";
             js = QString::fromStdString(GetJumpFlag(reg2));
-            if (!js.isEmpty()) instr += js + ",$";
-            instr += (reg1 > 15)
-                ? QString("%1").arg(adrs - ((32 - reg1) * 2), 8, 16, QChar('0'))
-                : QString("%1").arg(adrs + (reg1 * 2), 8, 16, QChar('0'));
+            if (!js.isEmpty()) instr += js + ",";
+            instr += symbols.symbolize((reg1 > 15) ? adrs + 2 - ((32 - reg1) * 2) : adrs + 2 + (reg1 * 2));
             break;
         case 52:
             instr = "jump   ";
             js = QString::fromStdString(GetJumpFlag(reg2));
             if (!js.isEmpty()) instr += js + ",";
             instr += QString("(r%1)").arg(reg1);
+            if (moveiKnown & (1u << reg1))
+                instr += QString(" ; -> %1").arg(symbols.symbolize(moveiValue[reg1]));
             break;
         case 41: instr = QString("load   (r%1),r%2").arg(reg1).arg(reg2); break;
         case 43: instr = QString("load   (r14+%1),r%2").arg(reg1).arg(reg2); break;
@@ -819,6 +1852,10 @@ QStringList Debugger::disassemble(int loadAddress, int programSize) const {
             int value = (walk[0] << 8) | walk[1] | (walk[2] << 24) | (walk[3] << 16);
             walk += 4; ecart += 4;
             instr = QString("movei  #$%1,r%2").arg(value, 8, 16, QChar('0')).arg(reg2);
+            if (const Symbol* sym = symbols.at(value))
+                instr += QString(" ; %1").arg(sym->name);
+            moveiValue[reg2] = value;
+            moveiKnown |= 1u << reg2;
             break;
         }
         case 35: instr = QString("moveq  #%1,r%2").arg(reg1).arg(reg2); break;
@@ -853,8 +1890,19 @@ QStringList Debugger::disassemble(int loadAddress, int programSize) const {
             ? QString("pack   r%1").arg(reg2)
             : QString("unpack r%1").arg(reg2); break;
         case 11: instr = QString("xor    r%1,r%2").arg(reg1).arg(reg2); break;
+        case OpAddqmod: instr = QString("addqmod #%1,r%2").arg(reg1 == 0 ? 32 : reg1).arg(reg2); break;
+        case OpSubqmod: instr = QString("subqmod #%1,r%2").arg(reg1 == 0 ? 32 : reg1).arg(reg2); break;
+        case OpSat16s: instr = QString("sat16s r%1").arg(reg2); break;
+        case OpSat32s: instr = QString("sat32s r%1").arg(reg2); break;
+        case OpMirror: instr = QString("mirror r%1").arg(reg2); break;
+        case OpImacn40: instr = QString("imacn  r%1,r%2").arg(reg1).arg(reg2); break;
+        case OpResmac40: instr = QString("resmac r%1").arg(reg2); break;
         default: instr = "unknown"; break;
         }
+        if ((opcode == 52) || (opcode == 53))
+            moveiKnown = 0;
+        else if (opcode != 38)
+            moveiKnown &= ~(1u << reg2);
         // Format address as $XXXXXXXX in uppercase
         QString addrStr = QString("$%1").arg(adrs, 8, 16, QChar('0')).toUpper();
         result << QString("%1: %2").arg(addrStr).arg(instr);
@@ -889,26 +1937,32 @@ void Debugger::JumpBuffLabelUpdate() {
 }
 
 
-// Update the N and Z flags based on the value of i
+// Record the result the N and Z flags are derived from
 void Debugger::Update_ZN_Flag(int i) {
-    flagN = (i < 0) ? 1 : 0;
-    flagZ = (i == 0) ? 1 : 0;
+    core.setResult(i);
+}
+
+
+// Shifts and rotation with the JRISC behaviour for counts of 32 (no undefined C++ shifts)
+int Debugger::ShiftLeft(int value, int count) {
+    return (count >= 32) ? 0 : static_cast<int>(static_cast<uint32_t>(value) << count);
+}
+
+
+int Debugger::ShiftRight(int value, int count) {
+    return (count >= 32) ? 0 : static_cast<int>(static_cast<uint32_t>(value) >> count);
 }
 
 
-//  Update the C flag for addition
-void Debugger::Update_C_Flag_Add(int a, int b) {
-    unsigned int uint1 = ~a;
-    unsigned int uint2 = b;
-    flagC = (uint2 > uint1) ? 1 : 0;
+int Debugger::ShiftRightArithmetic(int value, int count) {
+    return (count >= 32) ? ((value < 0) ? -1 : 0) : (value >> count);
 }
 
 
-// Update the C flag for subtraction
-void Debugger::Update_C_Flag_Sub(int a, int b) {
-    unsigned int uint1 = a;
-    unsigned int uint2 = b;
-    flagC = (uint1 > uint2) ? 1 : 0;
+int Debugger::RotateRight(int value, int count) {
+    uint32_t u = static_cast<uint32_t>(value);
+    count &= 31;
+    return count ? static_cast<int>((u >> count) | (u << (32 - count))) : value;
 }
 
 
@@ -919,27 +1973,294 @@ void Debugger::WriteLong(int adrs, int data) {
     if (memadrs != adrs) {
         if (!memoryWarningEnabled) {
             std::string str = "WriteLong not on a Long aligned address !\nAddress = $" + IntToHex(memadrs, 8) + "\nShould be = $" + IntToHex(adrs, 8);
-            QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+            Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         }
     }
     memadrs = adrs;
+    if ((memadrs >= model->flags) && (memadrs <= model->ctrl))
+        data = ControlWrite(memadrs, data);
+    CaptureAudio(memadrs, data);
+    WatchAccess(memadrs, 4, WatchKind::Write);
+    MemoryRegion region = PerfCounters::regionOf(memadrs);
+    ++counters.stores[region];
+    if (model->bus[region].write)
+        ChargeBus(model->bus[region].write, false);
     if ((memadrs >= 0) && ((memadrs + 4) <= MemorySize)) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
         walk[0] = (data >> 24) & 0xFF;
         walk[1] = (data >> 16) & 0xFF;
         walk[2] = (data >> 8) & 0xFF;
         walk[3] = data & 0xFF;
+        MarkDirty(memadrs, 4);
+        ShadowWrite(memadrs, 4);
     }
     else {
         if (!memoryWarningEnabled) {
             std::string str = "WriteLong outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-            QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+            Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         }
     }
     MemWriteCheck();
 }
 
 
+// Select the register bank given by REGPAGE of the flags register, or bank 0 while IMASK is set, counting the
+// switches
+void Debugger::SyncRegisterBank() {
+    int flags = PeekLong(model->flags);
+    int bank = (flags & FlagIMASK) ? 0 : (flags >> 14) & 1;
+    if (bank != core.bank) {
+        core.selectBank(bank);
+        ++counters.bankSwitches;
+    }
+}
+
+
+// Raise the scheduled events that are due, then enter the handler of a pending interrupt, unless a jump waits for
+// its delay slot; returns the cycle to check again at
+uint64_t Debugger::ServiceEvents() {
+    ScheduledEvent event;
+    while (scheduler.takeDue(cycleCount, event))
+        raiseInterrupt(event.source);
+    int source = PendingInterrupt();
+    if (source >= 0) {
+        if (jumpbuffered)
+            return cycleCount + 1; // After the delay slot; every instruction takes a cycle at least
+        TakeInterrupt(source);
+    }
+    return scheduler.nextCycle();
+}
+
+
+// Highest source latched and enabled, if IMASK is clear; -1 if none
+int Debugger::PendingInterrupt() const {
+    int flags = PeekLong(model->flags);
+    if (flags & FlagIMASK)
+        return -1;
+    int ctrl = PeekLong(model->ctrl);
+    for (int source = model->interruptSources - 1; source >= 0; --source) {
+        if ((ctrl & LatchBit(source)) && (flags & EnableBit(source)))
+            return source;
+    }
+    return -1;
+}
+
+
+// Enter an interrupt handler as the hardware does: set IMASK, which selects bank 0, push the address of the last
+// instruction executed on the bank 0 stack (r31), and jump to the vector. The handler clears the latch and IMASK,
+// and returns to the pushed address plus 2
+void Debugger::TakeInterrupt(int source) {
+    uint64_t latency = cycleCount - raisedCycle[source];
+    ++counters.interrupts[source];
+    counters.interruptLatency[source] += latency;
+    counters.interruptLatencyMax[source] = std::max(counters.interruptLatencyMax[source], latency);
+    PokeLong(model->flags, PeekLong(model->flags) | FlagIMASK);
+    SyncRegisterBank();
+    core.regs[0][31] -= 4;
+    int sp = core.regs[0][31] & ~3;
+    if ((sp >= 0) && ((sp + 4) <= MemorySize)) {
+        PokeLong(sp, pc - 2); // Not a program store: no watchpoint, counter or idle loop sees it
+        if (shadow.isEnabled())
+            shadow.define(sp, 4);
+    }
+    else if (!memoryWarningEnabled)
+        Diagnostic(QMessageBox::Critical, "Error", "Interrupt stack outside allocated buffer !\nAddress = $" + QString::fromStdString(IntToHex(sp, 8)));
+    int interrupted = pc;
+    pc = model->ram + 0x10 * source;
+    cycleCount += InterruptCycles;
+    handlerSource = source;
+    handlerStart = cycleCount;
+    if (profiler.isEnabled())
+        profiler.call(pc, interrupted, interrupted, counters.instructions(), cycleCount);
+}
+
+
+// Interrupt rules of a program write to FLAGS or CTRL; returns the value stored. IMASK can be cleared, not set;
+// the INT_CLR bits clear their latches and read as zero. The CTRL latches are read-only, and its force bit latches
+// source 0
+int Debugger::ControlWrite(int adrs, int data) {
+    if (adrs == model->flags) {
+        int flags = PeekLong(adrs);
+        int ctrl = PeekLong(model->ctrl);
+        for (int source = 0; source < model->interruptSources; ++source) {
+            if (data & ClearBit(source))
+                ctrl &= ~LatchBit(source);
+            data &= ~ClearBit(source);
+        }
+        PokeLong(model->ctrl, ctrl);
+        data = (data & ~FlagIMASK) | (flags & data & FlagIMASK);
+        if ((flags & FlagIMASK) && !(data & FlagIMASK) && (handlerSource >= 0)) {
+            uint64_t cycles = cycleCount - handlerStart;
+            counters.interruptHandler[handlerSource] += cycles;
+            counters.interruptHandlerMax[handlerSource] = std::max(counters.interruptHandlerMax[handlerSource], cycles);
+            handlerSource = -1;
+        }
+        cycleLimit = cycleCount; // A source may be enabled or unmasked now
+    }
+    else if (adrs == model->ctrl) {
+        int latches = 0;
+        for (int source = 0; source < model->interruptSources; ++source)
+            latches |= LatchBit(source);
+        int ctrl = PeekLong(adrs);
+        if ((data & CtrlForce0) && !(ctrl & LatchBit(0))) {
+            ctrl |= LatchBit(0);
+            raisedCycle[0] = cycleCount;
+            cycleLimit = cycleCount;
+        }
+        data = (data & ~(latches | CtrlForce0)) | (ctrl & latches);
+    }
+    return data;
+}
+
+
+// A word or byte store to FLAGS or CTRL: the bytes are merged into the register and stored as a long, so the
+// same interrupt rules apply whatever the width
+void Debugger::ControlStore(int adrs, int data, int size) {
+    int control = adrs & ~3;
+    int shift = (4 - size - (adrs & 3)) * 8;
+    uint32_t mask = ((size == 1) ? 0xFFu : 0xFFFFu) << shift;
+    uint32_t value = (static_cast<uint32_t>(PeekLong(control)) & ~mask) | ((static_cast<uint32_t>(data) << shift) & mask);
+    WriteLong(control, static_cast<int>(value));
+}
+
+
+// Latch an interrupt source; the run loop takes it before the next instruction if it is enabled and unmasked.
+// Only called from the thread running the core
+void Debugger::raiseInterrupt(int source) {
+    if ((source < 0) || (source >= model->interruptSources))
+        return;
+    int ctrl = PeekLong(model->ctrl);
+    if (!(ctrl & LatchBit(source))) {
+        PokeLong(model->ctrl, ctrl | LatchBit(source));
+        raisedCycle[source] = cycleCount;
+    }
+    cycleLimit = cycleCount;
+}
+
+
+// Raise a source at a cycle, then every 'period' cycles if not zero; false if the core has no such source
+bool Debugger::scheduleInterrupt(int source, uint64_t cycle, uint64_t period) {
+    if ((source < 0) || (source >= model->interruptSources)) {
+        Diagnostic(QMessageBox::Critical, "Error", QString("The %1 has no interrupt %2.").arg(model->name).arg(source));
+        return false;
+    }
+    scheduler.add({ cycle, source, period });
+    cycleLimit = cycleCount;
+    return true;
+}
+
+
+// Remove the scheduled interrupts
+void Debugger::clearScheduledInterrupts() {
+    scheduler.clear();
+}
+
+
+// Name of an interrupt source of the selected core
+QString Debugger::getInterruptSourceName(int source) const {
+    if ((source < 0) || (source >= model->interruptSources))
+        return QString();
+    return model->interruptNames[source];
+}
+
+
+// Add external bus wait states to the cycle count, the counters and the instruction's total
+void Debugger::ChargeBus(int waits, bool fetch) {
+    cycleCount += waits;
+    if (fetch)
+        counters.busFetchCycles += waits;
+    else
+        counters.busDataCycles += waits;
+    if (busTable)
+        busTable[(instructionPC - busStart) / 2] += waits;
+}
+
+
+// Find the per-word wait state table and the fetch cost of the text segment holding the instruction. Outside
+// the text there is no table, and the fetch cost is looked up again for every instruction
+void Debugger::SelectBusTable() {
+    busTable = nullptr;
+    busStart = busEnd = 0;
+    busFetch = model->bus[PerfCounters::regionOf(instructionPC)].fetch;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if ((segments[i].kind == SegmentKind::Text) && segments[i].contains(instructionPC) && !busCycles[i].empty()) {
+            busTable = busCycles[i].data();
+            busStart = segments[i].address;
+            busEnd = segments[i].address + segments[i].size;
+            return;
+        }
+    }
+}
+
+
+// Read a long without side effects, for the control registers
+int Debugger::PeekLong(int adrs) const {
+    const uint8_t* walk = MemoryBuffer.data() + adrs;
+    return (walk[0] << 24) | (walk[1] << 16) | (walk[2] << 8) | walk[3];
+}
+
+
+// Write a long without side effects, for the registers the core updates itself
+void Debugger::PokeLong(int adrs, int data) {
+    uint8_t* walk = MemoryBuffer.data() + adrs;
+    walk[0] = (data >> 24) & 0xFF;
+    walk[1] = (data >> 16) & 0xFF;
+    walk[2] = (data >> 8) & 0xFF;
+    walk[3] = data & 0xFF;
+    MarkDirty(adrs, 4);
+}
+
+
+// addqmod/subqmod: add or subtract 1-32, the bits set in D_MOD keep their original value (circular buffers);
+// C from the full result, Z and N from the masked one
+int Debugger::QuickModulo(bool subtract, int n, int original) {
+    if (n == 0) n = 32;
+    int result = subtract ? core.sub(n, original) : core.add(n, original);
+    int mod = PeekLong(D_MOD);
+    result = (result & ~mod) | (original & mod);
+    core.setResult(result);
+    return result;
+}
+
+
+// MMULT: multiply the vector packed in the alternate bank, starting at reg1, by a row or column of the
+// matrix at MTXA. MTXC bits 0-3 give the element count (two per register, low word first), bit 4 column stepping
+int Debugger::MatrixMultiplyInstruction(int reg1) {
+    int mtxc = PeekLong(model->mtxc);
+    int matrix = PeekLong(model->mtxa) & 0xFFFFFC;
+    int width = mtxc & 15;
+    int stride = (mtxc & 0x10) ? width * 4 : 4;
+    int16_t vector[16];
+    for (int i = 0; i < width; ++i) {
+        int value = core.alternate[(reg1 + i / 2) & 31];
+        vector[i] = static_cast<int16_t>((i & 1) ? (value >> 16) : value);
+    }
+    int end = matrix + stride * (width - 1) + 4;
+    if ((width == 0) || (end > MemorySize)) {
+        if (width != 0) {
+            std::string str = "MMULT matrix outside allocated buffer !\nAddress = $" + IntToHex(matrix, 8);
+            Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
+        }
+        return 0;
+    }
+    // Each element is a long load of the program, for the watchpoints and the shadow check
+    if (!watchpoints.empty() || shadow.isEnabled()) {
+        for (int i = 0; i < width; ++i) {
+            WatchAccess(matrix + i * stride, 4, WatchKind::Read);
+            ShadowRead(matrix + i * stride, 4);
+        }
+    }
+    MemoryRegion region = PerfCounters::regionOf(matrix);
+    counters.loads[region] += width;
+    if (model->bus[region].read)
+        ChargeBus(model->bus[region].read * width, false);
+    // The row kernel reads whole 16-byte blocks: at the very end of memory the scalar version is used
+    if ((stride == 4) && (matrix + ((width + 3) & ~3) * 4 > MemorySize))
+        return MatrixMultiplyScalar(MemoryBuffer.data() + matrix, stride, vector, width);
+    return MatrixMultiply(MemoryBuffer.data() + matrix, stride, vector, width);
+}
+
+
 // Read a long value from the specified address
 int Debugger::ReadLong(int adrs) {
     int memadrs = adrs;
@@ -947,19 +2268,25 @@ int Debugger::ReadLong(int adrs) {
     if (memadrs != adrs) {
         if (!memoryWarningEnabled) {
             std::string str = "ReadLong not on a Long aligned address !\nAddress = $" + IntToHex(memadrs, 8) + "\nShould be = $" + IntToHex(adrs, 8);
-            QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+            Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         }
     }
     memadrs = adrs;
+    WatchAccess(memadrs, 4, WatchKind::Read);
+    MemoryRegion region = PerfCounters::regionOf(memadrs);
+    ++counters.loads[region];
+    if (model->bus[region].read)
+        ChargeBus(model->bus[region].read, false);
     if ((memadrs >= 0) && ((memadrs + 4) <= MemorySize)) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
         int value = (walk[0] << 24) | (walk[1] << 16) | (walk[2] << 8) | walk[3];
+        ShadowRead(memadrs, 4);
         return value;
     }
     else {
         if (!memoryWarningEnabled) {
             std::string str = "ReadLong outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-            QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+            Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         }
         return -1;
     }
@@ -1000,23 +2327,13 @@ std::string Debugger::IntToHex(int value, int width) const {
 
 
 // Check if the jump condition matches the current flags
+// Each entry holds the match for the 8 combinations of Z (bit 0), C (bit 1) and N (bit 2)
 bool Debugger::JumpConditionMatch(uint8_t condition) const {
-    return
-        (condition == 0) ||
-        ((condition == 1) && (flagZ == 0)) ||
-        ((condition == 2) && (flagZ == 1)) ||
-        ((condition == 4) && (flagC == 0)) ||
-        ((condition == 5) && (flagC == 0) && (flagZ == 0)) ||
-        ((condition == 6) && (flagC == 0) && (flagZ == 1)) ||
-        ((condition == 8) && (flagC == 1)) ||
-        ((condition == 9) && (flagC == 1) && (flagZ == 0)) ||
-        ((condition == 0xA) && (flagC == 1) && (flagZ == 1)) ||
-        ((condition == 0x14) && (flagN == 0)) ||
-        ((condition == 0x15) && (flagN == 0) && (flagZ == 0)) ||
-        ((condition == 0x16) && (flagN == 0) && (flagZ == 1)) ||
-        ((condition == 0x18) && (flagN == 1)) ||
-        ((condition == 0x19) && (flagN == 1) && (flagZ == 0)) ||
-        ((condition == 0x1A) && (flagN == 1) && (flagZ == 1));
+    static const uint8_t matches[32] = {
+        0xFF, 0x55, 0xAA, 0,    0x33, 0x11, 0x22, 0,    0xCC, 0x44, 0x88, 0,    0, 0, 0, 0,
+        0,    0,    0,    0,    0x0F, 0x05, 0x0A, 0,    0xF0, 0x50, 0xA0, 0,    0, 0, 0, 0
+    };
+    return (matches[condition & 31] >> (core.z() | (core.c() << 1) | (core.n() << 2))) & 1;
 }
 
 
@@ -1032,14 +2349,20 @@ void GPUDebugger::setMemoryWarningEnabled(bool enabled) {
 int Debugger::ReadByte(int adrs) {
     int memadrs = adrs;
     if (CheckInternalRam(memadrs))
-        QMessageBox::warning(nullptr, "Warning", "ReadByte not allowed in internal RAM!");
+        Diagnostic(QMessageBox::Warning, "Warning", "ReadByte not allowed in internal RAM!");
+    WatchAccess(memadrs, 1, WatchKind::Read);
+    MemoryRegion region = PerfCounters::regionOf(memadrs);
+    ++counters.loads[region];
+    if (model->bus[region].read)
+        ChargeBus(model->bus[region].read, false);
     if ((memadrs >= 0) && memadrs < MemorySize) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
+        ShadowRead(memadrs, 1);
         return walk[0];
     }
     else if (!memoryWarningEnabled) {
         std::string str = "ReadByte outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-        QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
         return -1;
     }
     return 0;
@@ -1052,19 +2375,28 @@ int Debugger::ReadWord(int adrs, bool nochk) {
     adrs = adrs & 0xFFFFFFFE;
     if ((memadrs != adrs) && !memoryWarningEnabled) {
         std::string str = "ReadWord not on a Word aligned address !\nAddress = $" + IntToHex(memadrs, 8) + "\nShould be = $" + IntToHex(adrs, 8);
-        QMessageBox::warning(nullptr, "Warning", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Warning, "Warning", QString::fromStdString(str));
     }
     if (CheckInternalRam(memadrs) && !nochk)
-        QMessageBox::warning(nullptr, "Warning", "ReadWord not allowed in internal ram !");
+        Diagnostic(QMessageBox::Warning, "Warning", "ReadWord not allowed in internal ram !");
     memadrs = adrs;
+    if (!nochk) {
+        WatchAccess(memadrs, 2, WatchKind::Read);
+        MemoryRegion region = PerfCounters::regionOf(memadrs);
+        ++counters.loads[region];
+        if (model->bus[region].read)
+            ChargeBus(model->bus[region].read, false);
+    }
     if ((memadrs >= 0) && (memadrs + 2) <= MemorySize) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
         int value = (walk[0] << 8) | walk[1];
+        if (!nochk)
+            ShadowRead(memadrs, 2);
         return value;
     }
     else if (!memoryWarningEnabled) {
         std::string str = "ReadWord outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-        QMessageBox::warning(nullptr, "Warning", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Warning, "Warning", QString::fromStdString(str));
         return -1;
     }
     return 0;
@@ -1077,19 +2409,32 @@ void Debugger::WriteWord(int adrs, int data) {
     adrs = adrs & 0xFFFFFFFE;
     if ((memadrs != adrs) && !memoryWarningEnabled) {
         std::string str = "WriteWord not on a Word aligned address !\nAddress = $" + IntToHex(memadrs, 8) + "\nShould be = $" + IntToHex(adrs, 8);
-        QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
     }
     if (CheckInternalRam(memadrs))
-        QMessageBox::warning(nullptr, "Warning", "WriteWord not allowed in internal ram !");
+        Diagnostic(QMessageBox::Warning, "Warning", "WriteWord not allowed in internal ram !");
     memadrs = adrs;
+    if (IsControlRegister(memadrs)) {
+        ControlStore(memadrs, data, 2);
+        return;
+    }
+    if (memadrs & 2)
+        CaptureAudio(memadrs, data);
+    WatchAccess(memadrs, 2, WatchKind::Write);
+    MemoryRegion region = PerfCounters::regionOf(memadrs);
+    ++counters.stores[region];
+    if (model->bus[region].write)
+        ChargeBus(model->bus[region].write, false);
     if (memadrs >= 0 && (memadrs + 2) <= MemorySize) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
         walk[0] = (data >> 8) & 0xFF;
         walk[1] = data & 0xFF;
+        MarkDirty(memadrs, 2);
+        ShadowWrite(memadrs, 2);
     }
     else if (!memoryWarningEnabled) {
         std::string str = "WriteWord outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-        QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
     }
     MemWriteCheck();
 }
@@ -1099,14 +2444,25 @@ void Debugger::WriteWord(int adrs, int data) {
 void Debugger::WriteByte(int adrs, int data) {
     int memadrs = adrs;
     if (CheckInternalRam(memadrs))
-        QMessageBox::warning(nullptr, "Warning", "WriteByte not allowed in internal ram !");
+        Diagnostic(QMessageBox::Warning, "Warning", "WriteByte not allowed in internal ram !");
+    if (IsControlRegister(memadrs)) {
+        ControlStore(memadrs, data, 1);
+        return;
+    }
+    WatchAccess(memadrs, 1, WatchKind::Write);
+    MemoryRegion region = PerfCounters::regionOf(memadrs);
+    ++counters.stores[region];
+    if (model->bus[region].write)
+        ChargeBus(model->bus[region].write, false);
     if ((memadrs >= 0) && (memadrs < MemorySize)) {
         uint8_t* walk = MemoryBuffer.data() + memadrs;
         walk[0] = data & 0xFF;
+        MarkDirty(memadrs, 1);
+        ShadowWrite(memadrs, 1);
     }
     else if (!memoryWarningEnabled) {
         std::string str = "WriteByte outside allocated buffer !\nAddress = $" + IntToHex(adrs, 8);
-        QMessageBox::critical(nullptr, "Error", QString::fromStdString(str));
+        Diagnostic(QMessageBox::Critical, "Error", QString::fromStdString(str));
     }
     MemWriteCheck();
 }
@@ -1114,24 +2470,15 @@ void Debugger::WriteByte(int adrs, int data) {
 
 // Check memory write conditions and update registers accordingly
 void Debugger::MemWriteCheck() {
-    if (GPUMode) {
-        if ((ReadLong(G_CTRL) & 1) == 0 && gpurun) {
-            StopGPU();
-            QMessageBox::warning(nullptr, "Stop", "GPU Self Stopped!");
-        }
-        CurRegBank = (ReadLong(G_FLAGS) >> 14) & 1;
+    if ((PeekLong(model->ctrl) & 1) == 0 && gpurun) {
+        StopGPU();
+        Diagnostic(QMessageBox::Warning, "Stop", QString("%1 Self Stopped!").arg(model->name));
+    }
+    SyncRegisterBank();
 /*
-        GDBUG.G_HIDATALabel.Caption = "G_HIDATA: $" + IntToHex(ReadLong(G_HIDATA), 8);
-        GDBUG.G_REMAINLabel.Caption = "G_REMAIN: $" + IntToHex(ReadLong(G_REMAIN), 8);
+    GDBUG.G_HIDATALabel.Caption = "G_HIDATA: $" + IntToHex(ReadLong(G_HIDATA), 8);
+    GDBUG.G_REMAINLabel.Caption = "G_REMAIN: $" + IntToHex(ReadLong(G_REMAIN), 8);
 */
-    }
-    else {
-        if ((ReadLong(D_CTRL) & 1) == 0 && gpurun) {
-            StopGPU();
-            QMessageBox::warning(nullptr, "Stop", "DSP Self Stopped!");
-        }
-        CurRegBank = (ReadLong(D_FLAGS) >> 14) & 1;
-    }
 /*
     GDBUG.RegBank0Label.FontStyle = 0;
     GDBUG.RegBank1Label.FontStyle = 0;
@@ -1152,14 +2499,5 @@ void Debugger::StopGPU() {
 
 // Check if the address is in the GPU, or DSP, RAM range
 bool Debugger::CheckInternalRam(int memadrs) {
-    int mas, mae;
-    if (GPUMode) {
-        mas = G_RAM;
-        mae = G_RAM + 4 * 1024;
-    }
-    else {
-        mas = D_RAM;
-        mae = D_RAM + 8 * 1024;
-    }
-    return (memadrs >= mas) && (memadrs < mae);
+    return (memadrs >= model->ram) && (memadrs < model->ram + model->ramSize);
 }
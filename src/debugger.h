@@ -5,27 +5,95 @@
 #include <cstdint>
 #include <QSet> // Include QSet for breakpoints
 #include <QObject> // Include QObject for signals and slots
+#include <QMessageBox>
 #include <functional> // Include functional for std::function
+#include "loader.h"
+#include "symbols.h"
+#include "corestate.h"
+#include "perfcounters.h"
+#include "shadowmemory.h"
+#include "coverage.h"
+#include "eventscheduler.h"
+#include "nativehooks.h"
+#include "profiler.h"
+#include "instructionmix.h"
+#include "audiocapture.h"
+
+struct MachineSnapshot; // statediff.h
 
 extern const int MemorySize;
 extern std::vector<uint8_t> MemoryBuffer;
 
+// Reason why the last execute() call returned
+enum class StopReason { None, Budget, Breakpoint, Watchpoint, ProgramEnd, SelfStop, Error };
+
+// Operations of the DSP that take the place of GPU opcodes; the GPU ones keep their opcode as operation
+enum DSPOperation : uint8_t {
+    OpSubqmod = 64, OpSat16s, OpSat32s, OpMirror, OpAddqmod, OpImacn40, OpResmac40, OpIllegal, OperationCount
+};
+
+// Wait states of one memory region, seen from a core: per instruction word fetched, per data read and write
+struct BusTiming {
+    uint8_t fetch;
+    uint8_t read;
+    uint8_t write;
+};
+
+// Copy of the state the UI shows during a run, published by the thread that runs the core
+struct CoreSnapshot {
+    int32_t regs[2][32];
+    int bank;
+    int pc;
+    int z, n, c;
+    uint64_t cycles;
+    uint64_t instructions;
+    PerfCounters counters;  // their cycles set, for the metrics served during a run
+};
+
+// Data accesses a watchpoint reacts to
+enum class WatchKind { Write, Read, Access };
+
 class Debugger : public QObject { // Ensure QObject is a base class
     Q_OBJECT // Required for Qt's meta-object system
+    friend class HookContext;
 
 public:
+    // A watched address range, or the access that hit one
+    struct Watchpoint {
+        int address;
+        int length;
+        WatchKind kind;
+    };
+
     explicit Debugger(QObject* parent = nullptr);
     ~Debugger();
     bool loadBin(const QString& filename, int address);
+    bool saveState(const QString& filename, bool compress = true);
+    bool loadState(const QString& filename);
+    // Copy the machine state and the memory pages written since the load, for StateDiff
+    void captureSnapshot(MachineSnapshot& snapshot) const;
+    // Read a state file into a snapshot, leaving the machine alone
+    bool loadSnapshot(const QString& filename, MachineSnapshot& snapshot);
     void reset();
     void step(uint16_t w, bool exec);
     void run();
+    uint64_t execute(uint64_t budget, uint64_t cycleBudget = UINT64_MAX);
+    uint64_t runSlice(uint64_t budget, uint64_t cycleBudget);
+    StopReason getStopReason() const;
+    uint64_t getCycleCount() const;
+    const PerfCounters& getCounters();
+    uint64_t getBusCycles(int adrs) const;
+    void resetCounters();
     void skip();
     // ... other methods as needed
 
     // Data for UI
     QStringList getRegBank(int bank) const;
 	int getRegBankRegisterValue(int bank, int reg) const;
+    void setRegBankRegisterValue(int bank, int reg, int value);
+    uint32_t getFlagsValue();
+    void setFlagsValue(uint32_t value);
+    void setPCValue(int value);
     QStringList getCodeView() const;
     QString getFlags() const;
     QString getPCString() const;
@@ -35,6 +103,8 @@ public:
     QString getHiData() const;
     QString getBP() const;
     int getProgress() const;
+    // Copy the registers, flags, PC and counts; only valid from the thread running the core
+    void snapshot(CoreSnapshot& state) const;
 
     // New methods to check debugger state
     bool canRun() const;
@@ -44,18 +114,101 @@ public:
 
     void setStringPC(const QString& pcValue);
     void setGPUMode(bool isGPUMode);
+    bool isGPUMode() const { return model == &GPUModel; }
     void setBreakpoint(const QString& address);
+    void addBreakpoint(int address);
+    void removeBreakpoint(int address);
     bool hasBreakpoint(int address) const;
+    void addWatchpoint(int address, int length, WatchKind kind);
+    void removeWatchpoint(int address, int length, WatchKind kind);
+    Watchpoint getWatchHit() const;
+
+    bool readMemory(int adrs, int size, uint8_t* data) const;
+    bool writeMemory(int adrs, int size, const uint8_t* data);
+    // Memory pages of 1 << DirtyPageShift bytes written since the last call, for the memory viewer
+    void takeDirtyPages(std::vector<int>& pages);
+    static const int DirtyPageShift = 12;
+
+    // Report reads of bytes never written since the load, and accesses next to the declared buffers
+    void setShadowCheck(bool enabled);
+    bool isShadowCheckEnabled() const { return shadow.isEnabled(); }
+    void addShadowBuffer(int address, int length, const QString& name);
+    void clearShadowBuffers();
+    const std::vector<ShadowMemory::Buffer>& getShadowBuffers() const { return shadow.getBuffers(); }
+    // First finding of each kind per instruction, since the load
+    const std::vector<ShadowFinding>& getShadowFindings() const { return shadowFindings; }
+    // Messages of the findings an interactive run held back instead of showing a box for each, then forget them
+    QStringList takeShadowReports();
+
+    // Record the instructions executed and the outcomes of conditional branches, until turned off or a load
+    void setCoverage(bool enabled);
+    bool isCoverageEnabled() const { return coverage.isEnabled(); }
+    const Coverage& getCoverage() const { return coverage; }
+    // OR the bitmaps saved by another run of the same image
+    bool mergeCoverage(const QString& filename);
+    // The bitmaps, or an lcov tracefile over the listing (same name, .lst)
+    bool writeCoverage(const QString& filename, CoverageFormat format);
+    // Shadow call stack and call tree of the calls the idioms recognize, from nothing recorded, until turned off
+    void setProfiler(bool enabled);
+    bool isProfilerEnabled() const { return profiler.isEnabled(); }
+    void setCallIdioms(const CallIdioms& idioms) { profiler.setIdioms(idioms); }
+    const Profiler& getProfiler() const { return profiler; }
+    // A Chrome trace if the name ends with .json, collapsed stacks if .folded, the per-function report otherwise
+    bool writeProfile(const QString& filename);
+    // Operation histogram, operation pairs and register traffic, from nothing recorded, until turned off; a load or
+    // a switch of core starts it over
+    void setInstructionMix(bool enabled);
+    bool isInstructionMixEnabled() const { return mix.isEnabled(); }
+    const InstructionMix& getInstructionMix() const { return mix; }
+    // JSON if the name ends with .json, text tables otherwise
+    bool writeInstructionMix(const QString& filename);
+    // Stream the stores of either core to the I2S DAC registers to a WAV file, until stopped; 'rate' 0 keeps
+    // the I2S frame rate of SCLK
+    bool startAudioCapture(const QString& filename, int rate, AudioClock clock);
+    bool stopAudioCapture();
+    const AudioCapture& getAudioCapture() const { return audio; }
+    // True for a jr or jump with a condition at the address, in the selected core
+    bool isConditionalBranch(int adrs) const;
+
+    // Interrupts: latches in CTRL, enables, IMASK and clear bits in FLAGS, vectors every 16 bytes from the start of
+    // the core's RAM. A source is raised by the host, by a scheduled event, or by the program setting the force
+    // bit of CTRL; the run loop takes it between two instructions
+    static const int MaxInterruptSources = PerfCounters::InterruptSources;
+    int getInterruptSourceCount() const { return model->interruptSources; }
+    QString getInterruptSourceName(int source) const;
+    void raiseInterrupt(int source);
+    // Raise a source at a cycle, then every 'period' cycles if not zero; the pattern restarts on reset()
+    bool scheduleInterrupt(int source, uint64_t cycle, uint64_t period);
+    void clearScheduledInterrupts();
+    const std::vector<ScheduledEvent>& getScheduledInterrupts() const { return scheduler.getEvents(); }
+
+    // Native handlers run in place of routines during runs; targets are resolved again by each load. Dispatched
+    // through the breakpoint bitmap, so the run loop only looks them up at marked addresses
+    bool addHook(const NativeHook& hook);
+    void clearHooks();
+    const std::vector<NativeHook>& getHooks() const { return hooks; }
+
+    // Fast-forward small loops whose iterations leave the machine unchanged (polling loops: loads, compares and a
+    // backward branch, no stores), up to the next event or the end of the budget; on by default
+    void setIdleSkip(bool enabled) { idleSkip = enabled; }
+    bool isIdleSkipEnabled() const { return idleSkip; }
 
     void editRegister(int bank, const QString& value);
 
     QStringList disassemble(int loadAddress, int programSize) const;
+    const uint8_t* getDecodeTable() const { return model->operations; }
     int getProgramSize() const;
+    const std::vector<Segment>& getSegments() const;
+    bool loadSymbols(const QString& filename);
+    const SymbolTable& getSymbols() const;
 
     void setMemoryWarningEnabled(bool enabled) { memoryWarningEnabled = enabled; }
+    void setInteractive(bool enabled);
+    bool isInteractive() const { return interactive; }
 
 signals:
     void disassemblyProgress(int percent);
+    void diagnostic(const QString& text);
 
 private:
     int progress;
@@ -65,25 +218,95 @@ private:
     bool isReadyToReset;
     int pc;
     int programSize;
-    std::vector<int> regBank[2];
+    CoreState core; // Registers of both banks and flags
     QStringList codeViewLines;
     int breakpointAddress = 0;
     QSet<int> breakpoints; // Stores all breakpoints
-    int loadAddress = 0; // Stores the last loading address
-    int flagZ = 0;
-    int flagN = 0;
-    int flagC = 0;
-    int CurRegBank = 0; // New member added
+    std::vector<uint32_t> breakpointMap; // One bit per instruction word holding a breakpoint or a hook
+    std::vector<NativeHook> hooks;
+    QHash<int, int> hookAt; // Resolved address to index in hooks
+    std::vector<uint32_t> dirtyPages; // One bit per memory page written since the last takeDirtyPages()
+    std::vector<uint32_t> writtenPages; // Pages written or loaded before it; with dirtyPages, all that may be non-zero
+    int breakpointPC = -1; // Breakpoint the last execute() stopped on
+    std::vector<Watchpoint> watchpoints;
+    Watchpoint watchHit = { -1, 0, WatchKind::Access }; // Access that stopped the last execute()
+    StopReason stopReason = StopReason::None;
+    uint64_t cycleCount = 0; // Modelled cycles since the last reset
+    PerfCounters counters; // Statistics since the last load
+    ShadowMemory shadow; // Written bytes and buffer red zones, allocated by setShadowCheck()
+    Coverage coverage; // Instructions executed and branch outcomes, allocated by setCoverage()
+    Profiler profiler; // Calls and their cost, on while setProfiler(true)
+    InstructionMix mix; // Operation mix and register traffic, allocated by setInstructionMix()
+    AudioCapture audio; // I2S DAC stores streamed to a WAV file
+    EventScheduler scheduler; // Interrupts raised at set cycles
+    uint64_t cycleLimit = UINT64_MAX; // Cycle the run loop stops at: end of its budget, or next event check
+    uint64_t raisedCycle[MaxInterruptSources] = {}; // When each latch was set, for the latency
+    int handlerSource = -1; // Interrupt whose handler runs, until IMASK is cleared
+    uint64_t handlerStart = 0;
+    bool idleSkip = true;
+    // State at the head of the last small backward loop, for SkipIdleLoop()
+    struct IdleLoop {
+        int start = -1; // -1 when there is no candidate
+        int end = -1;
+        bool measuring = false; // an unchanged iteration was seen, the next one is measured
+        int32_t regs[2][32];
+        int bank, z, n, c;
+        int64_t accumulator;
+        uint64_t stores, cycles, count;
+        PerfCounters counters;
+        std::vector<uint64_t> bus; // wait states of the loop's instructions
+    } idle;
+    std::vector<ShadowFinding> shadowFindings;
+    QSet<qint64> shadowReported; // Instruction and kind of the findings reported
+    QStringList shadowReports; // Messages of the findings not shown yet, in interactive mode
+    std::vector<std::vector<uint64_t>> busCycles; // External bus wait states per instruction word, by segment
+    uint64_t* busTable = nullptr; // Table of the text segment holding instructionPC, covering busStart-busEnd
+    int busStart = 0;
+    int busEnd = 0;
+    int busFetch = 0; // Wait states per instruction word fetched there
+    int instructionPC = 0; // Address of the instruction being executed, for the bus accounting
+    int loadAddress = 0; // Stores the entry point of the last load
+    std::vector<Segment> segments; // Segment table of the last load
+    uint64_t imageHash = 0; // Segments and contents of the last load, 0 before the first one
+    int segmentStart = 0; // Bounds of the text segment holding the PC
+    int segmentEnd = 0;
+    SymbolTable symbols; // Object file, map file and generated labels
     bool memoryWarningEnabled = true; // New variable for UI control
+    bool interactive = true; // Diagnostics as message boxes, or as diagnostic() signals
     int JMPPC = 0;
-	bool GPUMode = true; // GPU mode is default
+    // Decode table, control registers and bus timing of one core; setGPUMode() selects the model once, so the
+    // interpreter never tests the mode per instruction
+    struct CoreModel {
+        const char* name;
+        const uint8_t* operations; // opcode to operation (the GPU opcode, or a DSP-only operation)
+        int flags;
+        int mtxc;
+        int mtxa;
+        int ctrl;
+        int remain;
+        int ram;
+        int ramSize;
+        const BusTiming* bus; // per MemoryRegion
+        int interruptSources;
+        const char* const* interruptNames;
+    };
+    static const CoreModel GPUModel;
+    static const CoreModel DSPModel;
+    const CoreModel* model = &GPUModel; // GPU mode is default
     const int G_FLAGS = 0xF02100;
+    const int G_MTXC = 0xF02104;
+    const int G_MTXA = 0xF02108;
     const int G_CTRL = 0xF02114;
     const int G_HIDATA = 0xF02118;
     const int G_REMAIN = 0xF0211C;
     const int G_RAM = 0xF03000;
     const int D_FLAGS = 0xF1A100;
+    const int D_MTXC = 0xF1A104;
+    const int D_MTXA = 0xF1A108;
     const int D_CTRL = 0xF1A114;
+    const int D_MOD = 0xF1A118;
+    const int D_REMAIN = 0xF1A11C;
+    const int D_MACHI = 0xF1A120;
     const int D_RAM = 0xF1B000;
     bool gpurun = false;
     bool jumpbuffered = false;
@@ -92,10 +315,56 @@ public:
     int ReadWord(int adrs, bool nochk);
 
 private:
-    void Update_C_Flag_Add(int a, int b);
     void Update_ZN_Flag(int i);
-    void Update_C_Flag_Sub(int a, int b);
+    static int ShiftLeft(int value, int count);
+    static int ShiftRight(int value, int count);
+    static int ShiftRightArithmetic(int value, int count);
+    static int RotateRight(int value, int count);
     int ReadLong(int adrs);
+    int PeekLong(int adrs) const;
+    void PokeLong(int adrs, int data);
+    void SyncRegisterBank();
+    uint64_t ServiceEvents();
+    int PendingInterrupt() const;
+    void TakeInterrupt(int source);
+    int ControlWrite(int adrs, int data);
+    void ControlStore(int adrs, int data, int size);
+    bool IsControlRegister(int adrs) const {
+        return ((adrs & ~3) == model->flags) || ((adrs & ~3) == model->ctrl);
+    }
+    // Mark the pages holding the first and last byte written; writes never span more than two pages
+    void MarkDirty(int adrs, int size) {
+        dirtyPages[adrs >> (DirtyPageShift + 5)] |= 1u << ((adrs >> DirtyPageShift) & 31);
+        int last = adrs + size - 1;
+        dirtyPages[last >> (DirtyPageShift + 5)] |= 1u << ((last >> DirtyPageShift) & 31);
+    }
+    // Shadow memory check of an aligned data access inside the memory buffer
+    void ShadowRead(int adrs, int size) {
+        if (shadow.isEnabled() && !shadow.readable(adrs, size))
+            ShadowFault(adrs, size, false);
+    }
+    void ShadowWrite(int adrs, int size) {
+        if (shadow.isEnabled() && !shadow.write(adrs, size))
+            ShadowFault(adrs, size, true);
+    }
+    void ShadowFault(int adrs, int size, bool write);
+    // A store to the low word of an I2S register goes to the audio capture
+    void CaptureAudio(int adrs, int data) {
+        if (audio.isActive() && (adrs >= I2SLeft) && (adrs <= I2SClock + 3))
+            audio.store(adrs & ~3, data, cycleCount);
+    }
+    // Coverage of a conditional branch outcome
+    void CoverBranch(int condition, bool taken) {
+        if (coverage.isEnabled() && condition)
+            coverage.branch(instructionPC, taken);
+    }
+    void ShadowDefineLoaded();
+    void ChargeBus(int waits, bool fetch);
+    void SelectBusTable();
+    int MatrixMultiplyInstruction(int reg1);
+    int QuickModulo(bool subtract, int n, int original);
+    void WatchAccess(int adrs, int size, WatchKind kind);
+    void Diagnostic(QMessageBox::Icon icon, const QString& title, const QString& text);
     void WriteLong(int adrs, int data);
     int ReadByte(int adrs);
     void WriteByte(int adrs, int data);
@@ -105,8 +374,22 @@ private:
     void MemWriteCheck();
     void StopGPU();
     bool CheckInternalRam(int memadrs);
+    bool InTextSegment(int adrs);
+    bool IsBreakpointAddress(int adrs) const;
+    void UpdateStopBit(int adrs);
+    uint64_t SkipIdleLoop(int start, int end, uint64_t count, uint64_t budget);
+    bool SameIdleState(uint64_t stores) const;
+    void ResolveHooks(bool report);
+    bool CallHook(const NativeHook& hook);
+    void ProfileJump(int from, int target);
+    void HostWritten(int adrs, int size);
+    void MarkPages(int adrs, int size);
+    void CaptureState(MachineSnapshot& snapshot) const;
+    void CollectBranchLabels();
+    void RebuildCodeView();
     void CheckGPUPC();
     void RunGPU();
+    void EndRun();
     std::string GetJumpFlag(uint8_t flag) const;
     std::string IntToHex(int value, int width) const;
 };
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include "eventscheduler.h"
+
+// Add an event and arm it, from the base cycle of the pattern
+void EventScheduler::add(const ScheduledEvent& event) {
+    events.push_back(event);
+    ScheduledEvent armed = event;
+    armed.cycle = (event.cycle <= UINT64_MAX - base) ? base + event.cycle : UINT64_MAX;
+    Push(armed);
+}
+
+
+// Remove every event
+void EventScheduler::clear() {
+    events.clear();
+    heap.clear();
+    sequence = 0;
+}
+
+
+// Arm the events added again, their cycles counted from 'from'
+void EventScheduler::restart(uint64_t from) {
+    heap.clear();
+    sequence = 0;
+    base = from;
+    std::vector<ScheduledEvent> added;
+    added.swap(events);
+    for (const ScheduledEvent& event : added)
+        add(event);
+}
+
+
+// Take the next event due at 'cycle'; a periodic one goes back in the heap at its first period after 'cycle', so
+// the periods missed while the cycle count jumped ahead (a state restored, a long hook) are raised only once
+bool EventScheduler::takeDue(uint64_t cycle, ScheduledEvent& event) {
+    if (heap.empty() || (heap.front().event.cycle > cycle))
+        return false;
+    std::pop_heap(heap.begin(), heap.end(), Later);
+    event = heap.back().event;
+    heap.pop_back();
+    if (event.period) {
+        ScheduledEvent next = event;
+        uint64_t periods = (cycle - event.cycle) / event.period + 1;
+        if (periods <= (UINT64_MAX - event.cycle) / event.period) {
+            next.cycle = event.cycle + periods * event.period;
+            Push(next);
+        }
+    }
+    return true;
+}
+
+
+// Insert an event in the heap
+void EventScheduler::Push(const ScheduledEvent& event) {
+    heap.push_back({ event, sequence++ });
+    std::push_heap(heap.begin(), heap.end(), Later);
+}
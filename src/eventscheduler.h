@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// A timed event: raise an interrupt source at a cycle, again every 'period' cycles if not zero
+struct ScheduledEvent {
+    uint64_t cycle;
+    int source;
+    uint64_t period;
+};
+
+// EventScheduler: min-heap of timed events ordered by cycle, ties in the order they were added. The run loop
+// only compares the cycle count with nextCycle() once per batch of instructions, and takes the due events when
+// it is reached. The events added are kept, so restart() arms the same pattern again after a reset or a state
+// load; their cycles count from the cycle given to it.
+class EventScheduler {
+public:
+    void add(const ScheduledEvent& event);
+    // Remove every event
+    void clear();
+    // Arm the events added again, their cycles counted from 'from'
+    void restart(uint64_t from);
+    const std::vector<ScheduledEvent>& getEvents() const { return events; }
+
+    // Cycle of the next event, UINT64_MAX if none
+    uint64_t nextCycle() const { return heap.empty() ? UINT64_MAX : heap.front().event.cycle; }
+    // Take the next event due at 'cycle'; a periodic one is scheduled again after 'cycle'. False if none is due
+    bool takeDue(uint64_t cycle, ScheduledEvent& event);
+
+private:
+    struct Entry {
+        ScheduledEvent event;
+        uint64_t order; // tie-break, so events due at the same cycle keep their order
+    };
+    // Heap order: the root is the earliest entry
+    static bool Later(const Entry& a, const Entry& b) {
+        return (a.event.cycle != b.event.cycle) ? (a.event.cycle > b.event.cycle) : (a.order > b.order);
+    }
+    void Push(const ScheduledEvent& event);
+
+    std::vector<ScheduledEvent> events; // as added
+    std::vector<Entry> heap;
+    uint64_t sequence = 0;
+    uint64_t base = 0;                  // cycle the events added count from
+};
@@ -0,0 +1,486 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <vector>
+#include <algorithm>
+#include "gdbserver.h"
+
+// Largest packet announced to the client; 'm' replies are capped to fit in it
+static const int PacketSize = 0x4000;
+// Instructions run between two visits of the event loop during a continue
+static const uint64_t SliceInstructions = 200000;
+// Register numbers of the target description
+static const int RegisterCount = 66;
+static const int RegPC = 64;
+
+// Constructor: the server drives the given debugger
+GdbServer::GdbServer(Debugger* debugger, QObject* parent)
+    : QObject(parent), debugger(debugger) {
+    connect(debugger, &Debugger::diagnostic, this, &GdbServer::onDiagnostic);
+}
+
+// Destructor: give the message boxes back to the user
+GdbServer::~GdbServer() {
+    debugger->setInteractive(true);
+}
+
+
+// Listen on "port" or "host:port" (TCP), or "unix:name" / a path (local socket)
+bool GdbServer::listen(const QString& address) {
+    if (address.startsWith("unix:") || address.contains('/') || address.contains('\\')) {
+        QString name = address.startsWith("unix:") ? address.mid(5) : address;
+        QLocalServer::removeServer(name); // Stale socket file of a previous session
+        localServer = new QLocalServer(this);
+        connect(localServer, &QLocalServer::newConnection, this, &GdbServer::onNewConnection);
+        if (!localServer->listen(name)) {
+            error = localServer->errorString();
+            return false;
+        }
+        return true;
+    }
+
+    QHostAddress host(QHostAddress::LocalHost);
+    QString port = address;
+    int colon = address.lastIndexOf(':');
+    if (colon >= 0) {
+        host = QHostAddress(address.left(colon));
+        port = address.mid(colon + 1);
+    }
+    bool ok = false;
+    quint16 portNumber = port.toUShort(&ok);
+    if (!ok || host.isNull()) {
+        error = QString("Invalid GDB server address: %1").arg(address);
+        return false;
+    }
+    tcpServer = new QTcpServer(this);
+    connect(tcpServer, &QTcpServer::newConnection, this, &GdbServer::onNewConnection);
+    if (!tcpServer->listen(host, portNumber)) {
+        error = tcpServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+
+// Accept a client; a second client is refused while one is attached
+void GdbServer::onNewConnection() {
+    QIODevice* socket = nullptr;
+    if (tcpServer && tcpServer->hasPendingConnections()) {
+        QTcpSocket* tcp = tcpServer->nextPendingConnection();
+        tcp->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(tcp, &QTcpSocket::disconnected, this, &GdbServer::onDisconnected);
+        socket = tcp;
+    } else if (localServer && localServer->hasPendingConnections()) {
+        QLocalSocket* local = localServer->nextPendingConnection();
+        connect(local, &QLocalSocket::disconnected, this, &GdbServer::onDisconnected);
+        socket = local;
+    }
+    if (!socket)
+        return;
+    if (client) {
+        socket->close();
+        socket->deleteLater();
+        return;
+    }
+    client = socket;
+    connect(client, &QIODevice::readyRead, this, &GdbServer::onReadyRead);
+    input.clear();
+    noAck = false;
+    debugger->setInteractive(false); // Diagnostics go to the client console, not to modal dialogs
+}
+
+
+// Client gone: stop a running target and detach
+void GdbServer::onDisconnected() {
+    if (!client)
+        return;
+    running = false;
+    client->deleteLater();
+    client = nullptr;
+    debugger->setInteractive(true);
+    emit stopped();
+}
+
+
+// Split the received bytes into packets, acknowledge and handle them
+void GdbServer::onReadyRead() {
+    input += client->readAll();
+    while (client && !input.isEmpty()) {
+        char c = input.at(0);
+        if (c == '\x03') { // ^C: interrupt a continue
+            input.remove(0, 1);
+            if (running) {
+                running = false;
+                interrupted = true;
+                ReportStop();
+            }
+            continue;
+        }
+        if (c == '-') { // Retransmission request
+            input.remove(0, 1);
+            if (!lastPacket.isEmpty())
+                client->write(lastPacket);
+            continue;
+        }
+        if (c != '$') { // '+' and noise between packets
+            input.remove(0, 1);
+            continue;
+        }
+        int hash = input.indexOf('#');
+        if ((hash < 0) || (input.size() < hash + 3))
+            return; // Incomplete packet, wait for more data
+        QByteArray payload = input.mid(1, hash - 1);
+        bool ok = false;
+        int checksum = input.mid(hash + 1, 2).toInt(&ok, 16);
+        input.remove(0, hash + 3);
+        uint8_t sum = 0;
+        for (char b : payload)
+            sum += static_cast<uint8_t>(b);
+        if (!noAck) {
+            if (!ok || (sum != checksum)) {
+                client->write("-");
+                continue;
+            }
+            client->write("+");
+        }
+        HandlePacket(payload);
+    }
+}
+
+
+// Frame and send a packet, escaping the characters the protocol reserves
+void GdbServer::SendPacket(const QByteArray& payload) {
+    if (!client)
+        return;
+    QByteArray packet;
+    packet.reserve(payload.size() + 4);
+    packet += '$';
+    uint8_t sum = 0;
+    for (char b : payload) {
+        if ((b == '#') || (b == '$') || (b == '}') || (b == '*')) {
+            packet += '}';
+            sum += '}';
+            b ^= 0x20;
+        }
+        packet += b;
+        sum += static_cast<uint8_t>(b);
+    }
+    packet += '#';
+    packet += QByteArray::number(sum, 16).rightJustified(2, '0');
+    lastPacket = packet;
+    client->write(packet);
+}
+
+
+// Dispatch one packet
+void GdbServer::HandlePacket(const QByteArray& packet) {
+    if (packet.isEmpty())
+        return;
+    char command = packet.at(0);
+    QByteArray args = packet.mid(1);
+
+    switch (command) {
+    case '?':
+        SendPacket(StopReply());
+        return;
+    case 'g': {
+        QByteArray reply;
+        reply.reserve(RegisterCount * 8);
+        for (int reg = 0; reg < RegisterCount; ++reg)
+            reply += ReadRegister(reg);
+        SendPacket(reply);
+        return;
+    }
+    case 'G': {
+        QByteArray values = QByteArray::fromHex(args);
+        for (int reg = 0; (reg < RegisterCount) && ((reg + 1) * 4 <= values.size()); ++reg) {
+            const uint8_t* v = reinterpret_cast<const uint8_t*>(values.constData()) + reg * 4;
+            WriteRegister(reg, (v[0] << 24) | (v[1] << 16) | (v[2] << 8) | v[3]);
+        }
+        SendPacket("OK");
+        return;
+    }
+    case 'p': {
+        bool ok = false;
+        int reg = args.toInt(&ok, 16);
+        SendPacket((ok && (reg >= 0) && (reg < RegisterCount)) ? ReadRegister(reg) : QByteArray("E00"));
+        return;
+    }
+    case 'P': {
+        int equal = args.indexOf('=');
+        bool okReg = false, okValue = false;
+        int reg = args.left(equal).toInt(&okReg, 16);
+        uint32_t value = args.mid(equal + 1).toUInt(&okValue, 16);
+        SendPacket((equal > 0) && okReg && okValue && WriteRegister(reg, value) ? "OK" : "E00");
+        return;
+    }
+    case 'm':
+        SendPacket(ReadMemory(args));
+        return;
+    case 'M':
+        SendPacket(WriteMemory(args, false));
+        return;
+    case 'X':
+        SendPacket(WriteMemory(args, true));
+        return;
+    case 'Z':
+    case 'z':
+        SendPacket(SetPoint(args, command == 'Z'));
+        return;
+    case 'c':
+    case 's':
+        Resume(command == 's', args);
+        return;
+    case 'H':
+        SendPacket("OK");
+        return;
+    case 'T':
+        SendPacket("OK"); // The only thread is alive
+        return;
+    case 'D':
+        SendPacket("OK");
+        client->close();
+        return;
+    case 'k':
+        running = false;
+        client->close(); // No reply: the client drops the connection once the target is killed
+        return;
+    default:
+        break;
+    }
+
+    if (packet.startsWith("qSupported")) {
+        SendPacket(QByteArray("PacketSize=") + QByteArray::number(PacketSize, 16)
+            + ";qXfer:features:read+;QStartNoAckMode+;swbreak+;hwbreak+;vContSupported+");
+    } else if (packet == "QStartNoAckMode") {
+        SendPacket("OK");
+        noAck = true;
+    } else if (packet.startsWith("qXfer:features:read:")) {
+        SendPacket(ReadFeature(packet.mid(20)));
+    } else if (packet == "qAttached") {
+        SendPacket("1");
+    } else if (packet == "qC") {
+        SendPacket("QC1");
+    } else if (packet == "qfThreadInfo") {
+        SendPacket("m1");
+    } else if (packet == "qsThreadInfo") {
+        SendPacket("l");
+    } else if (packet == "vCont?") {
+        SendPacket("vCont;c;s");
+    } else if (packet.startsWith("vCont;")) {
+        // Single thread: the first action applies
+        char action = (packet.size() > 6) ? packet.at(6) : 'c';
+        Resume((action == 's') || (action == 'S'), QByteArray());
+    } else {
+        SendPacket(QByteArray()); // Not supported
+    }
+}
+
+
+// Continue or single-step, from 'address' when given
+void GdbServer::Resume(bool singleStep, const QByteArray& address) {
+    if (!address.isEmpty()) {
+        bool ok = false;
+        int pc = address.toInt(&ok, 16);
+        if (ok)
+            debugger->setPCValue(pc);
+    }
+    running = true;
+    interrupted = false;
+    singleStepping = singleStep;
+    if (singleStep) {
+        debugger->execute(1);
+        running = false;
+        ReportStop();
+    } else {
+        QTimer::singleShot(0, this, &GdbServer::onRunSlice);
+    }
+}
+
+
+// Run one slice of a continue; the next slice is queued behind the pending events
+void GdbServer::onRunSlice() {
+    if (!running)
+        return;
+    debugger->execute(SliceInstructions);
+    if (debugger->getStopReason() == StopReason::Budget) {
+        QTimer::singleShot(0, this, &GdbServer::onRunSlice);
+        return;
+    }
+    running = false;
+    ReportStop();
+}
+
+
+// Send the stop reply of the last continue or step; a program that ran to its end has exited
+void GdbServer::ReportStop() {
+    bool exited = !interrupted && (debugger->getStopReason() == StopReason::ProgramEnd);
+    SendPacket(exited ? QByteArray("W00") : StopReply());
+    emit stopped();
+}
+
+
+// Stop reply: SIGINT after ^C, SIGTRAP with the breakpoint or watchpoint that stopped the target
+QByteArray GdbServer::StopReply() const {
+    if (interrupted)
+        return "S02";
+    if (debugger->getStopReason() == StopReason::Watchpoint) {
+        Debugger::Watchpoint hit = debugger->getWatchHit();
+        const char* kind = (hit.kind == WatchKind::Write) ? "watch" : (hit.kind == WatchKind::Read) ? "rwatch" : "awatch";
+        return QByteArray("T05") + kind + ':' + QByteArray::number(hit.address, 16) + ';';
+    }
+    if (!singleStepping && (debugger->getStopReason() == StopReason::Breakpoint))
+        return "T05swbreak:;";
+    return "S05";
+}
+
+
+// Register value as 8 hex digits, in the target (big-endian) order
+QByteArray GdbServer::ReadRegister(int reg) const {
+    uint32_t value;
+    if (reg < 64)
+        value = static_cast<uint32_t>(debugger->getRegBankRegisterValue(reg >> 5, reg & 31));
+    else if (reg == RegPC)
+        value = static_cast<uint32_t>(debugger->getPCValue());
+    else
+        value = debugger->getFlagsValue();
+    return QByteArray::number(value, 16).rightJustified(8, '0');
+}
+
+
+// Set a register; false for an unknown register number
+bool GdbServer::WriteRegister(int reg, uint32_t value) {
+    if ((reg < 0) || (reg >= RegisterCount))
+        return false;
+    if (reg < 64)
+        debugger->setRegBankRegisterValue(reg >> 5, reg & 31, static_cast<int>(value));
+    else if (reg == RegPC)
+        debugger->setPCValue(static_cast<int>(value));
+    else
+        debugger->setFlagsValue(value);
+    return true;
+}
+
+
+// m addr,length: the whole block in one copy
+QByteArray GdbServer::ReadMemory(const QByteArray& args) const {
+    QList<QByteArray> fields = args.split(',');
+    bool okAddress = false, okLength = false;
+    int address = (fields.size() == 2) ? fields[0].toInt(&okAddress, 16) : 0;
+    int length = (fields.size() == 2) ? fields[1].toInt(&okLength, 16) : 0;
+    if (!okAddress || !okLength)
+        return "E01";
+    length = std::min(length, (PacketSize - 4) / 2);
+    if (length <= 0)
+        return QByteArray();
+    std::vector<uint8_t> block(length);
+    if (!debugger->readMemory(address, length, block.data()))
+        return "E14";
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(block.data()), length).toHex();
+}
+
+
+// M addr,length:hex and X addr,length:binary
+QByteArray GdbServer::WriteMemory(const QByteArray& args, bool binary) {
+    int colon = args.indexOf(':');
+    QList<QByteArray> fields = args.left(colon).split(',');
+    bool okAddress = false, okLength = false;
+    int address = (fields.size() == 2) ? fields[0].toInt(&okAddress, 16) : 0;
+    int length = (fields.size() == 2) ? fields[1].toInt(&okLength, 16) : 0;
+    if ((colon < 0) || !okAddress || !okLength)
+        return "E01";
+
+    QByteArray data;
+    if (binary) {
+        data.reserve(length);
+        for (int i = colon + 1; i < args.size(); ++i) {
+            char b = args.at(i);
+            if ((b == '}') && (i + 1 < args.size()))
+                b = args.at(++i) ^ 0x20;
+            data += b;
+        }
+    } else {
+        data = QByteArray::fromHex(args.mid(colon + 1));
+    }
+    if (data.size() != length)
+        return "E01";
+    if (!debugger->writeMemory(address, length, reinterpret_cast<const uint8_t*>(data.constData())))
+        return "E14";
+    return "OK";
+}
+
+
+// Z/z type,addr,kind: breakpoints (0, 1) and write, read and access watchpoints (2, 3, 4)
+QByteArray GdbServer::SetPoint(const QByteArray& args, bool insert) {
+    QList<QByteArray> fields = args.split(',');
+    if (fields.size() < 3)
+        return "E01";
+    bool okAddress = false, okKind = false;
+    int type = fields[0].toInt();
+    int address = fields[1].toInt(&okAddress, 16);
+    int kind = fields[2].toInt(&okKind, 16);
+    if (!okAddress || !okKind)
+        return "E01";
+
+    if ((type == 0) || (type == 1)) {
+        if (insert)
+            debugger->addBreakpoint(address);
+        else
+            debugger->removeBreakpoint(address);
+        return "OK";
+    }
+    if ((type < 2) || (type > 4))
+        return QByteArray();
+    WatchKind watch = (type == 2) ? WatchKind::Write : (type == 3) ? WatchKind::Read : WatchKind::Access;
+    if (insert)
+        debugger->addWatchpoint(address, kind, watch);
+    else
+        debugger->removeWatchpoint(address, kind, watch);
+    return "OK";
+}
+
+
+// qXfer:features:read:annex:offset,length
+QByteArray GdbServer::ReadFeature(const QByteArray& args) const {
+    int colon = args.indexOf(':');
+    if ((colon < 0) || (args.left(colon) != "target.xml"))
+        return "E00";
+    QList<QByteArray> fields = args.mid(colon + 1).split(',');
+    bool okOffset = false, okLength = false;
+    int offset = (fields.size() == 2) ? fields[0].toInt(&okOffset, 16) : 0;
+    int length = (fields.size() == 2) ? fields[1].toInt(&okLength, 16) : 0;
+    if (!okOffset || !okLength)
+        return "E00";
+    QByteArray xml = TargetDescription();
+    if (offset >= xml.size())
+        return "l";
+    length = std::min(length, PacketSize - 8);
+    return ((offset + length < xml.size()) ? "m" : "l") + xml.mid(offset, length);
+}
+
+
+// Target description: both register banks, pc and flags
+QByteArray GdbServer::TargetDescription() const {
+    QByteArray xml = "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+                     "<target version=\"1.0\">\n<feature name=\"org.gpudbug.jrisc\">\n";
+    for (int reg = 0; reg < 64; ++reg) {
+        QByteArray name = "r" + QByteArray::number(reg & 31) + ((reg < 32) ? "" : "_1");
+        xml += "<reg name=\"" + name + "\" bitsize=\"32\" type=\"int32\" regnum=\"" + QByteArray::number(reg) + "\"/>\n";
+    }
+    xml += "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"64\"/>\n";
+    xml += "<reg name=\"flags\" bitsize=\"32\" type=\"uint32\" regnum=\"65\"/>\n";
+    xml += "</feature>\n</target>\n";
+    return xml;
+}
+
+
+// Forward the debugger diagnostics to the client console while the target runs, to the window otherwise
+void GdbServer::onDiagnostic(const QString& text) {
+    if (client && running)
+        SendPacket("O" + (text + "\n").toUtf8().toHex());
+    else
+        emit message(text);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include "debugger.h"
+
+class QTcpServer;
+class QLocalServer;
+class QIODevice;
+
+// GdbServer: GDB remote serial protocol stub for the emulated GPU/DSP.
+// One client at a time, on a local TCP port or a local (Unix domain) socket. The target description
+// exposes 66 32-bit big-endian registers: r0-r31 of bank 0, r0_1-r31_1 of bank 1, pc and flags.
+// Memory packets (m, M, X) move whole blocks straight from MemoryBuffer; Z0/Z1 set breakpoints and
+// Z2-Z4 watchpoints. A continue runs in slices on the event loop, so ^C and the UI stay responsive.
+class GdbServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit GdbServer(Debugger* debugger, QObject* parent = nullptr);
+    ~GdbServer();
+
+    // Listen on "port" or "host:port" (TCP), or "unix:name" / a path (local socket)
+    bool listen(const QString& address);
+    QString errorString() const { return error; }
+    bool isRunning() const { return running; }
+
+signals:
+    // The target stopped after a continue or a step; the UI can refresh
+    void stopped();
+    // A diagnostic no client console can show
+    void message(const QString& text);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onRunSlice();
+    void onDiagnostic(const QString& text);
+
+private:
+    void HandlePacket(const QByteArray& packet);
+    void SendPacket(const QByteArray& payload);
+    void Resume(bool singleStep, const QByteArray& address);
+    void ReportStop();
+    QByteArray StopReply() const;
+    QByteArray ReadRegister(int reg) const;
+    bool WriteRegister(int reg, uint32_t value);
+    QByteArray ReadMemory(const QByteArray& args) const;
+    QByteArray WriteMemory(const QByteArray& args, bool binary);
+    QByteArray SetPoint(const QByteArray& args, bool insert);
+    QByteArray TargetDescription() const;
+    QByteArray ReadFeature(const QByteArray& args) const;
+
+    Debugger* debugger;
+    QTcpServer* tcpServer = nullptr;
+    QLocalServer* localServer = nullptr;
+    QIODevice* client = nullptr;
+    QByteArray input;           // received bytes not yet parsed
+    QByteArray lastPacket;      // for a '-' retransmission request
+    bool noAck = false;
+    bool running = false;       // between a continue/step and its stop reply
+    bool interrupted = false;
+    bool singleStepping = false;
+    QString error;
+};
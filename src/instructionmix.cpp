@@ -0,0 +1,211 @@
+#include <QFile>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <algorithm>
+#include <iterator>
+#include "instructionmix.h"
+#include "analyzer.h"
+
+// Operation names: the GPU instruction set, then the operations of the DSP that replace GPU opcodes
+static const char* const OperationNames[InstructionMix::Operations] = {
+    "add", "addc", "addq", "addqt", "sub", "subc", "subq", "subqt",
+    "neg", "and", "or", "xor", "not", "btst", "bset", "bclr",
+    "mult", "imult", "imultn", "resmac", "imacn", "div", "abs", "sh",
+    "shlq", "shrq", "sha", "sharq", "ror", "rorq", "cmp", "cmpq",
+    "sat8", "sat16", "move", "moveq", "moveta", "movefa", "movei", "loadb",
+    "loadw", "load", "loadp", "load_r14n", "load_r15n", "storeb", "storew", "store",
+    "storep", "store_r14n", "store_r15n", "move_pc", "jump", "jr", "mmult", "mtoi",
+    "normi", "nop", "load_r14r", "load_r15r", "store_r14r", "store_r15r", "sat24", "pack",
+    "subqmod", "sat16s", "sat32s", "mirror", "addqmod", "imacn40", "resmac40", "illegal"
+};
+
+
+// The tables are allocated while a decode table is set
+void InstructionMix::setDecodeTable(const uint8_t* operations) {
+    decode = operations;
+    if (!operations) {
+        pairs = std::vector<uint64_t>();
+        words = std::vector<uint64_t>();
+        return;
+    }
+    pairs.assign((Operations + 1) * Operations, 0);
+    words.assign(2 << 16, 0);
+    previous = Operations;
+}
+
+
+// Forget what was recorded
+void InstructionMix::clear() {
+    std::fill(pairs.begin(), pairs.end(), 0);
+    std::fill(words.begin(), words.end(), 0);
+    previous = Operations;
+}
+
+
+// Decode the words counted into the histogram and the register counts, and sort the pairs
+void InstructionMix::tables(InstructionMixTables& out) const {
+    std::fill(std::begin(out.operations), std::end(out.operations), 0);
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int r = 0; r < 32; ++r)
+            out.reads[bank][r] = out.writes[bank][r] = out.moveta[bank][r] = out.movefa[bank][r] = 0;
+    }
+    out.pairs.clear();
+    out.instructions = 0;
+    if (!isEnabled())
+        return;
+
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int w = 0; w < 0x10000; ++w) {
+            uint64_t count = words[(bank << 16) | w];
+            if (!count)
+                continue;
+            int operation = decode[w >> 10];
+            int reg1 = (w >> 5) & 31;
+            int reg2 = w & 31;
+            out.operations[operation] += count;
+            out.instructions += count;
+            uint32_t reads, writes;
+            OperationRegisters(operation, reg1, reg2, reads, writes);
+            for (int r = 0; r < 32; ++r) {
+                if (reads & (1u << r))
+                    out.reads[bank][r] += count;
+                if (writes & (1u << r))
+                    out.writes[bank][r] += count;
+            }
+            if (operation == 36) { // moveta: reg2 of the other bank
+                out.moveta[bank ^ 1][reg2] += count;
+                out.writes[bank ^ 1][reg2] += count;
+            }
+            else if (operation == 37) { // movefa: reg1 of the other bank
+                out.movefa[bank ^ 1][reg1] += count;
+                out.reads[bank ^ 1][reg1] += count;
+            }
+        }
+    }
+
+    for (int first = 0; first < Operations; ++first) {
+        for (int second = 0; second < Operations; ++second) {
+            uint64_t count = pairs[first * Operations + second];
+            if (count)
+                out.pairs.push_back({ first, second, count });
+        }
+    }
+    std::stable_sort(out.pairs.begin(), out.pairs.end(), [](const OperationPair& a, const OperationPair& b) {
+        return a.count > b.count;
+    });
+}
+
+
+// Name of an operation, as the disassembler spells it
+const char* InstructionMix::operationName(int operation) {
+    return OperationNames[operation];
+}
+
+
+// Write the tables; operations and registers never used are left out
+bool InstructionMix::write(const QString& filename, int maxPairs) const {
+    InstructionMixTables t;
+    tables(t);
+    uint64_t pairTotal = 0;
+    for (const OperationPair& pair : t.pairs)
+        pairTotal += pair.count;
+    uint64_t moveta = 0, movefa = 0;
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int r = 0; r < 32; ++r) {
+            moveta += t.moveta[bank][r];
+            movefa += t.movefa[bank][r];
+        }
+    }
+    auto share = [](uint64_t count, uint64_t total) {
+        return total ? 100.0 * count / total : 0.0;
+    };
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(filename));
+    if (filename.endsWith(".json", Qt::CaseInsensitive)) {
+        QJsonObject operations;
+        for (int i = 0; i < Operations; ++i) {
+            if (t.operations[i])
+                operations[OperationNames[i]] = static_cast<double>(t.operations[i]);
+        }
+        QJsonArray pairList;
+        for (size_t i = 0; (i < t.pairs.size()) && (static_cast<int>(i) < maxPairs); ++i) {
+            QJsonObject pair;
+            pair["first"] = OperationNames[t.pairs[i].first];
+            pair["second"] = OperationNames[t.pairs[i].second];
+            pair["count"] = static_cast<double>(t.pairs[i].count);
+            pairList.append(pair);
+        }
+        QJsonArray registers;
+        for (int bank = 0; bank < 2; ++bank) {
+            for (int r = 0; r < 32; ++r) {
+                if (!t.reads[bank][r] && !t.writes[bank][r])
+                    continue;
+                QJsonObject reg;
+                reg["bank"] = bank;
+                reg["register"] = r;
+                reg["reads"] = static_cast<double>(t.reads[bank][r]);
+                reg["writes"] = static_cast<double>(t.writes[bank][r]);
+                reg["moveta"] = static_cast<double>(t.moveta[bank][r]);
+                reg["movefa"] = static_cast<double>(t.movefa[bank][r]);
+                registers.append(reg);
+            }
+        }
+        QJsonObject root;
+        root["instructions"] = static_cast<double>(t.instructions);
+        root["operations"] = operations;
+        root["pairs"] = pairList;
+        root["registers"] = registers;
+        root["moveta"] = static_cast<double>(moveta);
+        root["movefa"] = static_cast<double>(movefa);
+        file.write(QJsonDocument(root).toJson());
+    }
+    else {
+        QTextStream out(&file);
+        std::vector<int> order;
+        for (int i = 0; i < Operations; ++i) {
+            if (t.operations[i])
+                order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&t](int a, int b) { return t.operations[a] > t.operations[b]; });
+        out << "Instructions: " << t.instructions << "\n\n";
+        out << QString("%1 %2 %3\n").arg("Operation", -12).arg("Count", 14).arg("Share", 8);
+        for (int i : order) {
+            out << QString("%1 %2 %3%\n").arg(OperationNames[i], -12).arg(t.operations[i], 14)
+                   .arg(share(t.operations[i], t.instructions), 7, 'f', 2);
+        }
+        out << "\n" << QString("%1 %2 %3\n").arg("Pair", -24).arg("Count", 14).arg("Share", 8);
+        for (size_t i = 0; (i < t.pairs.size()) && (static_cast<int>(i) < maxPairs); ++i) {
+            const OperationPair& pair = t.pairs[i];
+            out << QString("%1 %2 %3%\n").arg(QString("%1 -> %2").arg(OperationNames[pair.first], OperationNames[pair.second]), -24)
+                   .arg(pair.count, 14).arg(share(pair.count, pairTotal), 7, 'f', 2);
+        }
+        if (static_cast<int>(t.pairs.size()) > maxPairs)
+            out << "... " << (static_cast<int>(t.pairs.size()) - maxPairs) << " more pairs\n";
+        for (int bank = 0; bank < 2; ++bank) {
+            out << "\n" << QString("%1 %2 %3 %4 %5\n").arg(QString("Bank %1").arg(bank), -8).arg("Reads", 14)
+                   .arg("Writes", 14).arg("moveta", 12).arg("movefa", 12);
+            for (int r = 0; r < 32; ++r) {
+                if (!t.reads[bank][r] && !t.writes[bank][r])
+                    continue;
+                out << QString("%1 %2 %3 %4 %5\n").arg(QString("r%1").arg(r), -8).arg(t.reads[bank][r], 14)
+                       .arg(t.writes[bank][r], 14).arg(t.moveta[bank][r], 12).arg(t.movefa[bank][r], 12);
+            }
+        }
+        out << "\nCross-bank transfers: " << moveta << " moveta, " << movefa << " movefa\n";
+        out.flush();
+    }
+    if (file.error() != QFile::NoError)
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// Record an error for errorString(); returns false
+bool InstructionMix::fail(const QString& message) const {
+    error = message;
+    return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+// Two operations executed one after the other
+struct OperationPair {
+    int first;
+    int second;
+    uint64_t count;
+};
+
+struct InstructionMixTables;
+
+// InstructionMix: executed operations, consecutive operation pairs and register traffic per bank, to find the
+// fusion and load-use patterns of kernels and the fast paths worth specializing in the interpreter. Recording
+// an instruction is two increments: the pair table, indexed by the previous and current operation, and one
+// counter per instruction word and bank, which the histogram and the register counts are derived from when
+// the tables are read.
+class InstructionMix {
+public:
+    static const int Operations = 72;       // OperationCount, the GPU opcodes then the DSP-only operations
+
+    // Allocate the tables for a core's decode table, nothing recorded; null frees them
+    void setDecodeTable(const uint8_t* operations);
+    bool isEnabled() const { return !words.empty(); }
+    void clear();
+    // The next instruction starts a new sequence, as after a reset
+    void restart() { previous = Operations; }
+
+    // Record an instruction word, of the given operation, executed in a register bank
+    void execute(uint16_t w, int operation, int bank) {
+        ++pairs[previous * Operations + operation];
+        previous = operation;
+        ++words[(bank << 16) | w];
+    }
+
+    void tables(InstructionMixTables& out) const;
+    static const char* operationName(int operation);
+
+    // JSON if the name ends with .json, text tables otherwise; at most 'maxPairs' pairs
+    bool write(const QString& filename, int maxPairs = 256) const;
+
+    QString errorString() const { return error; }
+
+private:
+    bool fail(const QString& message) const;
+
+    const uint8_t* decode = nullptr;
+    std::vector<uint64_t> pairs;    // (Operations + 1) rows; the last one is the start of a sequence
+    std::vector<uint64_t> words;    // bank << 16 | instruction word
+    int previous = Operations;
+    mutable QString error;
+};
+
+// Totals derived from the recorded tables; cross-bank accesses also count as reads and writes of the register
+struct InstructionMixTables {
+    uint64_t operations[InstructionMix::Operations];    // executed instructions per operation
+    std::vector<OperationPair> pairs;   // non-zero pairs, the most frequent first
+    uint64_t reads[2][32];              // per bank and register
+    uint64_t writes[2][32];
+    uint64_t moveta[2][32];             // writes by a moveta run in the other bank
+    uint64_t movefa[2][32];             // reads by a movefa run in the other bank
+    uint64_t instructions;
+};
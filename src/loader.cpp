@@ -0,0 +1,476 @@
+#include <QFile>
+#include <cstring>
+#include "loader.h"
+#include "debugger.h"
+
+// Read a big-endian word from the file image
+static inline uint32_t Peek16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+// Read a big-endian long from the file image
+static inline uint32_t Peek32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Read a word or a long following the ELF file byte order
+static inline uint32_t PeekELF16(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? Peek16(p) : (p[1] << 8) | p[0];
+}
+static inline uint32_t PeekELF32(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? Peek32(p) : (static_cast<uint32_t>(p[3]) << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+// Check that [offset, offset + length) lies inside the file
+static inline bool InFile(qint64 fileSize, qint64 offset, qint64 length) {
+    return (offset >= 0) && (length >= 0) && (offset + length <= fileSize);
+}
+
+
+// Load the file, detecting its format from the header
+bool ImageLoader::load(const QString& filename, int address) {
+    imageFormat = ImageFormat::Raw;
+    entry = address;
+    segmentTable.clear();
+    symbolTable.clear();
+    copies.clear();
+    fixups.clear();
+    error.clear();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail("Error while loading file.");
+
+    qint64 fileSize = file.size();
+    if (fileSize <= 0) {
+        file.close();
+        return fail("File is empty.");
+    }
+    if (fileSize > MemorySize) {
+        file.close();
+        return fail("File too large!");
+    }
+
+    // Map the file so segments are copied straight from the page cache into MemoryBuffer
+    QByteArray fallback;
+    const uint8_t* data = file.map(0, fileSize);
+    if (!data) {
+        fallback = file.readAll();
+        if (fallback.size() != fileSize) {
+            file.close();
+            return fail("Error while loading file.");
+        }
+        data = reinterpret_cast<const uint8_t*>(fallback.constData());
+    }
+
+    bool ok;
+    if ((fileSize >= 12) && (Peek32(data) == 0x42533934))                   // "BS94"
+        ok = loadBS94(data, fileSize);
+    else if ((fileSize >= 28) && ((Peek16(data) == 0x601A) || (Peek16(data) == 0x601B)))
+        ok = loadAlcyon(data, fileSize, address);
+    else if ((fileSize >= 20) && (Peek16(data) == 0x0150))                  // Motorola 68k COFF (Jaguar)
+        ok = loadCOFF(data, fileSize);
+    else if ((fileSize >= 52) && (Peek32(data) == 0x7F454C46))              // "\177ELF"
+        ok = loadELF(data, fileSize);
+    else
+        ok = loadRaw(data, fileSize, address);
+
+    // The mapping is still open: copy the segments only now that the whole file is known to be valid
+    if (ok)
+        Commit();
+    else {
+        segmentTable.clear();
+        symbolTable.clear();
+    }
+    copies.clear();
+    fixups.clear();
+    file.close();
+    return ok;
+}
+
+
+// Get a readable name for the detected format
+QString ImageLoader::formatName() const {
+    switch (imageFormat) {
+    case ImageFormat::Raw: return "raw binary";
+    case ImageFormat::BS94: return "BS94";
+    case ImageFormat::Alcyon: return "Alcyon";
+    case ImageFormat::AlcyonAbs: return "Jaguar ABS";
+    case ImageFormat::COFF: return "COFF";
+    case ImageFormat::ELF: return "ELF";
+    }
+    return "unknown";
+}
+
+
+// Raw binary: the whole file is a text segment at the requested address
+bool ImageLoader::loadRaw(const uint8_t* data, qint64 size, int address) {
+    imageFormat = ImageFormat::Raw;
+    entry = address;
+    return place("text", SegmentKind::Text, address, data, size, size);
+}
+
+
+// BS94: 12 bytes header ("BS94", load address, reserved) followed by the code
+bool ImageLoader::loadBS94(const uint8_t* data, qint64 size) {
+    imageFormat = ImageFormat::BS94;
+    entry = static_cast<int>(Peek32(data + 4));
+    return place("text", SegmentKind::Text, entry, data + 12, size - 12, size - 12);
+}
+
+
+// Alcyon/DRI objects
+// 0x601A: 28 bytes header, text/data placed contiguously at 'address' and relocated unless the absflag word
+//         at offset 26 is set, in which case the image was linked for 'address' and has no fixup stream
+// 0x601B: 36 bytes header produced by the Jaguar linkers, with absolute text/data/bss bases
+bool ImageLoader::loadAlcyon(const uint8_t* data, qint64 size, int address) {
+    bool absolute = (Peek16(data) == 0x601B);
+    int headerSize = absolute ? 36 : 28;
+    if (size < headerSize)
+        return fail("Truncated Alcyon header.");
+
+    qint64 tsize = Peek32(data + 2);
+    qint64 dsize = Peek32(data + 6);
+    qint64 bsize = Peek32(data + 10);
+    qint64 ssize = Peek32(data + 14);
+    if (!InFile(size, headerSize, tsize + dsize))
+        return fail("Truncated Alcyon object.");
+
+    int tbase, dbase, bbase;
+    if (absolute) {
+        imageFormat = ImageFormat::AlcyonAbs;
+        tbase = static_cast<int>(Peek32(data + 22));
+        dbase = static_cast<int>(Peek32(data + 28));
+        bbase = static_cast<int>(Peek32(data + 32));
+    }
+    else {
+        imageFormat = ImageFormat::Alcyon;
+        tbase = address;
+        dbase = static_cast<int>(tbase + tsize);
+        bbase = static_cast<int>(dbase + dsize);
+    }
+    entry = tbase;
+
+    const uint8_t* text = data + headerSize;
+    if ((tsize && !place("text", SegmentKind::Text, tbase, text, tsize, tsize)) ||
+        (dsize && !place("data", SegmentKind::Data, dbase, text + tsize, dsize, dsize)) ||
+        (bsize && !place("bss", SegmentKind::Bss, bbase, nullptr, 0, bsize)))
+        return false;
+
+    if (ssize && InFile(size, headerSize + tsize + dsize, ssize))
+        readDRISymbols(text + tsize + dsize, ssize, absolute ? 0 : tbase);
+
+    // Relocatable objects carry a TOS style fixup stream after the symbols; it is checked here and applied by Commit()
+    qint64 reloc = headerSize + tsize + dsize + ssize;
+    bool relocatable = !absolute && !Peek16(data + 26);
+    fixupBase = tbase;
+    if (relocatable && InFile(size, reloc, 4)) {
+        uint32_t offset = Peek32(data + reloc);
+        qint64 walk = reloc + 4;
+        while (offset != 0) {
+            int fix = tbase + static_cast<int>(offset);
+            if ((static_cast<qint64>(offset) + 4 > tsize + dsize) || (fix < 0) || (fix + 4 > MemorySize))
+                return fail("Invalid relocation in Alcyon object.");
+            fixups.push_back(fix);
+            // Each following byte is a distance to the next fixup, 1 skips 254 bytes, 0 ends the list
+            uint32_t step = 0;
+            while (step == 0 && walk < size) {
+                uint8_t b = data[walk++];
+                if (b == 0) break;
+                if (b == 1) offset += 254;
+                else step = b;
+            }
+            if (step == 0) break;
+            offset += step;
+        }
+    }
+    return true;
+}
+
+
+// Jaguar COFF: file header, optional a.out header and section headers, all big-endian
+bool ImageLoader::loadCOFF(const uint8_t* data, qint64 size) {
+    imageFormat = ImageFormat::COFF;
+    int nscns = Peek16(data + 2);
+    int opthdr = Peek16(data + 16);
+    if (!InFile(size, 20, opthdr + nscns * 40LL))
+        return fail("Truncated COFF header.");
+
+    bool hasEntry = (opthdr >= 28);
+    if (hasEntry)
+        entry = static_cast<int>(Peek32(data + 20 + 16));
+
+    std::vector<int> sectionKinds(nscns + 1, -1);           // COFF section numbers are 1-based
+    const uint8_t* sh = data + 20 + opthdr;
+    for (int i = 0; i < nscns; ++i, sh += 40) {
+        uint32_t flags = Peek32(sh + 36);
+        qint64 ssize = Peek32(sh + 16);
+        SegmentKind kind;
+        if (flags & 0x20) kind = SegmentKind::Text;
+        else if (flags & 0x40) kind = SegmentKind::Data;
+        else if (flags & 0x80) kind = SegmentKind::Bss;
+        else continue;                                      // comments, info and other non loadable sections
+        sectionKinds[i + 1] = static_cast<int>(kind);
+        if (ssize == 0)
+            continue;
+
+        char rawName[9] = {};
+        std::memcpy(rawName, sh, 8);
+        int paddr = static_cast<int>(Peek32(sh + 8));
+        qint64 scnptr = Peek32(sh + 20);
+        if (kind == SegmentKind::Bss) {
+            if (!place(rawName, kind, paddr, nullptr, 0, ssize))
+                return false;
+        }
+        else {
+            if (!InFile(size, scnptr, ssize))
+                return fail(QString("Truncated COFF section %1.").arg(rawName));
+            if (!place(rawName, kind, paddr, data + scnptr, ssize, ssize))
+                return false;
+        }
+        if (!hasEntry && (kind == SegmentKind::Text)) {
+            entry = paddr;
+            hasEntry = true;
+        }
+    }
+    readCOFFSymbols(data, size, sectionKinds);
+    return true;
+}
+
+
+// ELF32: allocated sections when section headers exist, PT_LOAD program headers otherwise
+bool ImageLoader::loadELF(const uint8_t* data, qint64 size) {
+    imageFormat = ImageFormat::ELF;
+    if (data[4] != 1)
+        return fail("Only 32-bit ELF files are supported.");
+    bool be = (data[5] == 2);
+
+    uint32_t eEntry = PeekELF32(data + 24, be);
+    qint64 phoff = PeekELF32(data + 28, be);
+    qint64 shoff = PeekELF32(data + 32, be);
+    int phentsize = PeekELF16(data + 42, be);
+    int phnum = PeekELF16(data + 44, be);
+    int shentsize = PeekELF16(data + 46, be);
+    int shnum = PeekELF16(data + 48, be);
+    int shstrndx = PeekELF16(data + 50, be);
+    bool hasEntry = (eEntry != 0);
+    entry = static_cast<int>(eEntry);
+
+    if (shoff && shnum && (shentsize >= 40) && InFile(size, shoff, static_cast<qint64>(shnum) * shentsize)) {
+        const uint8_t* strtab = nullptr;
+        qint64 strsize = 0;
+        if (shstrndx < shnum) {
+            const uint8_t* ssh = data + shoff + shstrndx * shentsize;
+            qint64 off = PeekELF32(ssh + 16, be);
+            strsize = PeekELF32(ssh + 20, be);
+            if (InFile(size, off, strsize))
+                strtab = data + off;
+        }
+        std::vector<int> sectionKinds(shnum, -1);
+        for (int i = 0; i < shnum; ++i) {
+            const uint8_t* sh = data + shoff + i * shentsize;
+            uint32_t type = PeekELF32(sh + 4, be);
+            uint32_t flags = PeekELF32(sh + 8, be);
+            int addr = static_cast<int>(PeekELF32(sh + 12, be));
+            qint64 off = PeekELF32(sh + 16, be);
+            qint64 ssize = PeekELF32(sh + 20, be);
+            if (!(flags & 0x2))                             // SHF_ALLOC
+                continue;
+            sectionKinds[i] = static_cast<int>((type == 8) ? SegmentKind::Bss
+                : (flags & 0x4) ? SegmentKind::Text : SegmentKind::Data);
+            if (ssize == 0)
+                continue;
+            uint32_t nameOff = PeekELF32(sh, be);
+            QString name = (strtab && nameOff < strsize)
+                ? QString::fromLatin1(reinterpret_cast<const char*>(strtab + nameOff),
+                      static_cast<int>(strnlen(reinterpret_cast<const char*>(strtab + nameOff), strsize - nameOff)))
+                : QString("section%1").arg(i);
+            if (name.startsWith('.'))
+                name.remove(0, 1);
+            SegmentKind kind = (type == 8) ? SegmentKind::Bss                   // SHT_NOBITS
+                : (flags & 0x4) ? SegmentKind::Text : SegmentKind::Data;        // SHF_EXECINSTR
+            if (kind == SegmentKind::Bss) {
+                if (!place(name, kind, addr, nullptr, 0, ssize))
+                    return false;
+            }
+            else {
+                if (!InFile(size, off, ssize))
+                    return fail(QString("Truncated ELF section %1.").arg(name));
+                if (!place(name, kind, addr, data + off, ssize, ssize))
+                    return false;
+            }
+            if (!hasEntry && (kind == SegmentKind::Text)) {
+                entry = addr;
+                hasEntry = true;
+            }
+        }
+        if (!segmentTable.empty()) {
+            readELFSymbols(data, size, shoff, shnum, shentsize, be, sectionKinds);
+            return true;
+        }
+    }
+
+    if (!phoff || !phnum || (phentsize < 32) || !InFile(size, phoff, static_cast<qint64>(phnum) * phentsize))
+        return fail("ELF file has no loadable content.");
+    for (int i = 0; i < phnum; ++i) {
+        const uint8_t* ph = data + phoff + i * phentsize;
+        if (PeekELF32(ph, be) != 1)                                             // PT_LOAD
+            continue;
+        qint64 off = PeekELF32(ph + 4, be);
+        int paddr = static_cast<int>(PeekELF32(ph + 12, be));
+        qint64 filesz = PeekELF32(ph + 16, be);
+        qint64 memsz = PeekELF32(ph + 20, be);
+        bool exec = (PeekELF32(ph + 24, be) & 0x1) != 0;                        // PF_X
+        if (!InFile(size, off, filesz) || (memsz < filesz))
+            return fail("Invalid ELF program header.");
+        if (filesz && !place(exec ? "text" : "data", exec ? SegmentKind::Text : SegmentKind::Data,
+                             paddr, data + off, filesz, filesz))
+            return false;
+        if ((memsz > filesz) && !place("bss", SegmentKind::Bss, static_cast<int>(paddr + filesz), nullptr, 0, memsz - filesz))
+            return false;
+        if (!hasEntry && exec) {
+            entry = paddr;
+            hasEntry = true;
+        }
+    }
+    return true;
+}
+
+
+// DRI symbols: 14 bytes entries (name[8], type, value); GST extended names continue in the next entry
+void ImageLoader::readDRISymbols(const uint8_t* table, qint64 size, int base) {
+    for (qint64 i = 0; i + 14 <= size; i += 14) {
+        const uint8_t* e = table + i;
+        uint32_t type = Peek16(e + 8);
+        int value = static_cast<int>(Peek32(e + 10));
+        QString name = QString::fromLatin1(reinterpret_cast<const char*>(e), static_cast<int>(strnlen(reinterpret_cast<const char*>(e), 8)));
+        if (((type & 0x0048) == 0x0048) && (i + 28 <= size)) {
+            i += 14;
+            name += QString::fromLatin1(reinterpret_cast<const char*>(table + i), static_cast<int>(strnlen(reinterpret_cast<const char*>(table + i), 14)));
+        }
+        if (!(type & 0x8000) || (type & 0x0800) || (type & 0x1000))    // undefined, external or register equate
+            continue;
+        bool absolute = (type & 0x4000) || !(type & 0x0700);
+        SegmentKind section = (type & 0x0200) ? SegmentKind::Text : (type & 0x0400) ? SegmentKind::Data : SegmentKind::Bss;
+        symbolTable.push_back({ name, absolute ? value : value + base, 0, section, absolute, (type & 0x2000) != 0 });
+    }
+}
+
+
+// COFF symbols: 18 bytes entries after f_symptr, long names in the string table that follows them
+void ImageLoader::readCOFFSymbols(const uint8_t* data, qint64 size, const std::vector<int>& sectionKinds) {
+    qint64 symptr = Peek32(data + 8);
+    qint64 nsyms = Peek32(data + 12);
+    if (!symptr || !InFile(size, symptr, nsyms * 18))
+        return;
+    qint64 strtab = symptr + nsyms * 18;
+    qint64 strsize = InFile(size, strtab, 4) ? Peek32(data + strtab) : 0;
+    if (!InFile(size, strtab, strsize))
+        strsize = 0;
+
+    for (qint64 i = 0; i < nsyms; ++i) {
+        const uint8_t* e = data + symptr + i * 18;
+        int scnum = static_cast<int16_t>(Peek16(e + 12));
+        int sclass = e[16];
+        int numaux = e[17];
+        QString name;
+        if (Peek32(e) == 0) {
+            qint64 off = Peek32(e + 4);
+            if (off >= 4 && off < strsize)
+                name = QString::fromLatin1(reinterpret_cast<const char*>(data + strtab + off),
+                    static_cast<int>(strnlen(reinterpret_cast<const char*>(data + strtab + off), strsize - off)));
+        }
+        else {
+            name = QString::fromLatin1(reinterpret_cast<const char*>(e), static_cast<int>(strnlen(reinterpret_cast<const char*>(e), 8)));
+        }
+        i += numaux;
+        // External, static and label storage classes only; section names start with a dot
+        if (((sclass != 2) && (sclass != 3) && (sclass != 6)) || name.isEmpty() || name.startsWith('.'))
+            continue;
+        int value = static_cast<int>(Peek32(e + 8));
+        bool global = (sclass == 2);                                // C_EXT
+        if (scnum == -1)
+            symbolTable.push_back({ name, value, 0, SegmentKind::Data, true, global });
+        else if ((scnum > 0) && (scnum < static_cast<int>(sectionKinds.size())) && (sectionKinds[scnum] >= 0))
+            symbolTable.push_back({ name, value, 0, static_cast<SegmentKind>(sectionKinds[scnum]), false, global });
+    }
+}
+
+
+// ELF symbols from every SHT_SYMTAB section, names in the linked string table
+void ImageLoader::readELFSymbols(const uint8_t* data, qint64 size, qint64 shoff, int shnum, int shentsize, bool be,
+                                 const std::vector<int>& sectionKinds) {
+    for (int i = 0; i < shnum; ++i) {
+        const uint8_t* sh = data + shoff + i * shentsize;
+        if (PeekELF32(sh + 4, be) != 2)                                 // SHT_SYMTAB
+            continue;
+        qint64 off = PeekELF32(sh + 16, be);
+        qint64 tsize = PeekELF32(sh + 20, be);
+        uint32_t link = PeekELF32(sh + 24, be);
+        if (!InFile(size, off, tsize) || (link >= static_cast<uint32_t>(shnum)))
+            continue;
+        const uint8_t* strsh = data + shoff + link * shentsize;
+        qint64 stroff = PeekELF32(strsh + 16, be);
+        qint64 strsize = PeekELF32(strsh + 20, be);
+        if (!InFile(size, stroff, strsize))
+            continue;
+
+        for (qint64 e = 16; e + 16 <= tsize; e += 16) {                 // entry 0 is the null symbol
+            const uint8_t* sym = data + off + e;
+            uint32_t nameOff = PeekELF32(sym, be);
+            int value = static_cast<int>(PeekELF32(sym + 4, be));
+            int ssize = static_cast<int>(PeekELF32(sym + 8, be));
+            int type = sym[12] & 0xF;
+            bool global = ((sym[12] >> 4) == 1) || ((sym[12] >> 4) == 2);  // STB_GLOBAL, STB_WEAK
+            int shndx = PeekELF16(sym + 14, be);
+            if ((type == 3) || (type == 4) || (shndx == 0) || (nameOff == 0) || (nameOff >= strsize))
+                continue;                                               // section and file symbols, undefined
+            QString name = QString::fromLatin1(reinterpret_cast<const char*>(data + stroff + nameOff),
+                static_cast<int>(strnlen(reinterpret_cast<const char*>(data + stroff + nameOff), strsize - nameOff)));
+            if (name.isEmpty() || name.startsWith('$'))                  // mapping symbols
+                continue;
+            if (shndx == 0xFFF1)                                        // SHN_ABS
+                symbolTable.push_back({ name, value, ssize, SegmentKind::Data, true, global });
+            else if ((shndx < static_cast<int>(sectionKinds.size())) && (sectionKinds[shndx] >= 0))
+                symbolTable.push_back({ name, value, ssize, static_cast<SegmentKind>(sectionKinds[shndx]), false, global });
+        }
+    }
+}
+
+
+// Check that a segment fits in MemoryBuffer and record it; the copy is left to Commit()
+bool ImageLoader::place(const QString& name, SegmentKind kind, int address, const uint8_t* src, qint64 srcSize, qint64 memSize) {
+    if ((address < 0) || (memSize > MemorySize) || (address + memSize > MemorySize))
+        return fail(QString("Segment %1 at $%2 does not fit in memory.")
+                    .arg(name).arg(QString::number(static_cast<uint32_t>(address), 16).toUpper().rightJustified(8, '0')));
+    copies.push_back({ address, src, srcSize, memSize });
+    segmentTable.push_back({ name, kind, address, static_cast<int>(memSize) });
+    return true;
+}
+
+
+// Copy the segments into MemoryBuffer, zero-fill what the file does not provide, then apply the fixups
+void ImageLoader::Commit() {
+    for (const Copy& c : copies) {
+        uint8_t* dst = MemoryBuffer.data() + c.address;
+        if (c.srcSize > 0)
+            std::memcpy(dst, c.src, c.srcSize);
+        if (c.memSize > c.srcSize)
+            std::memset(dst + c.srcSize, 0, c.memSize - c.srcSize);
+    }
+    for (int fix : fixups) {
+        uint8_t* p = MemoryBuffer.data() + fix;
+        uint32_t value = Peek32(p) + static_cast<uint32_t>(fixupBase);
+        p[0] = value >> 24;
+        p[1] = (value >> 16) & 0xFF;
+        p[2] = (value >> 8) & 0xFF;
+        p[3] = value & 0xFF;
+    }
+}
+
+
+// Record an error message
+bool ImageLoader::fail(const QString& message) {
+    error = message;
+    return false;
+}
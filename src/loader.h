@@ -0,0 +1,79 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+// Kind of memory area described by a segment
+enum class SegmentKind { Text, Data, Bss };
+
+// A contiguous area placed in MemoryBuffer by the loader
+struct Segment {
+    QString name;
+    SegmentKind kind;
+    int address;
+    int size;
+
+    bool contains(int adrs) const { return (adrs >= address) && (adrs < address + size); }
+};
+
+// A symbol read from the object file symbol table
+struct ImportedSymbol {
+    QString name;
+    int address;
+    int size;
+    SegmentKind section;
+    bool absolute;
+    bool global;        // visible to other modules, as opposed to a local label
+};
+
+// Executable formats recognized by the loader
+enum class ImageFormat { Raw, BS94, Alcyon, AlcyonAbs, COFF, ELF };
+
+// ImageLoader: memory-maps an executable and places its segments directly into MemoryBuffer.
+// Every segment and relocation is checked before the first byte is copied, so a file that fails to load
+// leaves memory untouched. Symbol tables of the object formats are extracted for the symbol engine.
+// Supports raw binaries, BS94 headers, Alcyon/DRI (0x601A) and absolute (0x601B) objects,
+// Jaguar COFF objects and 32-bit ELF files.
+class ImageLoader {
+public:
+    // Load the file; 'address' is used for formats without their own placement (raw, 0x601A)
+    bool load(const QString& filename, int address);
+
+    ImageFormat format() const { return imageFormat; }
+    QString formatName() const;
+    int entryPoint() const { return entry; }
+    const std::vector<Segment>& segments() const { return segmentTable; }
+    const std::vector<ImportedSymbol>& symbols() const { return symbolTable; }
+    QString errorString() const { return error; }
+
+private:
+    bool loadRaw(const uint8_t* data, qint64 size, int address);
+    bool loadBS94(const uint8_t* data, qint64 size);
+    bool loadAlcyon(const uint8_t* data, qint64 size, int address);
+    bool loadCOFF(const uint8_t* data, qint64 size);
+    bool loadELF(const uint8_t* data, qint64 size);
+    void readDRISymbols(const uint8_t* table, qint64 size, int base);
+    void readCOFFSymbols(const uint8_t* data, qint64 size, const std::vector<int>& sectionKinds);
+    void readELFSymbols(const uint8_t* data, qint64 size, qint64 shoff, int shnum, int shentsize, bool be,
+                        const std::vector<int>& sectionKinds);
+    bool place(const QString& name, SegmentKind kind, int address, const uint8_t* src, qint64 srcSize, qint64 memSize);
+    void Commit();
+    bool fail(const QString& message);
+
+    // A segment validated by place(), copied by Commit() from the mapped file
+    struct Copy {
+        int address;
+        const uint8_t* src;
+        qint64 srcSize;
+        qint64 memSize;
+    };
+
+    ImageFormat imageFormat = ImageFormat::Raw;
+    int entry = 0;
+    std::vector<Segment> segmentTable;
+    std::vector<ImportedSymbol> symbolTable;
+    std::vector<Copy> copies;
+    std::vector<int> fixups;            // addresses of the longs relocated by 'fixupBase'
+    int fixupBase = 0;
+    QString error;
+};
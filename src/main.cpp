@@ -1,13 +1,104 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
 #include "version.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
+    QApplication::setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Atari Jaguar RISC Simulator/Debugger");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption gdbOption("gdb", "Start a GDB remote protocol server on <address>: a port, host:port, or unix:<name> for a local socket.", "address");
+    QCommandLineOption metricsOption("metrics", "Serve the performance counters over HTTP on <address> (port or host:port): /metrics (Prometheus) and /metrics.json.", "address");
+    QCommandLineOption metricsFileOption("metrics-file", "Write the performance counters to <file> on exit, as JSON if it ends with .json, Prometheus text otherwise.", "file");
+    QCommandLineOption stateOption("state", "Restore the machine state saved in <file> at startup.", "file");
+    QCommandLineOption shadowOption("shadow", "Report reads of uninitialized memory and overruns of the declared buffers.");
+    QCommandLineOption coverageOption("coverage", "Record coverage, merged with the bitmaps in <file> if it exists, and save them there on exit.", "file");
+    QCommandLineOption lcovOption("coverage-lcov", "Record coverage and write it as an lcov tracefile to <file> on exit, with the listing beside it.", "file");
+    QCommandLineOption profileOption("profile", "Profile the calls and write the profile to <file> on exit: a Chrome trace if it ends with .json, collapsed stacks for flame graphs if .folded, a per-function report otherwise.", "file");
+    QCommandLineOption callIdiomsOption("call-idioms", "Call and return idioms of the profiler, as <symbols,link,window=N> (default: all, window=16).", "spec");
+    QCommandLineOption mixOption("mix", "Count the operations, consecutive operation pairs and register reads and writes, and write the tables to <file> on exit, as JSON if it ends with .json, text otherwise.", "file");
+    QCommandLineOption audioOption("audio", "Stream the writes to the I2S DAC registers to the WAV <file> until exit.", "file");
+    QCommandLineOption audioRateOption("audio-rate", "Resample the audio capture to <rate> Hz; 0 keeps the I2S frame rate set by SCLK (default).", "rate", "0");
+    QCommandLineOption audioClockOption("audio-clock", "Time the audio frames by the I2S frame clock (cycles, default) or one per write to the right channel (writes).", "clock", "cycles");
+    QCommandLineOption bufferOption("buffer", "Declare a buffer for the overrun check, as <address:length[:name]> (hex address); repeatable.", "spec");
+    QCommandLineOption interruptOption("interrupt", "Raise an interrupt source of the selected core at a cycle, as <source@cycle[/period]>, again every period cycles if given; repeatable.", "spec");
+    QCommandLineOption hookOption("hook", "Run a built-in native handler in place of a routine, as <target:fill|copy|sqrt:arguments[:cycles[:link]]>; repeatable.", "spec");
+    QCommandLineOption diffOption("diff", "Print the differences between two state files given as two --diff options, or between one and the state after --state, then exit: 0 if they match, 1 if not.", "file");
+    QCommandLineOption noIdleSkipOption("no-idle-skip", "Run every iteration of idle polling loops instead of fast-forwarding them.");
+    parser.addOption(gdbOption);
+    parser.addOption(metricsOption);
+    parser.addOption(metricsFileOption);
+    parser.addOption(stateOption);
+    parser.addOption(shadowOption);
+    parser.addOption(bufferOption);
+    parser.addOption(interruptOption);
+    parser.addOption(hookOption);
+    parser.addOption(noIdleSkipOption);
+    parser.addOption(diffOption);
+    parser.addOption(coverageOption);
+    parser.addOption(lcovOption);
+    parser.addOption(profileOption);
+    parser.addOption(callIdiomsOption);
+    parser.addOption(mixOption);
+    parser.addOption(audioOption);
+    parser.addOption(audioRateOption);
+    parser.addOption(audioClockOption);
+    parser.process(app);
+
     MainWindow w;
     w.setWindowTitle(QString("Atari Jaguar RISC Simulator/Debugger  -  v%1 (%2)").arg(APP_VERSION).arg(APP_BUILD_DATE));
+    for (const QString &spec : parser.values(bufferOption))
+        w.addShadowBuffer(spec);
+    if (parser.isSet(shadowOption) || parser.isSet(bufferOption))
+        w.setShadowCheck(true);
+    w.setIdleSkip(!parser.isSet(noIdleSkipOption));
+    for (const QString &spec : parser.values(hookOption))
+        w.addHook(spec);
+    if (parser.isSet(stateOption))
+        w.loadState(parser.value(stateOption));
+    // After the state: its core decides which interrupt sources exist
+    for (const QString &spec : parser.values(interruptOption))
+        w.scheduleInterrupt(spec);
+    if (parser.isSet(diffOption)) {
+        QStringList files = parser.values(diffOption);
+        return w.diffStates(files[0], files.value(1));
+    }
+    if (parser.isSet(coverageOption) || parser.isSet(lcovOption))
+        w.setCoverage(true);
+    if (parser.isSet(coverageOption) && QFile::exists(parser.value(coverageOption)))
+        w.mergeCoverage(parser.value(coverageOption));
+    if (parser.isSet(callIdiomsOption))
+        w.setCallIdioms(parser.value(callIdiomsOption));
+    if (parser.isSet(profileOption))
+        w.setProfiler(true);
+    if (parser.isSet(mixOption))
+        w.setInstructionMix(true);
+    if (parser.isSet(audioOption))
+        w.startAudioCapture(parser.value(audioOption), parser.value(audioRateOption).toInt(), parser.value(audioClockOption));
+    if (parser.isSet(gdbOption))
+        w.startGdbServer(parser.value(gdbOption));
+    if (parser.isSet(metricsOption))
+        w.startMetricsServer(parser.value(metricsOption));
     w.show();
 
-    return app.exec();
+    int result = app.exec();
+    if (parser.isSet(metricsFileOption))
+        w.writeMetrics(parser.value(metricsFileOption));
+    if (parser.isSet(coverageOption))
+        w.writeCoverage(parser.value(coverageOption), CoverageFormat::Bitmaps);
+    if (parser.isSet(lcovOption))
+        w.writeCoverage(parser.value(lcovOption), CoverageFormat::Lcov);
+    if (parser.isSet(profileOption))
+        w.writeProfile(parser.value(profileOption));
+    if (parser.isSet(mixOption))
+        w.writeInstructionMix(parser.value(mixOption));
+    if (parser.isSet(audioOption))
+        w.stopAudioCapture();
+    return result;
 }
@@ -15,6 +15,18 @@
 #include <QEvent>
 #include <QListView> // Include QListView
 #include <QKeyEvent> // Include QKeyEvent
+#include <QStatusBar>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QTimer>
+#include <QTabWidget>
+#include <QTableView>
+#include <QFontDatabase>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
 
 // MainWindow constructor: sets up the UI and initializes the display
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
@@ -28,6 +40,198 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 // Destructor (no special cleanup needed)
 MainWindow::~MainWindow() {}
 
+// Start the GDB remote protocol server; the UI refreshes whenever the remote target stops
+bool MainWindow::startGdbServer(const QString &address) {
+    if (!gdbServer) {
+        gdbServer = new GdbServer(&debugger, this);
+        connect(gdbServer, &GdbServer::stopped, this, &MainWindow::updateUI);
+        connect(gdbServer, &GdbServer::message, this, [this](const QString &text) { statusBar()->showMessage(text, 5000); });
+    }
+    if (!gdbServer->listen(address)) {
+        QMessageBox::critical(this, "Error", QString("GDB server: %1").arg(gdbServer->errorString()));
+        return false;
+    }
+    statusBar()->showMessage(QString("GDB server listening on %1").arg(address));
+    return true;
+}
+
+// Start the HTTP endpoint serving the performance counters
+bool MainWindow::startMetricsServer(const QString &address) {
+    if (!metricsServer)
+        metricsServer = new MetricsServer(&debugger, this);
+    if (!metricsServer->listen(address)) {
+        QMessageBox::critical(this, "Error", QString("Metrics server: %1").arg(metricsServer->errorString()));
+        return false;
+    }
+    return true;
+}
+
+// Write the performance counters to a JSON or Prometheus text file
+bool MainWindow::writeMetrics(const QString &filename) {
+    stopBackgroundRun();
+    return MetricsServer::writeFile(&debugger, filename);
+}
+
+// Restores a machine state file, selects its core and refreshes the views
+bool MainWindow::loadState(const QString &filename) {
+    if (gdbServer && gdbServer->isRunning())
+        return false; // The remote client owns the target until it stops
+    if (paceTimer->isActive())
+        stopPacedRun();
+    stopBackgroundRun();
+    if (!debugger.loadState(filename))
+        return false;
+    gpuMode->setChecked(debugger.isGPUMode());
+    dspMode->setChecked(!debugger.isGPUMode());
+    memoryModel->resync();
+    updateAnalysis();
+    updateUI();
+    return true;
+}
+
+// Compares two states, or a state file with the live machine, and prints the report
+int MainWindow::diffStates(const QString &before, const QString &after) {
+    stopBackgroundRun();
+    MachineSnapshot a, b;
+    if (!debugger.loadSnapshot(before, a))
+        return 2;
+    if (after.isEmpty())
+        debugger.captureSnapshot(b);
+    else if (!debugger.loadSnapshot(after, b))
+        return 2;
+    StateDiff diff;
+    diff.compare(a, b);
+    QTextStream out(stdout);
+    for (const QString &line : diff.report(a))
+        out << line << "\n";
+    return diff.isEmpty() ? 0 : 1;
+}
+
+// Turns the shadow memory check on or off through its checkbox
+void MainWindow::setShadowCheck(bool enabled) {
+    shadowCheck->setChecked(enabled); // toggled() runs onShadowCheckToggled()
+}
+
+// Turns coverage recording on or off through its checkbox
+void MainWindow::setCoverage(bool enabled) {
+    coverageCheck->setChecked(enabled); // toggled() runs onCoverageToggled()
+}
+
+// Merges the coverage bitmaps saved by an earlier run
+bool MainWindow::mergeCoverage(const QString &filename) {
+    stopBackgroundRun();
+    if (!debugger.mergeCoverage(filename))
+        return false;
+    updateUI();
+    return true;
+}
+
+// Writes the coverage bitmaps (.jcov) or an lcov tracefile
+bool MainWindow::writeCoverage(const QString &filename, CoverageFormat format) {
+    stopBackgroundRun();
+    return debugger.writeCoverage(filename, format);
+}
+
+// Turns the call profiler on or off through its checkbox
+void MainWindow::setProfiler(bool enabled) {
+    profilerCheck->setChecked(enabled); // toggled() runs onProfilerToggled()
+}
+
+// Sets the call and return idioms of the profiler, from the command line
+bool MainWindow::setCallIdioms(const QString &spec) {
+    CallIdioms idioms;
+    QString error;
+    if (!idioms.parse(spec, &error)) {
+        QMessageBox::critical(this, "Error", error);
+        return false;
+    }
+    debugger.setCallIdioms(idioms);
+    return true;
+}
+
+// Writes the call profile in the format given by the file name
+bool MainWindow::writeProfile(const QString &filename) {
+    stopBackgroundRun();
+    return debugger.writeProfile(filename);
+}
+
+// Turns the instruction mix on or off through its checkbox
+void MainWindow::setInstructionMix(bool enabled) {
+    mixCheck->setChecked(enabled); // toggled() runs onInstructionMixToggled()
+}
+
+// Writes the instruction mix tables
+bool MainWindow::writeInstructionMix(const QString &filename) {
+    stopBackgroundRun();
+    return debugger.writeInstructionMix(filename);
+}
+
+// Starts the audio capture, from the command line or the Capture audio button
+bool MainWindow::startAudioCapture(const QString &filename, int rate, const QString &clock) {
+    if ((clock != "cycles") && (clock != "writes")) {
+        QMessageBox::critical(this, "Error", QString("Audio clock \"%1\": expected cycles or writes").arg(clock));
+        return false;
+    }
+    stopBackgroundRun();
+    bool ok = debugger.startAudioCapture(filename, rate, (clock == "writes") ? AudioClock::Writes : AudioClock::Cycles);
+    updateUI();
+    return ok;
+}
+
+// Completes the WAV file of the audio capture
+bool MainWindow::stopAudioCapture() {
+    stopBackgroundRun();
+    bool ok = debugger.stopAudioCapture();
+    updateUI();
+    return ok;
+}
+
+// Declares a buffer for the overrun check, from the command line
+bool MainWindow::addShadowBuffer(const QString &spec) {
+    QStringList parts = spec.split(':');
+    bool okAddress = false, okLength = false;
+    int address = (parts.size() >= 2) ? parts[0].trimmed().remove('$').toInt(&okAddress, 16) : 0;
+    int length = (parts.size() >= 2) ? parts[1].trimmed().toInt(&okLength, 0) : 0;
+    if (!okAddress || !okLength || (length <= 0)) {
+        QMessageBox::critical(this, "Error", QString("Buffer \"%1\": expected address:length[:name]").arg(spec));
+        return false;
+    }
+    QString name = (parts.size() >= 3) ? parts.mid(2).join(':') : QString("$%1").arg(address, 8, 16, QChar('0')).toUpper();
+    debugger.addShadowBuffer(address, length, name);
+    return true;
+}
+
+// Schedules an interrupt from "source@cycle[/period]"
+bool MainWindow::scheduleInterrupt(const QString &spec) {
+    QStringList parts = spec.split('@');
+    QStringList timing = (parts.size() == 2) ? parts[1].split('/') : QStringList();
+    bool okSource = false, okCycle = false, okPeriod = true;
+    int source = (parts.size() == 2) ? parts[0].trimmed().toInt(&okSource) : 0;
+    qulonglong cycle = !timing.isEmpty() ? timing[0].trimmed().toULongLong(&okCycle) : 0;
+    qulonglong period = (timing.size() == 2) ? timing[1].trimmed().toULongLong(&okPeriod) : 0;
+    if (!okSource || !okCycle || !okPeriod || (timing.size() > 2)) {
+        QMessageBox::critical(this, "Error", QString("Interrupt \"%1\": expected source@cycle[/period]").arg(spec));
+        return false;
+    }
+    return debugger.scheduleInterrupt(source, cycle, period);
+}
+
+// Turns the fast-forwarding of idle polling loops on or off
+void MainWindow::setIdleSkip(bool enabled) {
+    debugger.setIdleSkip(enabled);
+}
+
+// Replaces a routine by a built-in native handler
+bool MainWindow::addHook(const QString &spec) {
+    NativeHook hook;
+    QString error;
+    if (!ParseHook(spec, hook, error)) {
+        QMessageBox::critical(this, "Error", error);
+        return false;
+    }
+    return debugger.addHook(hook);
+}
+
 // Sets up the UI layout and connects signals to slots
 void MainWindow::setupUI() {
     QWidget *central = new QWidget(this);
@@ -77,8 +281,66 @@ void MainWindow::setupUI() {
     codeView = new QTreeWidget;
     codeView->setColumnCount(4); // Four sub-columns
     codeView->setHeaderHidden(true); // Hide header for no visual separation
+
+    // Loop/cycle panel of the static analysis
+    QWidget *loopsPage = new QWidget;
+    QVBoxLayout *loopsLayout = new QVBoxLayout(loopsPage);
+    loopView = new QTreeWidget;
+    loopView->setColumnCount(6);
+    loopView->setHeaderLabels(QStringList() << "Loop / block" << "Address" << "Instructions" << "Cycles" << "Stalls" << "Bus");
+    saveReportBtn = new QPushButton("Save report...");
+    loopsLayout->addWidget(loopView);
+    loopsLayout->addWidget(saveReportBtn);
+
+    // Memory view over the whole address space; only the visible rows are read
+    QWidget *memoryPage = new QWidget;
+    QVBoxLayout *memoryLayout = new QVBoxLayout(memoryPage);
+    QHBoxLayout *memoryBar = new QHBoxLayout;
+    memoryFormat = new QComboBox;
+    memoryFormat->addItem("Bytes");
+    memoryFormat->addItem("Words");
+    memoryFormat->addItem("Longs");
+    memoryFormat->addItem("Fixed 16.16");
+    memoryGoTo = new QLineEdit;
+    memoryGoTo->setPlaceholderText("Go to: $F03000, r12, 1:r3, symbol+$10");
+    memoryBar->addWidget(memoryFormat);
+    memoryBar->addWidget(memoryGoTo, 1);
+    memoryModel = new MemoryModel(&debugger, this);
+    memoryView = new QTableView;
+    memoryView->setModel(memoryModel);
+    memoryView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    memoryView->verticalHeader()->hide();
+    memoryView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    memoryView->verticalHeader()->setDefaultSectionSize(memoryView->fontMetrics().height() + 4);
+    memoryView->setShowGrid(false);
+    memoryView->setWordWrap(false);
+    memoryView->resizeColumnsToContents();
+    memoryLayout->addLayout(memoryBar);
+    memoryLayout->addWidget(memoryView);
+
+    // Operations, consecutive operation pairs and register traffic of the instructions run
+    mixPage = new QWidget;
+    QVBoxLayout *mixLayout = new QVBoxLayout(mixPage);
+    QHBoxLayout *mixBar = new QHBoxLayout;
+    mixCheck = new QCheckBox("Record instruction mix");
+    mixCheck->setToolTip("Count the operations run, the pairs of consecutive operations and the register reads and writes per bank");
+    exportMixBtn = new QPushButton("Export mix...");
+    mixBar->addWidget(mixCheck);
+    mixBar->addStretch();
+    mixBar->addWidget(exportMixBtn);
+    mixView = new QTreeWidget;
+    mixView->setColumnCount(5);
+    mixView->setHeaderHidden(true); // Each table has its own column titles
+    mixLayout->addLayout(mixBar);
+    mixLayout->addWidget(mixView);
+
+    centerTabs = new QTabWidget;
+    centerTabs->addTab(codeView, "Code");
+    centerTabs->addTab(loopsPage, "Loops / Cycles");
+    centerTabs->addTab(memoryPage, "Memory");
+    centerTabs->addTab(mixPage, "Instruction mix");
     centerLayout->addWidget(codeLabel);
-    centerLayout->addWidget(codeView);
+    centerLayout->addWidget(centerTabs);
 
     // --- Right: Controls and status ---
     QVBoxLayout *rightLayout = new QVBoxLayout;
@@ -91,6 +353,11 @@ void MainWindow::setupUI() {
     rightLayout->addWidget(dspMode);
 
     loadBinBtn = new QPushButton("Load BIN");
+    loadSymBtn = new QPushButton("Load symbols");
+    saveStateBtn = new QPushButton("Save state...");
+    loadStateBtn = new QPushButton("Load state...");
+    diffStateBtn = new QPushButton("Diff state...");
+    diffStateBtn->setToolTip("Compare the registers and memory with a saved state");
     loadAddressEdit = new QLineEdit("$00F03000");
     //label4 = new QLabel("at");
     pcEdit = new QLineEdit("$00F03000");
@@ -101,12 +368,37 @@ void MainWindow::setupUI() {
     resetBtn = new QPushButton("Restart (F3)");
     exitBtn = new QPushButton("Exit");
     memWarn = new QCheckBox("No memory warning");
+    shadowCheck = new QCheckBox("Check uninitialized reads");
+    shadowCheck->setToolTip("Report reads of memory never written since the load, and accesses next to the declared buffers");
+    coverageCheck = new QCheckBox("Record coverage");
+    coverageCheck->setToolTip("Record the instructions executed and the outcomes of conditional branches");
+    exportCoverageBtn = new QPushButton("Export coverage...");
+    profilerCheck = new QCheckBox("Profile calls");
+    profilerCheck->setToolTip("Keep a shadow call stack and charge the instructions and cycles to the functions and their callers");
+    exportProfileBtn = new QPushButton("Export profile...");
+    audioBtn = new QPushButton("Capture audio...");
+    audioBtn->setToolTip("Stream the writes to the I2S DAC registers to a 48 kHz WAV file");
     progress = new QProgressBar;
     flagStatusLabel = new QLabel("Flags: Z:0 N:0 C:0");
     g_hidataLabel = new QLabel("G_HIDATA: $00000000");
     g_remainLabel = new QLabel("G_REMAIN: $00000000");
     jumpLabel = new QLabel("Jump: $00000000");
     gpubpLabel = new QLabel("Breakpoint: $00000000");
+    paceMode = new QComboBox;
+    paceMode->addItem("Full speed");
+    paceMode->addItem("Real time (26.59 MHz)");
+    paceMode->addItem("Instructions per second");
+    paceRate = new QDoubleSpinBox;
+    paceRate->setDecimals(3);
+    paceRate->setEnabled(false);
+    cyclesLabel = new QLabel("Cycles: 0");
+    paceLabel = new QLabel("Real time: -");
+    statsLabel = new QLabel;
+    paceTimer = new QTimer(this);
+    paceTimer->setSingleShot(true); // Rescheduled after each slice, never re-entered
+    paceTimer->setTimerType(Qt::PreciseTimer);
+    liveTimer = new QTimer(this);
+    liveTimer->setInterval(33); // About 30 refreshes per second while a program runs
 
     // Add widgets to the right layout (after GPU/DSP mode)
     rightLayout->addWidget(loadBinBtn);
@@ -116,9 +408,26 @@ void MainWindow::setupUI() {
     loadAddrLayout->addWidget(loadAddrLabel);
     loadAddrLayout->addWidget(loadAddressEdit);
     rightLayout->addLayout(loadAddrLayout);
+    rightLayout->addWidget(loadSymBtn);
+
+    QHBoxLayout *stateLayout = new QHBoxLayout;
+    stateLayout->addWidget(saveStateBtn);
+    stateLayout->addWidget(loadStateBtn);
+    stateLayout->addWidget(diffStateBtn);
+    rightLayout->addLayout(stateLayout);
 
     // Move the "No memory warning" checkbox here, right after Load Address
     rightLayout->addWidget(memWarn);
+    rightLayout->addWidget(shadowCheck);
+    QHBoxLayout *coverageLayout = new QHBoxLayout;
+    coverageLayout->addWidget(coverageCheck);
+    coverageLayout->addWidget(exportCoverageBtn);
+    rightLayout->addLayout(coverageLayout);
+    QHBoxLayout *profileLayout = new QHBoxLayout;
+    profileLayout->addWidget(profilerCheck);
+    profileLayout->addWidget(exportProfileBtn);
+    rightLayout->addLayout(profileLayout);
+    rightLayout->addWidget(audioBtn);
 
     QHBoxLayout *pcLayout = new QHBoxLayout;
     pcLayout->addWidget(label5);
@@ -127,15 +436,23 @@ void MainWindow::setupUI() {
 
     rightLayout->addWidget(gpubpLabel);
 
+    QHBoxLayout *paceLayout = new QHBoxLayout;
+    paceLayout->addWidget(paceMode);
+    paceLayout->addWidget(paceRate);
+    rightLayout->addLayout(paceLayout);
+
     rightLayout->addWidget(runBtn);
     rightLayout->addWidget(stepBtn);
     rightLayout->addWidget(skipBtn);
     rightLayout->addWidget(resetBtn);
     rightLayout->addWidget(progress);
     rightLayout->addWidget(flagStatusLabel);
+    rightLayout->addWidget(statsLabel);
     rightLayout->addWidget(g_hidataLabel);
     rightLayout->addWidget(g_remainLabel);
     rightLayout->addWidget(jumpLabel);
+    rightLayout->addWidget(cyclesLabel);
+    rightLayout->addWidget(paceLabel);
 
     // Add stretch to push the Exit button to the bottom
     rightLayout->addStretch();
@@ -154,6 +471,10 @@ void MainWindow::setupUI() {
     // Connect UI signals to slots
     connect(exitBtn, &QPushButton::clicked, this, &MainWindow::onExit);
     connect(loadBinBtn, &QPushButton::clicked, this, &MainWindow::onLoadBin);
+    connect(loadSymBtn, &QPushButton::clicked, this, &MainWindow::onLoadSymbols);
+    connect(saveStateBtn, &QPushButton::clicked, this, &MainWindow::onSaveState);
+    connect(loadStateBtn, &QPushButton::clicked, this, &MainWindow::onLoadState);
+    connect(diffStateBtn, &QPushButton::clicked, this, &MainWindow::onDiffState);
     connect(runBtn, &QPushButton::clicked, this, &MainWindow::onRun);
     connect(stepBtn, &QPushButton::clicked, this, &MainWindow::onStep);
     connect(skipBtn, &QPushButton::clicked, this, &MainWindow::onSkip);
@@ -165,6 +486,21 @@ void MainWindow::setupUI() {
     connect(regBank1, &QTreeWidget::itemDoubleClicked, this, &MainWindow::onRegBank1ItemDoubleClicked);
     connect(codeView, &QTreeWidget::itemDoubleClicked, this, &MainWindow::onCodeViewItemDoubleClicked);
     connect(memWarn, &QCheckBox::toggled, &debugger, &Debugger::setMemoryWarningEnabled);
+    connect(shadowCheck, &QCheckBox::toggled, this, &MainWindow::onShadowCheckToggled);
+    connect(coverageCheck, &QCheckBox::toggled, this, &MainWindow::onCoverageToggled);
+    connect(exportCoverageBtn, &QPushButton::clicked, this, &MainWindow::onExportCoverage);
+    connect(profilerCheck, &QCheckBox::toggled, this, &MainWindow::onProfilerToggled);
+    connect(exportProfileBtn, &QPushButton::clicked, this, &MainWindow::onExportProfile);
+    connect(audioBtn, &QPushButton::clicked, this, &MainWindow::onAudioCapture);
+    connect(mixCheck, &QCheckBox::toggled, this, &MainWindow::onInstructionMixToggled);
+    connect(exportMixBtn, &QPushButton::clicked, this, &MainWindow::onExportInstructionMix);
+    connect(centerTabs, &QTabWidget::currentChanged, this, &MainWindow::onCenterTabChanged);
+    connect(paceMode, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &MainWindow::onPaceModeChanged);
+    connect(paceTimer, &QTimer::timeout, this, &MainWindow::onPaceTick);
+    connect(liveTimer, &QTimer::timeout, this, &MainWindow::onLiveRefresh);
+    connect(saveReportBtn, &QPushButton::clicked, this, &MainWindow::onSaveAnalysisReport);
+    connect(memoryFormat, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &MainWindow::onMemoryFormatChanged);
+    connect(memoryGoTo, &QLineEdit::returnPressed, this, &MainWindow::onMemoryGoTo);
 
     regBank0->setHeaderHidden(true);
     regBank1->setHeaderHidden(true);
@@ -254,6 +590,9 @@ void MainWindow::updateUI() {
 
     // Update code view
     codeView->clear();
+    codeItems.clear();
+    codePCItem = nullptr;
+    const Coverage &coverage = debugger.getCoverage();
     int currentPC = 0;
     {
         QString pcStr = debugger.getPCString();
@@ -288,8 +627,22 @@ void MainWindow::updateUI() {
                 pcFont.setBold(true);
                 item->setFont(1, pcFont);
                 item->setForeground(1, QBrush(QColor(0, 70, 200)));
+                codePCItem = item;
+            }
+            if (coverage.isEnabled() && ok && coverage.isExecuted(addr)) {
+                // Green when executed; amber for a conditional branch seen going one way only
+                QColor background(210, 245, 210);
+                if (debugger.isConditionalBranch(addr)) {
+                    bool taken = coverage.isTaken(addr), notTaken = coverage.isNotTaken(addr);
+                    if (!(taken && notTaken))
+                        background = QColor(255, 235, 160);
+                    item->setToolTip(3, (taken && notTaken) ? "Taken and not taken" : taken ? "Always taken" : "Never taken");
+                }
+                item->setBackground(2, QBrush(background));
+                item->setBackground(3, QBrush(background));
             }
             codeView->addTopLevelItem(item);
+            codeItems.insert(addr, item);
         } else {
             codeView->addTopLevelItem(new QTreeWidgetItem(QStringList() << "" << "" << s << ""));
         }
@@ -305,48 +658,469 @@ void MainWindow::updateUI() {
     g_remainLabel->setText(QString("G_REMAIN: %1").arg(debugger.getRemain()));
     jumpLabel->setText(QString("Jump: %1").arg(debugger.getJump()));
     gpubpLabel->setText(QString("Breakpoint: %1").arg(debugger.getBP()));
+    const PerfCounters &counters = debugger.getCounters();
+    uint64_t loads = 0, stores = 0;
+    for (int i = 0; i < RegionCount; ++i) {
+        loads += counters.loads[i];
+        stores += counters.stores[i];
+    }
+    uint64_t localLoads = counters.loads[RegionGPURAM] + counters.loads[RegionDSPRAM];
+    uint64_t localStores = counters.stores[RegionGPURAM] + counters.stores[RegionDSPRAM];
+    statsLabel->setText(QString("Instructions: %1 (%2 MIPS)\nLoads: %3 (local %4), stores: %5 (local %6)\nBank switches: %7, delay-slot jumps: %8\nDiagnostics: %9")
+        .arg(counters.instructions())
+        .arg(counters.hostNanoseconds ? counters.instructions() * 1000.0 / counters.hostNanoseconds : 0.0, 0, 'f', 2)
+        .arg(loads).arg(localLoads).arg(stores).arg(localStores)
+        .arg(counters.bankSwitches).arg(counters.delaySlotJumps).arg(counters.diagnostics)
+        + QString("\nBus wait states: %1 fetch, %2 data").arg(counters.busFetchCycles).arg(counters.busDataCycles)
+        + (counters.idleSkips ? QString("\nIdle loops: %1 fast-forwarded, %2 instructions").arg(counters.idleSkips).arg(counters.idleInstructions) : QString())
+        + (counters.hookCalls ? QString("\nNative hooks: %1 calls, %2 cycles").arg(counters.hookCalls).arg(counters.hookCycles) : QString())
+        + (debugger.isShadowCheckEnabled() ? QString("\nShadow check: %1 uninitialized reads, %2 overruns")
+            .arg(counters.uninitializedReads).arg(counters.boundsViolations) : QString()));
+    for (int i = 0; i < debugger.getInterruptSourceCount(); ++i) {
+        if (!counters.interrupts[i])
+            continue;
+        statsLabel->setText(statsLabel->text() + QString("\nInterrupt %1 (%2): %3, latency %4 avg %5 max, handler %6 avg %7 max cycles")
+            .arg(i).arg(debugger.getInterruptSourceName(i)).arg(counters.interrupts[i])
+            .arg(double(counters.interruptLatency[i]) / counters.interrupts[i], 0, 'f', 1).arg(counters.interruptLatencyMax[i])
+            .arg(double(counters.interruptHandler[i]) / counters.interrupts[i], 0, 'f', 1).arg(counters.interruptHandlerMax[i]));
+    }
+    if (coverage.isEnabled()) {
+        int covered, taken, notTaken;
+        coverage.totals(covered, taken, notTaken);
+        statsLabel->setText(statsLabel->text() + QString("\nCoverage: %1 instructions, branches %2 taken, %3 not taken")
+            .arg(covered).arg(taken).arg(notTaken));
+    }
+    const Profiler &profiler = debugger.getProfiler();
+    if (profiler.isEnabled()) {
+        statsLabel->setText(statsLabel->text() + QString("\nProfile: %1 call paths, call depth %2")
+            .arg(profiler.nodeCount()).arg(profiler.depth() - 1));
+    }
+    const AudioCapture &audio = debugger.getAudioCapture();
+    if (audio.isActive()) {
+        statsLabel->setText(statsLabel->text() + QString("\nAudio: %1 frames at %2 Hz to %3")
+            .arg(audio.framesWritten()).arg(audio.sampleRate()).arg(QFileInfo(audio.fileName()).fileName()));
+    }
+    showAnalysis();
+    if (centerTabs->currentWidget() == mixPage)
+        showInstructionMix();
+    memoryModel->refresh();
+    showCycles(debugger.getCycleCount());
     pcEdit->setText(debugger.getPCString());
     // Update progress bar
     progress->setValue(debugger.getProgress());
     // Enable/disable buttons based on debugger state
     bool fileLoaded = debugger.canRun() || debugger.canStep() || debugger.canSkip();
+    loadSymBtn->setEnabled(fileLoaded);
+    saveStateBtn->setEnabled(fileLoaded);
+    diffStateBtn->setEnabled(fileLoaded);
+    exportCoverageBtn->setEnabled(coverage.isEnabled());
+    exportProfileBtn->setEnabled(profiler.isEnabled());
+    exportMixBtn->setEnabled(debugger.isInstructionMixEnabled());
+    audioBtn->setText(audio.isActive() ? "Stop audio capture" : "Capture audio...");
     runBtn->setEnabled(fileLoaded);
     stepBtn->setEnabled(fileLoaded);
     skipBtn->setEnabled(fileLoaded);
     resetBtn->setEnabled(fileLoaded);
+    reportShadowFindings();
+}
+
+// Shows the shadow memory findings held back during the last run, the first ones in full
+void MainWindow::reportShadowFindings() {
+    const int shown = 10;
+    QStringList findings = debugger.takeShadowReports();
+    if (findings.isEmpty())
+        return;
+    int more = findings.size() - shown;
+    if (more > 0) {
+        findings.erase(findings.begin() + shown, findings.end());
+        findings << QString("... and %1 more").arg(more);
+    }
+    QMessageBox::warning(this, "Shadow memory", findings.join("\n\n"));
 }
 
 // Slot: Load a BIN file and initialize the debugger
 void MainWindow::onLoadBin() {
-    QString fileName = QFileDialog::getOpenFileName(this, "Open file", "", "BIN Files (*.bin);;Obj files (*.o);;All Files (*)");
+    QString fileName = QFileDialog::getOpenFileName(this, "Open file", "", "BIN Files (*.bin);;Jaguar executables (*.abs *.cof *.elf);;Obj files (*.o);;All Files (*)");
     if (!fileName.isEmpty()) {
         bool ok = false;
         int address = loadAddressEdit->text().remove('$').toInt(&ok, 16);
         if (!ok) address = 0;
-        if (debugger.loadBin(fileName, address)) {
-            debugger.reset();
-            debugger.setStringPC(QString("$%1").arg(address, 8, 16, QChar('0')).toUpper()); // Set PC to loading address
-            updateUI();
-        } else {
+        if (!loadBin(fileName, address))
             QMessageBox::warning(this, "Error", "Failed to load BIN file.");
+    }
+}
+
+// Load an image and show it from its entry point
+bool MainWindow::loadBin(const QString &filename, int address) {
+    stopBackgroundRun();
+    if (!debugger.loadBin(filename, address))
+        return false;
+    debugger.reset(); // Set PC to the entry point of the loaded image
+    memoryModel->resync();
+    updateAnalysis();
+    updateUI();
+    return true;
+}
+
+// Slot: Load symbols from a linker map or symbol listing
+void MainWindow::onLoadSymbols() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Open symbols", "", "Map files (*.map *.sym *.txt);;All Files (*)");
+    if (!fileName.isEmpty()) {
+        stopBackgroundRun();
+        if (debugger.loadSymbols(fileName)) {
+            updateAnalysis();
+            updateUI();
         }
     }
 }
 
+// Slot: Save the machine state, to share a repro point or start batch runs from it
+void MainWindow::onSaveState() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Save state", "", "Save states (*.jrs);;All Files (*)");
+    if (!fileName.isEmpty()) {
+        stopBackgroundRun();
+        debugger.saveState(fileName);
+    }
+}
+
+// Slot: Restore a machine state saved by onSaveState()
+void MainWindow::onLoadState() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Load state", "", "Save states (*.jrs);;All Files (*)");
+    if (!fileName.isEmpty())
+        loadState(fileName);
+}
+
+// Slot: Compare the machine with a saved state; the report lists the changes since the save
+void MainWindow::onDiffState() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Diff state", "", "Save states (*.jrs);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+    if (paceTimer->isActive())
+        stopPacedRun();
+    stopBackgroundRun();
+    MachineSnapshot saved, live;
+    if (!debugger.loadSnapshot(fileName, saved))
+        return;
+    debugger.captureSnapshot(live);
+    StateDiff diff;
+    diff.compare(saved, live);
+    QString summary = diff.isEmpty() ? QString("The machine state matches %1.").arg(QFileInfo(fileName).fileName())
+        : QString("%1 registers and %2 bytes in %3 spans differ from %4.").arg(static_cast<int>(diff.registers().size()))
+              .arg(diff.bytesDiffering()).arg(static_cast<int>(diff.spans().size())).arg(QFileInfo(fileName).fileName());
+    QMessageBox box(QMessageBox::Information, "Diff state", summary, QMessageBox::Ok, this);
+    box.setDetailedText(diff.report(saved).join("\n"));
+    box.exec();
+}
+
+// Re-run the static analysis of the loaded image; the next updateUI() shows it
+void MainWindow::updateAnalysis() {
+    analysis.analyze(MemoryBuffer.data(), debugger.getSegments(), debugger.getDecodeTable(), debugger.getSymbols());
+}
+
+// List the loops, innermost under their enclosing loop, with their blocks and the bus wait states measured so far
+void MainWindow::showAnalysis() {
+    const PerfCounters &counters = debugger.getCounters();
+    analysis.setBusCycles([this](int adrs) { return debugger.getBusCycles(adrs); },
+                          counters.busFetchCycles + counters.busDataCycles);
+    loopView->clear();
+    const SymbolTable &symbols = debugger.getSymbols();
+    const std::vector<BasicBlock> &blocks = analysis.blocks();
+    const std::vector<Loop> &loops = analysis.loops();
+    auto hex = [](int value) { return QString("$%1").arg(value, 8, 16, QChar('0')).toUpper(); };
+    std::vector<QTreeWidgetItem*> items(loops.size(), nullptr);
+    // Parents are created first: an enclosing loop always has a lower depth
+    std::vector<int> order(loops.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = static_cast<int>(i);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return loops[a].depth < loops[b].depth; });
+    for (int i : order) {
+        const Loop &loop = loops[i];
+        const BasicBlock &header = blocks[loop.header];
+        QTreeWidgetItem *item = new QTreeWidgetItem(QStringList()
+            << QString("Loop %1 (depth %2)").arg(symbols.symbolize(header.start)).arg(loop.depth)
+            << hex(header.start) << QString::number(loop.blocks.size()) + " blocks"
+            << QString("~%1 / iteration").arg(loop.cycles) << "" << QString::number(loop.busCycles));
+        if (loop.parent >= 0)
+            items[loop.parent]->addChild(item);
+        else
+            loopView->addTopLevelItem(item);
+        items[i] = item;
+        for (int b : loop.blocks) {
+            const BasicBlock &block = blocks[b];
+            item->addChild(new QTreeWidgetItem(QStringList()
+                << symbols.symbolize(block.start) << hex(block.start) << QString::number(block.instructions)
+                << QString::number(block.cycles) << QString::number(block.stallCycles) << QString::number(block.busCycles)));
+        }
+    }
+    loopView->expandAll();
+    for (int c = 0; c < loopView->columnCount(); ++c)
+        loopView->resizeColumnToContents(c);
+    centerTabs->setTabText(1, QString("Loops / Cycles (%1)").arg(loops.size()));
+}
+
+// Fills the instruction mix panel: operations and the most frequent pairs by count, then the registers of each bank
+void MainWindow::showInstructionMix() {
+    mixView->clear();
+    const InstructionMix &mix = debugger.getInstructionMix();
+    if (!mix.isEnabled())
+        return;
+    InstructionMixTables t;
+    mix.tables(t);
+    auto share = [](uint64_t count, uint64_t total) {
+        return QString("%1%").arg(total ? 100.0 * count / total : 0.0, 0, 'f', 2);
+    };
+    auto group = [this](const QStringList &titles) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(titles);
+        QFont bold = mixView->font();
+        bold.setBold(true);
+        for (int c = 0; c < titles.size(); ++c)
+            item->setFont(c, bold);
+        mixView->addTopLevelItem(item);
+        return item;
+    };
+
+    QTreeWidgetItem *operations = group(QStringList() << QString("Operations (%1 instructions)").arg(t.instructions) << "Count" << "Share");
+    std::vector<int> order;
+    for (int i = 0; i < InstructionMix::Operations; ++i) {
+        if (t.operations[i])
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&t](int a, int b) { return t.operations[a] > t.operations[b]; });
+    for (int i : order)
+        new QTreeWidgetItem(operations, QStringList() << InstructionMix::operationName(i) << QString::number(t.operations[i]) << share(t.operations[i], t.instructions));
+
+    const size_t shownPairs = 64;
+    uint64_t pairTotal = 0;
+    for (const OperationPair &pair : t.pairs)
+        pairTotal += pair.count;
+    QTreeWidgetItem *pairs = group(QStringList() << QString("Pairs (%1 kinds)").arg(t.pairs.size()) << "Count" << "Share");
+    for (size_t i = 0; (i < t.pairs.size()) && (i < shownPairs); ++i) {
+        const OperationPair &pair = t.pairs[i];
+        new QTreeWidgetItem(pairs, QStringList() << QString("%1 -> %2").arg(InstructionMix::operationName(pair.first), InstructionMix::operationName(pair.second))
+                            << QString::number(pair.count) << share(pair.count, pairTotal));
+    }
+
+    for (int bank = 0; bank < 2; ++bank) {
+        QTreeWidgetItem *registers = group(QStringList() << QString("Bank %1 registers").arg(bank) << "Reads" << "Writes" << "moveta" << "movefa");
+        for (int r = 0; r < 32; ++r) {
+            if (!t.reads[bank][r] && !t.writes[bank][r])
+                continue;
+            new QTreeWidgetItem(registers, QStringList() << QString("r%1").arg(r) << QString::number(t.reads[bank][r])
+                                << QString::number(t.writes[bank][r]) << QString::number(t.moveta[bank][r]) << QString::number(t.movefa[bank][r]));
+        }
+    }
+    mixView->expandAll();
+    for (int c = 0; c < mixView->columnCount(); ++c)
+        mixView->resizeColumnToContents(c);
+}
+
+// Slot: Save the static analysis as a text report
+void MainWindow::onSaveAnalysisReport() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Save analysis report", "", "Text files (*.txt);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::warning(this, "Error", QString("Cannot write %1").arg(fileName));
+        return;
+    }
+    QTextStream out(&file);
+    out << analysis.report(debugger.getSymbols());
+}
+
 // Slot: Run the GPU program
 void MainWindow::onRun() {
+    if (gdbServer && gdbServer->isRunning())
+        return; // The remote client owns the target until it stops
+    if (paceTimer->isActive()) {
+        stopPacedRun(); // Run pressed again stops a paced run
+        return;
+    }
+    if (backgroundRun.isActive()) {
+        stopBackgroundRun(); // Run pressed again stops a full-speed run
+        return;
+    }
+    if (!debugger.canRun())
+        return;
+
     // Disable buttons immediately when Run is clicked
     runBtn->setEnabled(false);
     stepBtn->setEnabled(false);
     skipBtn->setEnabled(false);
     resetBtn->setEnabled(false);
 
-    debugger.run();
+    if ((paceMode->currentIndex() == 0) && gdbServer) {
+        // The GDB server reads the target from this thread: keep the run on it
+        debugger.run();
+        updateUI();
+        return;
+    }
+
+    if (paceMode->currentIndex() == 0) {
+        // Full speed on a worker thread; the UI and the metrics server show its snapshots until it stops
+        if (metricsServer)
+            metricsServer->setSnapshot(debugger.getCounters());
+        if (!backgroundRun.start()) {
+            if (metricsServer)
+                metricsServer->clearSnapshot();
+            updateUI();
+            return;
+        }
+        memoryModel->setFrozen(true); // The worker writes the memory: the view keeps the last refresh
+        runBtn->setText("Stop (F5)");
+        runBtn->setEnabled(true);
+        liveTimer->start();
+        return;
+    }
+
+    // Paced run: slices on a timer, the event loop runs in between
+    if (paceMode->currentIndex() == 1)
+        pacer.start(PaceMode::Cycles, JaguarClockHz * paceRate->value());
+    else
+        pacer.start(PaceMode::Instructions, paceRate->value() * 1000000.0);
+    runBtn->setText("Stop (F5)");
+    runBtn->setEnabled(true);
+    paceTimer->start(0);
+    liveTimer->start();
+}
+
+// Slot: Run one time slice of a paced run, then sleep until the host clock catches up
+void MainWindow::onPaceTick() {
+    uint64_t budget = pacer.budget();
+    if (budget > 0) {
+        uint64_t cycles = debugger.getCycleCount();
+        uint64_t count;
+        if (pacer.getMode() == PaceMode::Cycles)
+            count = debugger.runSlice(UINT64_MAX, budget);
+        else
+            count = debugger.runSlice(budget, UINT64_MAX);
+        pacer.account((pacer.getMode() == PaceMode::Cycles) ? debugger.getCycleCount() - cycles : count);
+        if (debugger.getStopReason() != StopReason::Budget) {
+            stopPacedRun();
+            return;
+        }
+    }
+
+    double lag = pacer.lag() * 1000.0;
+    paceLabel->setText(QString("Real time: %1 ms emulated, %2 ms %3").arg(pacer.emulatedTime() * 1000.0, 0, 'f', 1)
+        .arg(std::abs(lag), 0, 'f', 1).arg((lag > 0) ? "behind" : "ahead"));
+    paceTimer->start(pacer.delayMs());
+}
+
+// End a paced run and refresh the UI
+void MainWindow::stopPacedRun() {
+    paceTimer->stop();
+    liveTimer->stop();
+    runBtn->setText("Execute (F5)");
+    updateUI();
+}
+
+// Slot: Show the latest state of a full-speed or paced run; a finished full-speed run is joined here
+void MainWindow::onLiveRefresh() {
+    if (backgroundRun.isActive()) {
+        if (backgroundRun.finished()) {
+            finishBackgroundRun();
+            return;
+        }
+        const CoreSnapshot *state = nullptr;
+        if (backgroundRun.latest(state)) {
+            showSnapshot(*state);
+            if (metricsServer)
+                metricsServer->setSnapshot(state->counters);
+        }
+    } else if (paceTimer->isActive()) {
+        CoreSnapshot state;
+        debugger.snapshot(state); // Paced slices run on this thread
+        showSnapshot(state);
+    } else {
+        liveTimer->stop();
+    }
+}
+
+// Stop a full-speed run, if one is active, and wait for its current chunk
+void MainWindow::stopBackgroundRun() {
+    if (!backgroundRun.isActive())
+        return;
+    backgroundRun.requestStop();
+    finishBackgroundRun();
+}
+
+// Join the worker, report what the run diagnosed, and rebuild the views from the final state
+void MainWindow::finishBackgroundRun() {
+    liveTimer->stop();
+    QStringList messages = backgroundRun.join();
+    memoryModel->setFrozen(false);
+    if (metricsServer)
+        metricsServer->clearSnapshot();
+    runBtn->setText("Execute (F5)");
     updateUI();
+    if (!messages.isEmpty())
+        QMessageBox::warning(this, "Run", messages.join("\n"));
+}
+
+// Update the register values, flags, PC and cycles in place, and move the PC marker of the code view
+void MainWindow::showSnapshot(const CoreSnapshot &state) {
+    QTreeWidget *banks[2] = { regBank0, regBank1 };
+    std::vector<int> *previous[2] = { &prevRegBank0, &prevRegBank1 };
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int i = 0; i < 32; ++i) {
+            QTreeWidgetItem *item = banks[bank]->topLevelItem(i);
+            int value = state.regs[bank][i];
+            if (!item || ((*previous[bank])[i] == value))
+                continue;
+            (*previous[bank])[i] = value;
+            item->setText(2, QString("$%1").arg(static_cast<uint32_t>(value), 8, 16, QChar('0')).toUpper());
+            item->setText(0, "*");
+            QFont font = item->font(0);
+            font.setBold(true);
+            item->setFont(0, font);
+            item->setForeground(0, QBrush(Qt::green));
+        }
+    }
+    flagStatusLabel->setText(QString("Flags: Z:%1 N:%2 C:%3").arg(state.z).arg(state.n).arg(state.c));
+    pcEdit->setText(QString("$%1").arg(state.pc, 8, 16, QChar('0')).toUpper());
+    showCycles(state.cycles);
+
+    QTreeWidgetItem *pcItem = codeItems.value(state.pc, nullptr);
+    if (pcItem == codePCItem)
+        return;
+    if (codePCItem)
+        codePCItem->setText(1, "");
+    if (pcItem) {
+        QFont pcFont = codeView->font();
+        pcFont.setBold(true);
+        pcItem->setText(1, ">");
+        pcItem->setFont(1, pcFont);
+        pcItem->setForeground(1, QBrush(QColor(0, 70, 200)));
+        codeView->scrollToItem(pcItem);
+    }
+    codePCItem = pcItem;
+}
+
+// Show a cycle count as cycles, milliseconds and frames of emulated time
+void MainWindow::showCycles(uint64_t cycles) {
+    double cycleTime = cycles / JaguarClockHz;
+    cyclesLabel->setText(QString("Cycles: %1 (%2 ms, %3 frames)").arg(cycles)
+        .arg(cycleTime * 1000.0, 0, 'f', 3).arg(cycleTime * 60.0, 0, 'f', 2));
+}
+
+// Slot: Switch between full speed, real time (clock multiplier) and instructions per second
+void MainWindow::onPaceModeChanged(int index) {
+    paceRate->setEnabled(index != 0);
+    if (index == 1) {
+        paceRate->setRange(0.001, 100.0);
+        paceRate->setSuffix(" x");
+        paceRate->setValue(1.0);
+    } else if (index == 2) {
+        paceRate->setRange(0.001, 1000.0);
+        paceRate->setSuffix(" MIPS");
+        paceRate->setValue(1.0);
+    }
 }
 
 // Slot: Step one instruction
 void MainWindow::onStep() {
+    if (paceTimer->isActive() || backgroundRun.isActive() || (gdbServer && gdbServer->isRunning())) return;
     int w = debugger.ReadWord(debugger.getPCValue(), true);
     if (w != -1) {
         //noPCrefresh = false;
@@ -357,10 +1131,18 @@ void MainWindow::onStep() {
 }
 
 // Slot: Skip one instruction (without execution)
-void MainWindow::onSkip() { debugger.skip(); updateUI(); }
+void MainWindow::onSkip() {
+    if (paceTimer->isActive() || backgroundRun.isActive() || (gdbServer && gdbServer->isRunning())) return;
+    debugger.skip();
+    updateUI();
+}
 
 // Slot: Reset the GPU state
 void MainWindow::onReset() {
+    stopBackgroundRun();
+    paceTimer->stop();
+    liveTimer->stop();
+    runBtn->setText("Execute (F5)");
     debugger.reset();
     std::fill(prevRegBank0.begin(), prevRegBank0.end(), 0);
     std::fill(prevRegBank1.begin(), prevRegBank1.end(), 0);
@@ -372,20 +1154,31 @@ void MainWindow::onExit() { close(); }
 
 // Slot: Switch to GPU mode
 void MainWindow::onGPUMode() {
+    if (paceTimer->isActive())
+        stopPacedRun();
+    stopBackgroundRun();
     debugger.setGPUMode(true);
     loadAddressEdit->setText("$00F03000"); // Set default address for GPU mode
+    updateAnalysis(); // The decode table changed
     updateUI();
 }
 
 // Slot: Switch to DSP mode
 void MainWindow::onDSPMode() {
+    if (paceTimer->isActive())
+        stopPacedRun();
+    stopBackgroundRun();
     debugger.setGPUMode(false);
     loadAddressEdit->setText("$00F1B000"); // Set default address for DSP mode
+    updateAnalysis(); // The decode table changed
     updateUI();
 }
 
 // Slot: Update PC from the line edit
 void MainWindow::onPCEditReturnPressed() {
+    if (paceTimer->isActive())
+        stopPacedRun();
+    stopBackgroundRun();
     debugger.setStringPC(pcEdit->text());
     updateUI();
 }
@@ -393,6 +1186,7 @@ void MainWindow::onPCEditReturnPressed() {
 // Slot: Edit a register in bank 0
 void MainWindow::onRegBank0ItemDoubleClicked(QTreeWidgetItem* item, int column) {
     if (column != 1) return; // Only allow editing the value column
+    stopBackgroundRun();
     int regIndex = regBank0->indexOfTopLevelItem(item);
     QString currentValue = item->text(2);
     bool ok = false;
@@ -412,6 +1206,7 @@ void MainWindow::onRegBank0ItemDoubleClicked(QTreeWidgetItem* item, int column)
 // Slot: Edit a register in bank 1
 void MainWindow::onRegBank1ItemDoubleClicked(QTreeWidgetItem* item, int column) {
     if (column != 1) return; // Only allow editing the value column
+    stopBackgroundRun();
     int regIndex = regBank1->indexOfTopLevelItem(item);
     QString currentValue = item->text(2);
     bool ok = false;
@@ -432,12 +1227,14 @@ void MainWindow::onRegBank1ItemDoubleClicked(QTreeWidgetItem* item, int column)
 void MainWindow::onCodeViewItemDoubleClicked(QTreeWidgetItem* item, int column) {
     Q_UNUSED(column);
     if (!item) return;
+    stopBackgroundRun();
     debugger.setBreakpoint(item->text(2)); // Use column 2 for address
     updateUI();
 }
 
 // Slot: Edit a register in bank 0 via label click
 void MainWindow::onRegBank0LabelClicked() {
+    stopBackgroundRun();
     bool ok = false;
     int regIndex = QInputDialog::getInt(this, "Edit Register (Bank 0)", "Register index (0-31):", 0, 0, 31, 1, &ok);
     if (!ok) return;
@@ -453,6 +1250,7 @@ void MainWindow::onRegBank0LabelClicked() {
 
 // Slot: Edit a register in bank 1 via label click
 void MainWindow::onRegBank1LabelClicked() {
+    stopBackgroundRun();
     bool ok = false;
     int regIndex = QInputDialog::getInt(this, "Edit Register (Bank 1)", "Register index (0-31):", 0, 0, 31, 1, &ok);
     if (!ok) return;
@@ -506,3 +1304,94 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
         QMainWindow::keyPressEvent(event);
     }
 }
+
+// Slot: Turn the shadow memory check on or off; turning it on takes the loaded image as the only bytes written
+void MainWindow::onShadowCheckToggled(bool checked) {
+    stopBackgroundRun();
+    debugger.setShadowCheck(checked);
+    updateUI();
+}
+
+// Slot: Turn coverage recording on or off; turning it on starts from nothing recorded
+void MainWindow::onCoverageToggled(bool checked) {
+    stopBackgroundRun();
+    debugger.setCoverage(checked);
+    updateUI();
+}
+
+// Slot: Export the coverage as an lcov tracefile, or save the bitmaps to merge them later
+void MainWindow::onExportCoverage() {
+    const QString bitmaps = "Coverage bitmaps (*.jcov)";
+    QString filter;
+    QString fileName = QFileDialog::getSaveFileName(this, "Export coverage", "", "lcov tracefiles (*.info);;" + bitmaps, &filter);
+    if (!fileName.isEmpty())
+        writeCoverage(fileName, (filter == bitmaps) ? CoverageFormat::Bitmaps : CoverageFormat::Lcov);
+}
+
+// Slot: Turn the call profiler on or off; turning it on starts from nothing recorded
+void MainWindow::onProfilerToggled(bool checked) {
+    stopBackgroundRun();
+    debugger.setProfiler(checked);
+    updateUI();
+}
+
+// Slot: Export the call profile as a trace, flame graph input or report
+void MainWindow::onExportProfile() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Export profile", "", "Chrome traces (*.json);;Collapsed stacks (*.folded);;Reports (*.txt)");
+    if (!fileName.isEmpty())
+        writeProfile(fileName);
+}
+
+// Slot: Turn the instruction mix on or off; turning it on starts from nothing recorded
+void MainWindow::onInstructionMixToggled(bool checked) {
+    stopBackgroundRun();
+    debugger.setInstructionMix(checked);
+    updateUI();
+}
+
+// Slot: Export the instruction mix as JSON or text tables
+void MainWindow::onExportInstructionMix() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Export instruction mix", "", "Reports (*.txt);;JSON files (*.json)");
+    if (!fileName.isEmpty())
+        writeInstructionMix(fileName);
+}
+
+// Slot: Start streaming the DAC writes to a WAV file, or complete the file being written
+void MainWindow::onAudioCapture() {
+    if (debugger.getAudioCapture().isActive()) {
+        stopAudioCapture();
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Capture audio", "", "WAV files (*.wav)");
+    if (!fileName.isEmpty())
+        startAudioCapture(fileName, 48000, "cycles");
+}
+
+// Slot: The instruction mix tables are only derived while their panel is shown
+void MainWindow::onCenterTabChanged(int index) {
+    if (centerTabs->widget(index) == mixPage)
+        showInstructionMix();
+}
+
+// Slot: Show the memory as bytes, words, longs or signed 16.16 fixed point
+void MainWindow::onMemoryFormatChanged(int index) {
+    static const MemoryModel::Format formats[] = {
+        MemoryModel::Format::Byte, MemoryModel::Format::Word, MemoryModel::Format::Long, MemoryModel::Format::Fixed
+    };
+    if ((index < 0) || (index > 3))
+        return;
+    memoryModel->setFormat(formats[index]);
+    memoryView->resizeColumnsToContents();
+}
+
+// Slot: Scroll the memory view to the address, register value or symbol typed in the Go to field
+void MainWindow::onMemoryGoTo() {
+    int address = 0;
+    if (!memoryModel->resolve(memoryGoTo->text(), address)) {
+        statusBar()->showMessage(QString("Unknown address: %1").arg(memoryGoTo->text()), 3000);
+        return;
+    }
+    QModelIndex cell = memoryModel->indexOf(address);
+    memoryView->scrollTo(cell, QAbstractItemView::PositionAtTop);
+    memoryView->setCurrentIndex(cell);
+}
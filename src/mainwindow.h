@@ -11,7 +11,20 @@
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QMessageBox>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QTimer>
+#include <QTabWidget>
+#include <QTableView>
 #include "debugger.h"
+#include "backgroundrun.h"
+#include "analyzer.h"
+#include "memorymodel.h"
+#include "pacer.h"
+#include "gdbserver.h"
+#include "metricsserver.h"
+#include "statediff.h"
+#include <QHash>
 #include <vector>
 
 // MainWindow: The main Qt5 window for the Jaguar GPU Simulator/Debugger.
@@ -21,6 +34,52 @@ class MainWindow : public QMainWindow {
 public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    // Starts the GDB remote protocol server on a TCP port or local socket
+    bool startGdbServer(const QString &address);
+    // Starts the HTTP endpoint serving the performance counters
+    bool startMetricsServer(const QString &address);
+    // Writes the performance counters to a JSON or Prometheus text file
+    bool writeMetrics(const QString &filename);
+    // Loads a binary or executable at 'address' (if it has none of its own), resets and refreshes the views
+    bool loadBin(const QString &filename, int address);
+    // Restores a machine state file and refreshes the views
+    bool loadState(const QString &filename);
+    // Prints the differences between two state files, or a state file and the live machine if 'after' is empty;
+    // returns 0 if they match, 1 if they differ, 2 if a file cannot be read
+    int diffStates(const QString &before, const QString &after);
+    // Turns the shadow memory check of uninitialized reads and buffer overruns on or off
+    void setShadowCheck(bool enabled);
+    // Turns recording of the instructions executed and branch outcomes on or off
+    void setCoverage(bool enabled);
+    // Merges the coverage bitmaps saved by an earlier run
+    bool mergeCoverage(const QString &filename);
+    // Writes the coverage as bitmaps (.jcov) or as an lcov tracefile
+    bool writeCoverage(const QString &filename, CoverageFormat format);
+    // Turns the shadow call stack and call profile on or off
+    void setProfiler(bool enabled);
+    // Sets the call and return idioms of the profiler from "symbols,link,window=N"
+    bool setCallIdioms(const QString &spec);
+    // Writes the profile: Chrome trace (.json), collapsed stacks (.folded) or the per-function report
+    bool writeProfile(const QString &filename);
+    // Turns the operation, operation pair and register counts on or off
+    void setInstructionMix(bool enabled);
+    // Writes the instruction mix as JSON (.json) or text tables
+    bool writeInstructionMix(const QString &filename);
+    // Streams the stores to the I2S DAC registers to a WAV file; 'rate' 0 keeps the I2S frame rate, 'clock' is
+    // "cycles" (the I2S frame clock) or "writes" (one frame per right channel write)
+    bool startAudioCapture(const QString &filename, int rate, const QString &clock);
+    // Completes the WAV file of the audio capture
+    bool stopAudioCapture();
+    // Declares a buffer for the overrun check from "address:length[:name]" (hex address, decimal or 0x length)
+    bool addShadowBuffer(const QString &spec);
+    // Schedules an interrupt from "source@cycle[/period]", all decimal; repeated every period cycles if given
+    bool scheduleInterrupt(const QString &spec);
+    // Replaces a routine by a built-in native handler, from "target:fill|copy|sqrt:arguments[:cycles[:link]]"
+    bool addHook(const QString &spec);
+    // Turns the fast-forwarding of idle polling loops on or off
+    void setIdleSkip(bool enabled);
+    // Updates the UI to reflect the current debugger state
+    void updateUI();
 
 protected:
     // Override the eventFilter function from QObject
@@ -30,6 +89,14 @@ protected:
 private slots:
     // Slot for loading a BIN file
     void onLoadBin();
+    // Slot for loading symbols from a map file
+    void onLoadSymbols();
+    // Slot for saving the machine state to a file
+    void onSaveState();
+    // Slot for restoring the machine state from a file
+    void onLoadState();
+    // Slot for comparing the machine with a saved state
+    void onDiffState();
     // Slot for running the GPU program
     void onRun();
     // Slot for stepping one instruction
@@ -56,24 +123,93 @@ private slots:
     void onRegBank0LabelClicked();
     // Slot for editing a register in bank 1 via label click
     void onRegBank1LabelClicked();
+    // Slot running one time slice of a paced run
+    void onPaceTick();
+    // Slot showing the latest state of a running program
+    void onLiveRefresh();
+    // Slot for switching between full speed, real time and instructions per second
+    void onPaceModeChanged(int index);
+    // Slot for saving the static analysis as a text report
+    void onSaveAnalysisReport();
+    // Slot for switching the memory view between bytes, words, longs and 16.16 fixed point
+    void onMemoryFormatChanged(int index);
+    // Slot for scrolling the memory view to an address, register or symbol
+    void onMemoryGoTo();
+    // Slot for turning the shadow memory check on or off
+    void onShadowCheckToggled(bool checked);
+    // Slot for turning coverage recording on or off
+    void onCoverageToggled(bool checked);
+    // Slot for exporting the coverage to a file
+    void onExportCoverage();
+    // Slot for turning the call profiler on or off
+    void onProfilerToggled(bool checked);
+    // Slot for exporting the call profile to a file
+    void onExportProfile();
+    // Slot for turning the instruction mix on or off
+    void onInstructionMixToggled(bool checked);
+    // Slot for exporting the instruction mix to a file
+    void onExportInstructionMix();
+    // Slot for starting or stopping the audio capture
+    void onAudioCapture();
+    // Slot for filling a panel when it is shown
+    void onCenterTabChanged(int index);
 
 private:
     // UI widgets
     QLabel *regBank0Label, *regBank1Label, *codeLabel, *flagStatusLabel, *gpubpLabel, *g_hidataLabel, *g_remainLabel, *jumpLabel, /* , *label4 */ *label5;
-    QTreeWidget *regBank0, *regBank1, *codeView;
-    QPushButton *loadBinBtn, *runBtn, *stepBtn, *skipBtn, *resetBtn, *exitBtn;
+    QTreeWidget *regBank0, *regBank1, *codeView, *loopView, *mixView;
+    QWidget *mixPage;
+    QTableView *memoryView;
+    QComboBox *memoryFormat;
+    QLineEdit *memoryGoTo;
+    QTabWidget *centerTabs;
+    QPushButton *saveReportBtn;
+    QPushButton *saveStateBtn, *loadStateBtn, *diffStateBtn;
+    QPushButton *loadBinBtn, *loadSymBtn, *runBtn, *stepBtn, *skipBtn, *resetBtn, *exitBtn;
     QLineEdit *loadAddressEdit, *pcEdit;
-    QCheckBox *memWarn;
+    QCheckBox *memWarn, *shadowCheck, *coverageCheck, *profilerCheck, *mixCheck;
+    QPushButton *exportCoverageBtn, *exportProfileBtn, *exportMixBtn, *audioBtn;
     QRadioButton *gpuMode, *dspMode;
     QProgressBar *progress;
     QFileDialog *openDialog;
+    QComboBox *paceMode;
+    QDoubleSpinBox *paceRate;
+    QLabel *cyclesLabel, *paceLabel, *statsLabel;
+    QTimer *paceTimer;
+    QTimer *liveTimer;
 
     Debugger debugger; // The core logic handler
+    BackgroundRun backgroundRun{ &debugger }; // Full-speed runs on a worker thread
 
     // Sets up the UI layout and widgets
     void setupUI();
-    // Updates the UI to reflect the current debugger state
-    void updateUI();
+    // Ends a paced run and refreshes the UI
+    void stopPacedRun();
+    // Stops a full-speed run, then shows its diagnostics and refreshes the UI
+    void stopBackgroundRun();
+    // Joins a finished full-speed run, then shows its diagnostics and refreshes the UI
+    void finishBackgroundRun();
+    // Shows the shadow memory findings of the last run in one message box
+    void reportShadowFindings();
+    // Updates the registers, flags, PC, cycles and PC marker from a snapshot, without rebuilding the views
+    void showSnapshot(const CoreSnapshot &state);
+    // Shows a cycle count as cycles, milliseconds and frames
+    void showCycles(uint64_t cycles);
+    // Re-runs the static analysis of the loaded image
+    void updateAnalysis();
+    // Fills the loop/cycle panel, with the bus wait states measured so far
+    void showAnalysis();
+    // Fills the instruction mix panel from the counts recorded so far
+    void showInstructionMix();
+
+    Pacer pacer; // Real-time pacing of the Run button
+    ProgramAnalysis analysis; // Blocks, loops and estimated cycles of the loaded image
+    MemoryModel *memoryModel = nullptr; // Rows of the memory view, fetched as they are shown
+    GdbServer *gdbServer = nullptr; // Remote debugging, started from the command line
+    MetricsServer *metricsServer = nullptr; // Counters endpoint, started from the command line
+
+    QHash<int, QTreeWidgetItem*> codeItems; // Code view line of each address, for the live PC marker
+    QTreeWidgetItem *codePCItem = nullptr; // Code view line with the PC marker
 
     std::vector<int> prevRegBank0;
     std::vector<int> prevRegBank1;
@@ -0,0 +1,197 @@
+#include <QBrush>
+#include <QFont>
+#include <QRegExp>
+#include <algorithm>
+#include <cstring>
+#include "memorymodel.h"
+
+// Start with the current memory as the reference
+MemoryModel::MemoryModel(Debugger* debugger, QObject* parent)
+    : QAbstractTableModel(parent), debugger(debugger) {
+    resync();
+}
+
+
+// One row per 16 bytes of the address space
+int MemoryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : (MemorySize + BytesPerRow - 1) / BytesPerRow;
+}
+
+
+// Address, the cells of the row, then the row as characters
+int MemoryModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 1 + BytesPerRow / CellSize() + 1;
+}
+
+
+// Text of the visible cells, and the highlight of the bytes changed since the previous stop
+QVariant MemoryModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid())
+        return QVariant();
+    int rowAddress = index.row() * BytesPerRow;
+    int cells = BytesPerRow / CellSize();
+    int column = index.column();
+    if (role == Qt::DisplayRole) {
+        if (column == 0)
+            return QString("$%1").arg(rowAddress, 8, 16, QChar('0')).toUpper();
+        if (column <= cells)
+            return FormatCell(rowAddress + (column - 1) * CellSize());
+        QString text;
+        int end = std::min(rowAddress + BytesPerRow, MemorySize);
+        for (int adrs = rowAddress; adrs < end; ++adrs) {
+            uint8_t c = Bytes()[adrs];
+            text += ((c >= 0x20) && (c < 0x7F)) ? QChar::fromLatin1(static_cast<char>(c)) : QChar('.');
+        }
+        return text;
+    }
+    if ((column >= 1) && (column <= cells) && Changed(rowAddress + (column - 1) * CellSize(), CellSize())) {
+        if (role == Qt::ForegroundRole)
+            return QBrush(Qt::green);
+        if (role == Qt::FontRole) {
+            QFont font;
+            font.setBold(true);
+            return font;
+        }
+    }
+    if ((role == Qt::TextAlignmentRole) && (column >= 1) && (column <= cells))
+        return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+    return QVariant();
+}
+
+
+// Byte offsets of the cells above the columns
+QVariant MemoryModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if ((orientation != Qt::Horizontal) || (role != Qt::DisplayRole))
+        return QVariant();
+    int cells = BytesPerRow / CellSize();
+    if (section == 0)
+        return QString("Address");
+    if (section <= cells)
+        return QString("+%1").arg((section - 1) * CellSize(), 0, 16).toUpper();
+    return QString("Text");
+}
+
+
+// Change the cell format; the column count follows
+void MemoryModel::setFormat(Format format) {
+    if (format == cellFormat)
+        return;
+    beginResetModel();
+    cellFormat = format;
+    endResetModel();
+}
+
+
+// Cell holding the address
+QModelIndex MemoryModel::indexOf(int address) const {
+    if ((address < 0) || (address >= MemorySize))
+        return QModelIndex();
+    return index(address / BytesPerRow, 1 + (address % BytesPerRow) / CellSize());
+}
+
+
+// Parse an address, a register or a symbol, with an optional hex offset
+bool MemoryModel::resolve(const QString& text, int& address) const {
+    QString target = text.trimmed();
+    int offset = 0;
+    int plus = target.lastIndexOf('+');
+    if (plus > 0) {
+        bool ok = false;
+        QString delta = target.mid(plus + 1).trimmed().remove('$');
+        offset = delta.startsWith("0x", Qt::CaseInsensitive) ? delta.mid(2).toInt(&ok, 16) : delta.toInt(&ok, 16);
+        if (!ok)
+            return false;
+        target = target.left(plus).trimmed();
+    }
+    QRegExp reg("^(?:([01]):)?[rR](\\d+)$");
+    QRegExp hex("^(?:\\$|0[xX])?([0-9A-Fa-f]+)$");
+    if (reg.exactMatch(target) && (reg.cap(2).toInt() < 32)) {
+        if (frozen)
+            return false; // The registers belong to the run
+        address = debugger->getRegBankRegisterValue(reg.cap(1).toInt(), reg.cap(2).toInt());
+    }
+    else if (!debugger->getSymbols().find(target, address)) {
+        bool ok = false;
+        if (!hex.exactMatch(target))
+            return false;
+        address = static_cast<int>(hex.cap(1).toUInt(&ok, 16));
+        if (!ok)
+            return false;
+    }
+    address += offset;
+    return (address >= 0) && (address < MemorySize);
+}
+
+
+// Keep the pages written since the last refresh as they were, take them into the reference, repaint
+void MemoryModel::refresh() {
+    previous.clear();
+    dirty.clear();
+    debugger->takeDirtyPages(dirty);
+    const int pageSize = 1 << Debugger::DirtyPageShift;
+    for (int page : dirty) {
+        int start = page * pageSize;
+        int length = std::min(pageSize, MemorySize - start);
+        if (std::memcmp(reference.data() + start, MemoryBuffer.data() + start, length) == 0)
+            continue;
+        previous[page].assign(reference.begin() + start, reference.begin() + start + length);
+        std::memcpy(reference.data() + start, MemoryBuffer.data() + start, length);
+    }
+    // The view only fetches the rows it shows again
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+
+// Take the whole memory as the reference and clear the highlights
+void MemoryModel::resync() {
+    std::vector<int> discarded;
+    debugger->takeDirtyPages(discarded);
+    reference = MemoryBuffer;
+    previous.clear();
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+
+// Bytes per cell of the format
+int MemoryModel::CellSize() const {
+    switch (cellFormat) {
+    case Format::Byte: return 1;
+    case Format::Word: return 2;
+    default: return 4;
+    }
+}
+
+
+// True if a byte of the cell differs from its value before the last run
+bool MemoryModel::Changed(int address, int size) const {
+    if (previous.empty())
+        return false;
+    auto page = previous.find(address >> Debugger::DirtyPageShift);
+    if (page == previous.end())
+        return false;
+    int offset = address & ((1 << Debugger::DirtyPageShift) - 1);
+    for (int i = 0; i < size; ++i) {
+        if (page->second[offset + i] != Bytes()[address + i])
+            return true;
+    }
+    return false;
+}
+
+
+// Big-endian value of the cell in the selected format
+QString MemoryModel::FormatCell(int address) const {
+    const uint8_t* p = Bytes() + address;
+    switch (cellFormat) {
+    case Format::Byte:
+        return QString("%1").arg(p[0], 2, 16, QChar('0')).toUpper();
+    case Format::Word:
+        return QString("%1").arg((p[0] << 8) | p[1], 4, 16, QChar('0')).toUpper();
+    case Format::Long:
+        return QString("%1").arg((uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3], 8, 16, QChar('0')).toUpper();
+    case Format::Fixed:
+    default: {
+        int32_t value = static_cast<int32_t>((uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+        return QString::number(value / 65536.0, 'f', 4);
+    }
+    }
+}
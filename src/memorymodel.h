@@ -0,0 +1,56 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QString>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "debugger.h"
+
+// MemoryModel: the whole address space as rows of 16 bytes, for a QTableView. data() reads MemoryBuffer only
+// for the cells the view asks for, so scrolling costs the same anywhere in the 15.5 MB. Bytes written since the
+// previous stop are highlighted: refresh() takes the pages the interpreter marked dirty and keeps their previous
+// contents from a reference copy, so a refresh costs the pages written, never a compare of the whole memory.
+// While a background run owns the memory the model is frozen: the cells come from the reference copy.
+class MemoryModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    // Cell formats; Fixed is a signed 16.16 long
+    enum class Format { Byte, Word, Long, Fixed };
+    static const int BytesPerRow = 16;
+
+    explicit MemoryModel(Debugger* debugger, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setFormat(Format format);
+    Format format() const { return cellFormat; }
+    // Cell holding the address
+    QModelIndex indexOf(int address) const;
+    // Address of "$F03000", "0x4000", "r12" (bank 0), "1:r12" (bank 1), "symbol" or "symbol+$10"; false if unknown
+    bool resolve(const QString& text, int& address) const;
+
+    // After a stop: highlight what the pages written since the last refresh changed, and repaint
+    void refresh();
+    // After a load: the current memory becomes the reference, nothing is highlighted
+    void resync();
+    // Show the memory as of the last refresh, without reading the live buffer, until unfrozen
+    void setFrozen(bool freeze) { frozen = freeze; }
+
+private:
+    // The live buffer, or the reference copy while frozen
+    const uint8_t* Bytes() const { return frozen ? reference.data() : MemoryBuffer.data(); }
+    int CellSize() const;
+    bool Changed(int address, int size) const;
+    QString FormatCell(int address) const;
+
+    Debugger* debugger;
+    Format cellFormat = Format::Byte;
+    bool frozen = false;
+    std::vector<uint8_t> reference;                             // memory at the last refresh
+    std::unordered_map<int, std::vector<uint8_t>> previous;     // pages written by the last run, as they were before
+    std::vector<int> dirty;
+};
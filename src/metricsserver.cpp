@@ -0,0 +1,82 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QFile>
+#include "metricsserver.h"
+
+// Constructor: the server reports the counters of the given debugger
+MetricsServer::MetricsServer(Debugger* debugger, QObject* parent)
+    : QObject(parent), debugger(debugger) {
+}
+
+
+// Listen on "port" or "host:port"
+bool MetricsServer::listen(const QString& address) {
+    QHostAddress host(QHostAddress::LocalHost);
+    QString port = address;
+    int colon = address.lastIndexOf(':');
+    if (colon >= 0) {
+        host = QHostAddress(address.left(colon));
+        port = address.mid(colon + 1);
+    }
+    bool ok = false;
+    quint16 portNumber = port.toUShort(&ok);
+    if (!ok || host.isNull()) {
+        error = QString("Invalid metrics address: %1").arg(address);
+        return false;
+    }
+    server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+    if (!server->listen(host, portNumber)) {
+        error = server->errorString();
+        return false;
+    }
+    return true;
+}
+
+
+// Serve a copy of the counters published by a run
+void MetricsServer::setSnapshot(const PerfCounters& counters) {
+    snapshot = counters;
+    useSnapshot = true;
+}
+
+
+// Answer each request once its request line has arrived, then close the connection
+void MetricsServer::onNewConnection() {
+    while (server->hasPendingConnections()) {
+        QTcpSocket* socket = server->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            if (!socket->canReadLine())
+                return;
+            QList<QByteArray> request = socket->readLine().split(' ');
+            QByteArray path = (request.size() >= 2) ? request[1] : QByteArray("/");
+            QByteArray body, type;
+            const PerfCounters& counters = useSnapshot ? snapshot : debugger->getCounters();
+            if (path.startsWith("/metrics.json")) {
+                body = counters.toJson(debugger->getDecodeTable());
+                type = "application/json";
+            } else if (path.startsWith("/metrics") || (path == "/")) {
+                body = counters.toPrometheus(debugger->getDecodeTable());
+                type = "text/plain; version=0.0.4";
+            }
+            QByteArray status = body.isEmpty() ? "404 Not Found" : "200 OK";
+            socket->write("HTTP/1.0 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: "
+                + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+
+// Write the counters to a file: JSON for a .json file, Prometheus text otherwise
+bool MetricsServer::writeFile(Debugger* debugger, const QString& filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    const PerfCounters& counters = debugger->getCounters();
+    const uint8_t* operations = debugger->getDecodeTable();
+    file.write(filename.endsWith(".json", Qt::CaseInsensitive) ? counters.toJson(operations) : counters.toPrometheus(operations));
+    return true;
+}
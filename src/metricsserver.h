@@ -0,0 +1,36 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include "debugger.h"
+
+class QTcpServer;
+
+// MetricsServer: serves the debugger performance counters over HTTP on a local port.
+// GET /metrics answers in the Prometheus text format, GET /metrics.json in JSON. While a run on another thread
+// owns the debugger, it serves the copy of the counters published by the run instead.
+class MetricsServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(Debugger* debugger, QObject* parent = nullptr);
+
+    // Listen on "port" or "host:port"
+    bool listen(const QString& address);
+    QString errorString() const { return error; }
+    // Serve a copy of these counters until clearSnapshot(), instead of reading the debugger
+    void setSnapshot(const PerfCounters& counters);
+    void clearSnapshot() { useSnapshot = false; }
+
+    // Write the counters to a file: JSON for a .json file, Prometheus text otherwise
+    static bool writeFile(Debugger* debugger, const QString& filename);
+
+private slots:
+    void onNewConnection();
+
+private:
+    Debugger* debugger;
+    QTcpServer* server = nullptr;
+    QString error;
+    PerfCounters snapshot;
+    bool useSnapshot = false;
+};
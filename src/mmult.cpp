@@ -0,0 +1,55 @@
+#include "mmult.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define MMULT_SSE2 1
+#endif
+
+// Reference version, one element at a time
+int32_t MatrixMultiplyScalar(const uint8_t* matrix, int stride, const int16_t* vector, int count) {
+    uint32_t sum = 0;
+    for (int i = 0; i < count; ++i) {
+        const uint8_t* element = matrix + i * stride;
+        int16_t value = static_cast<int16_t>((element[2] << 8) | element[3]);
+        sum += static_cast<uint32_t>(vector[i] * value);
+    }
+    return static_cast<int32_t>(sum);
+}
+
+
+#ifdef MMULT_SSE2
+// Row stepping, four longs per 16-byte load: swap the bytes of each word, so the low word of every long
+// lands in the upper 16 bits of its lane, and pmaddwd it with the vector placed in the same halves
+static int32_t MatrixMultiplyRow(const uint8_t* matrix, const int16_t* vector, int count) {
+    alignas(16) int16_t padded[16] = {};
+    for (int i = 0; i < count; ++i)
+        padded[i] = vector[i];
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (int i = 0; i < count; i += 8) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(padded + i));
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix + i * 4));
+        lo = _mm_or_si128(_mm_slli_epi16(lo, 8), _mm_srli_epi16(lo, 8));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(lo, _mm_unpacklo_epi16(zero, a)));
+        if (i + 4 < count) {
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix + i * 4 + 16));
+            hi = _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(hi, 8));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(hi, _mm_unpackhi_epi16(zero, a)));
+        }
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+
+// Dot product of the MMULT instruction; the caller guarantees the loads stay in the buffer
+// (row stepping reads whole 16-byte blocks, up to 12 bytes past the last element)
+int32_t MatrixMultiply(const uint8_t* matrix, int stride, const int16_t* vector, int count) {
+#ifdef MMULT_SSE2
+    if (stride == 4)
+        return MatrixMultiplyRow(matrix, vector, count);
+#endif
+    return MatrixMultiplyScalar(matrix, stride, vector, count);
+}
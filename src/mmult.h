@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+
+// Dot product computed by the MMULT instruction: sum of vector[i] * matrix element i, for 'count' elements.
+// Matrix elements are the low words of big-endian longs, 'stride' bytes apart (4 for row stepping,
+// 4 * width for column stepping). The sum wraps to 32 bits like the hardware result.
+// Row stepping uses an SSE2 kernel when available; the scalar version is the reference.
+int32_t MatrixMultiply(const uint8_t* matrix, int stride, const int16_t* vector, int count);
+int32_t MatrixMultiplyScalar(const uint8_t* matrix, int stride, const int16_t* vector, int count);
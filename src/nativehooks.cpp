@@ -0,0 +1,182 @@
+#include <QStringList>
+#include <cmath>
+#include <cstring>
+#include "nativehooks.h"
+#include "debugger.h"
+
+// Register of the active bank
+int32_t HookContext::reg(int n) const {
+    return debugger.core.active[n & 31];
+}
+
+
+void HookContext::setReg(int n, int32_t value) {
+    debugger.core.active[n & 31] = value;
+}
+
+
+// The emulated memory
+uint8_t* HookContext::memory() const {
+    return MemoryBuffer.data();
+}
+
+
+// True if a range lies inside the memory buffer
+bool HookContext::valid(int adrs, int size) const {
+    return (adrs >= 0) && (size >= 0) && (size <= MemorySize - adrs);
+}
+
+
+// Record bytes changed through memory()
+void HookContext::written(int adrs, int size) {
+    if (size > 0)
+        debugger.HostWritten(adrs, size);
+}
+
+
+// Read a big-endian long; 0 and an error outside the memory
+uint32_t HookContext::readLong(int adrs) {
+    if (!Check(adrs, 4))
+        return 0;
+    const uint8_t* walk = MemoryBuffer.data() + adrs;
+    return (uint32_t(walk[0]) << 24) | (walk[1] << 16) | (walk[2] << 8) | walk[3];
+}
+
+
+// Write a big-endian long
+void HookContext::writeLong(int adrs, uint32_t value) {
+    if (!Check(adrs, 4))
+        return;
+    uint8_t* walk = MemoryBuffer.data() + adrs;
+    walk[0] = value >> 24;
+    walk[1] = (value >> 16) & 0xFF;
+    walk[2] = (value >> 8) & 0xFF;
+    walk[3] = value & 0xFF;
+    written(adrs, 4);
+}
+
+
+// Set a range to a byte value
+void HookContext::fill(int adrs, int size, uint8_t value) {
+    if (!Check(adrs, size))
+        return;
+    std::memset(MemoryBuffer.data() + adrs, value, size);
+    written(adrs, size);
+}
+
+
+// Copy a range, overlapping or not
+void HookContext::copy(int dest, int source, int size) {
+    if (!Check(source, size) || !Check(dest, size))
+        return;
+    std::memmove(MemoryBuffer.data() + dest, MemoryBuffer.data() + source, size);
+    written(dest, size);
+}
+
+
+// Stop the run with an error; the first one is kept
+void HookContext::fail(const QString& message) {
+    if (error.isEmpty())
+        error = message;
+}
+
+
+// Fail unless a range lies inside the memory buffer
+bool HookContext::Check(int adrs, int size) {
+    if (valid(adrs, size))
+        return true;
+    fail(QString("Access outside allocated buffer: $%1, %2 bytes").arg(static_cast<uint32_t>(adrs), 8, 16, QChar('0')).arg(size));
+    return false;
+}
+
+
+// Memory clear or fill
+HookHandler FillHook(int dest, int count, int value) {
+    return [dest, count, value](HookContext& context) {
+        context.fill(context.reg(dest), context.reg(count), static_cast<uint8_t>(context.reg(value)));
+    };
+}
+
+
+// Block copy
+HookHandler CopyHook(int dest, int source, int count) {
+    return [dest, source, count](HookContext& context) {
+        context.copy(context.reg(dest), context.reg(source), context.reg(count));
+    };
+}
+
+
+// Fixed-point square root: floor(sqrt(x << fractionBits)), exact in 64 bits
+HookHandler SqrtHook(int reg, int fractionBits) {
+    return [reg, fractionBits](HookContext& context) {
+        uint64_t x = static_cast<uint64_t>(static_cast<uint32_t>(context.reg(reg))) << fractionBits;
+        uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<double>(x)));
+        const uint64_t largest = 0xFFFFFFFF; // its square still fits
+        if (root > largest)
+            root = largest;
+        while (root * root > x)
+            --root;
+        while ((root < largest) && ((root + 1) * (root + 1) <= x))
+            ++root;
+        context.setReg(reg, static_cast<int32_t>(root));
+    };
+}
+
+
+// Register number from "r0".."r31"; -1 if not one
+static int ParseRegister(const QString& text) {
+    QString name = text.trimmed().toLower();
+    bool ok = false;
+    int n = name.startsWith('r') ? name.mid(1).toInt(&ok) : -1;
+    return (ok && (n >= 0) && (n < 32)) ? n : -1;
+}
+
+
+// Hook from "target:fill|copy|sqrt:arguments[:cycles[:link]]"
+bool ParseHook(const QString& spec, NativeHook& hook, QString& error) {
+    QStringList parts = spec.split(':');
+    if ((parts.size() < 3) || (parts.size() > 5) || parts[0].trimmed().isEmpty()) {
+        error = QString("Hook \"%1\": expected target:fill|copy|sqrt:arguments[:cycles[:link]]").arg(spec);
+        return false;
+    }
+    QString kind = parts[1].trimmed().toLower();
+    QStringList args = parts[2].split(',');
+    std::vector<int> regs;
+    for (const QString& arg : args)
+        regs.push_back(ParseRegister(arg));
+    bool ok = true;
+    if ((kind == "fill") && (regs.size() == 3) && (regs[0] >= 0) && (regs[1] >= 0) && (regs[2] >= 0))
+        hook.handler = FillHook(regs[0], regs[1], regs[2]);
+    else if ((kind == "copy") && (regs.size() == 3) && (regs[0] >= 0) && (regs[1] >= 0) && (regs[2] >= 0))
+        hook.handler = CopyHook(regs[0], regs[1], regs[2]);
+    else if ((kind == "sqrt") && (args.size() == 2) && (regs[0] >= 0)) {
+        int fractionBits = args[1].trimmed().toInt(&ok);
+        ok = ok && (fractionBits >= 0) && (fractionBits <= 32);
+        if (ok)
+            hook.handler = SqrtHook(regs[0], fractionBits);
+    }
+    else
+        ok = false;
+    if (!ok) {
+        error = QString("Hook \"%1\": expected fill:rDest,rCount,rValue, copy:rDest,rSource,rCount or sqrt:rN,fractionBits").arg(spec);
+        return false;
+    }
+    hook.target = parts[0].trimmed();
+    hook.cycles = 0;
+    if ((parts.size() >= 4) && !parts[3].trimmed().isEmpty()) {
+        hook.cycles = parts[3].trimmed().toULongLong(&ok);
+        if (!ok) {
+            error = QString("Hook \"%1\": the cycles are not a number").arg(spec);
+            return false;
+        }
+    }
+    hook.link = -1;
+    if ((parts.size() == 5) && (parts[4].trimmed().toLower() != "stack")) {
+        hook.link = ParseRegister(parts[4]);
+        if (hook.link < 0) {
+            error = QString("Hook \"%1\": the link is a register or \"stack\"").arg(spec);
+            return false;
+        }
+    }
+    return true;
+}
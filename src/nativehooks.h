@@ -0,0 +1,61 @@
+#pragma once
+#include <QString>
+#include <functional>
+#include <cstdint>
+
+class Debugger;
+class HookContext;
+
+using HookHandler = std::function<void(HookContext&)>;
+
+// A native handler replacing the emulation of a routine: when a run reaches the routine's first instruction,
+// the handler is called instead, the declared cycles are charged, and the PC goes to the return address
+struct NativeHook {
+    QString target;     // symbol, or hex address ("$F03400" or "F03400")
+    int link = -1;      // register of the active bank holding the return address; -1 pops it from the r31 stack
+    uint64_t cycles = 0; // modelled cost of a call
+    HookHandler handler;
+    int address = -1;   // resolved from the target once the symbols are known
+};
+
+// HookContext: what a handler sees of the machine. Registers are those of the active bank. Handlers may use the
+// memory buffer directly, after checking the range with valid(), and must then report the bytes they changed
+// with written() so the memory view and the shadow memory see them; fill(), copy() and writeLong() do it
+class HookContext {
+public:
+    HookContext(Debugger& debugger, uint64_t cycles) : debugger(debugger), cycles(cycles) {}
+
+    int32_t reg(int n) const;
+    void setReg(int n, int32_t value);
+
+    uint8_t* memory() const;
+    bool valid(int adrs, int size) const;
+    void written(int adrs, int size);
+    uint32_t readLong(int adrs);
+    void writeLong(int adrs, uint32_t value);
+    void fill(int adrs, int size, uint8_t value);
+    void copy(int dest, int source, int size);
+
+    // Stop the run with an error
+    void fail(const QString& message);
+    QString errorString() const { return error; }
+
+    Debugger& debugger;
+    uint64_t cycles; // charged when the handler returns; the declared cost unless the handler changes it
+
+private:
+    bool Check(int adrs, int size);
+
+    QString error;
+};
+
+// Built-in handlers, taking their arguments from registers of the active bank:
+// r[count] bytes at r[dest] set to the low byte of r[value]
+HookHandler FillHook(int dest, int count, int value);
+// r[count] bytes copied from r[source] to r[dest], overlapping ranges allowed
+HookHandler CopyHook(int dest, int source, int count);
+// Unsigned fixed-point square root of r[reg], with 'fractionBits' bits after the point, in place
+HookHandler SqrtHook(int reg, int fractionBits);
+// Hook from "target:fill|copy|sqrt:arguments[:cycles[:link]]": registers as r0-r31 (plus the number of fraction
+// bits for sqrt), the cycles of a call, the link register or "stack" (the default)
+bool ParseHook(const QString& spec, NativeHook& hook, QString& error);
@@ -0,0 +1,43 @@
+#include <algorithm>
+#include <cmath>
+#include "pacer.h"
+
+const double JaguarClockHz = 26590906.0;
+
+// Start a paced run at 'rate' cycles (or instructions) per second
+void Pacer::start(PaceMode paceMode, double paceRate, int sliceMs) {
+    mode = paceMode;
+    rate = std::max(paceRate, 1.0);
+    slice = std::max(sliceMs, 1) / 1000.0;
+    maxBurst = std::max(slice, 0.05);
+    executed = 0;
+    startTime = Clock::now();
+}
+
+
+// Seconds of host time since start()
+double Pacer::elapsed() const {
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+
+// Work that brings the emulation to the end of the next slice, at most one burst when far behind
+uint64_t Pacer::budget() const {
+    double owed = (elapsed() + slice) * rate - static_cast<double>(executed);
+    if (owed < 1.0)
+        return 0;
+    return static_cast<uint64_t>(std::min(owed, maxBurst * rate));
+}
+
+
+// Seconds the emulation is behind the host clock (negative when ahead)
+double Pacer::lag() const {
+    return elapsed() - emulatedTime();
+}
+
+
+// Milliseconds to wait before the next slice is due; 0 when behind, to catch up after the event loop ran
+int Pacer::delayMs() const {
+    double ahead = -lag();
+    return (ahead > 0) ? static_cast<int>(std::ceil(ahead * 1000.0)) : 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Jaguar system clock (NTSC), the GPU and DSP run at this rate
+extern const double JaguarClockHz;
+
+// Unit the pacer schedules: modelled cycles, or executed instructions
+enum class PaceMode { Cycles, Instructions };
+
+// Pacer: keeps the emulated time in step with the host clock.
+// A paced run is cut into short slices; budget() gives the work that brings the emulation to the end of the
+// next slice, and the caller sleeps until the host clock catches up instead of spinning.
+class Pacer {
+public:
+    // Start a paced run at 'rate' cycles (or instructions) per second
+    void start(PaceMode mode, double rate, int sliceMs = 10);
+    PaceMode getMode() const { return mode; }
+
+    // Work to execute now, in the unit of the mode; 0 when the emulation is ahead
+    uint64_t budget() const;
+    // Record the work executed by the last slice
+    void account(uint64_t units) { executed += units; }
+
+    // Seconds the emulation is behind the host clock (negative when ahead)
+    double lag() const;
+    // Emulated seconds since start()
+    double emulatedTime() const { return executed / rate; }
+    // Milliseconds to wait before the next slice is due
+    int delayMs() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double elapsed() const;
+
+    PaceMode mode = PaceMode::Cycles;
+    double rate = 1.0;
+    double slice = 0.01;            // seconds run ahead of the host clock per slice
+    double maxBurst = 0.05;         // cap of a catch-up slice, so the UI stays responsive
+    uint64_t executed = 0;
+    Clock::time_point startTime;
+};
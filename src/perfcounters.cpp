@@ -0,0 +1,159 @@
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <cstring>
+#include "perfcounters.h"
+#include "instructionmix.h"
+
+static const char* const RegionNames[RegionCount] = { "dram", "cartridge", "tom", "gpu_ram", "jerry", "dsp_ram", "other" };
+
+// Clear all counters
+void PerfCounters::reset() {
+    std::memset(this, 0, sizeof(*this));
+}
+
+
+// Counts per operation of a core's decode table, so DSP runs are named with the DSP mnemonics
+static void OperationCounts(const uint64_t* opcodes, const uint8_t* operations, uint64_t* out) {
+    for (int i = 0; i < InstructionMix::Operations; ++i)
+        out[i] = 0;
+    for (int i = 0; i < 64; ++i)
+        out[operations[i]] += opcodes[i];
+}
+
+
+// Instructions retired, all opcodes
+uint64_t PerfCounters::instructions() const {
+    uint64_t total = 0;
+    for (uint64_t count : opcodes)
+        total += count;
+    return total;
+}
+
+
+// Region of the Jaguar memory map holding an address
+MemoryRegion PerfCounters::regionOf(int adrs) {
+    if ((adrs >= 0) && (adrs < 0x400000))
+        return RegionDRAM;
+    if ((adrs >= 0x800000) && (adrs < 0xE00000))
+        return RegionCartridge;
+    if ((adrs >= 0xF03000) && (adrs < 0xF04000))
+        return RegionGPURAM;
+    if ((adrs >= 0xF00000) && (adrs < 0xF10000))
+        return RegionTOM;
+    if ((adrs >= 0xF1B000) && (adrs < 0xF1D000))
+        return RegionDSPRAM;
+    if ((adrs >= 0xF10000) && (adrs < 0xF20000))
+        return RegionJERRY;
+    return RegionOther;
+}
+
+
+// Label of a region in the exports
+const char* PerfCounters::regionName(int region) {
+    return RegionNames[region];
+}
+
+
+// JSON object of all counters, zero opcode counts left out
+QByteArray PerfCounters::toJson(const uint8_t* operations) const {
+    QJsonObject root;
+    root["instructions"] = static_cast<double>(instructions());
+    root["cycles"] = static_cast<double>(cycles);
+    root["runs"] = static_cast<double>(runs);
+    root["host_seconds"] = hostNanoseconds / 1e9;
+    root["mips"] = hostNanoseconds ? instructions() * 1000.0 / hostNanoseconds : 0.0;
+    root["bank_switches"] = static_cast<double>(bankSwitches);
+    root["delay_slot_jumps"] = static_cast<double>(delaySlotJumps);
+    root["diagnostics"] = static_cast<double>(diagnostics);
+    root["bus_fetch_cycles"] = static_cast<double>(busFetchCycles);
+    root["bus_data_cycles"] = static_cast<double>(busDataCycles);
+    root["uninitialized_reads"] = static_cast<double>(uninitializedReads);
+    root["bounds_violations"] = static_cast<double>(boundsViolations);
+    root["idle_skips"] = static_cast<double>(idleSkips);
+    root["idle_instructions"] = static_cast<double>(idleInstructions);
+    root["hook_calls"] = static_cast<double>(hookCalls);
+    root["hook_cycles"] = static_cast<double>(hookCycles);
+    QJsonObject ops, loadCounts, storeCounts;
+    uint64_t perOperation[InstructionMix::Operations];
+    OperationCounts(opcodes, operations, perOperation);
+    for (int i = 0; i < InstructionMix::Operations; ++i) {
+        if (perOperation[i])
+            ops[InstructionMix::operationName(i)] = static_cast<double>(perOperation[i]);
+    }
+    for (int i = 0; i < RegionCount; ++i) {
+        loadCounts[RegionNames[i]] = static_cast<double>(loads[i]);
+        storeCounts[RegionNames[i]] = static_cast<double>(stores[i]);
+    }
+    QJsonArray irqs;
+    for (int i = 0; i < InterruptSources; ++i) {
+        if (!interrupts[i])
+            continue;
+        QJsonObject irq;
+        irq["source"] = i;
+        irq["taken"] = static_cast<double>(interrupts[i]);
+        irq["latency_cycles"] = static_cast<double>(interruptLatency[i]);
+        irq["latency_max"] = static_cast<double>(interruptLatencyMax[i]);
+        irq["handler_cycles"] = static_cast<double>(interruptHandler[i]);
+        irq["handler_max"] = static_cast<double>(interruptHandlerMax[i]);
+        irqs.append(irq);
+    }
+    root["opcodes"] = ops;
+    root["loads"] = loadCounts;
+    root["stores"] = storeCounts;
+    root["interrupts"] = irqs;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+
+// Prometheus text exposition format
+QByteArray PerfCounters::toPrometheus(const uint8_t* operations) const {
+    QByteArray text;
+    auto counter = [&text](const char* name, const char* help, uint64_t value) {
+        text += QByteArray("# HELP ") + name + ' ' + help + "\n# TYPE " + name + " counter\n";
+        text += QByteArray(name) + ' ' + QByteArray::number(static_cast<qulonglong>(value)) + '\n';
+    };
+    counter("jrisc_instructions_total", "Instructions retired.", instructions());
+    counter("jrisc_cycles_total", "Modelled cycles.", cycles);
+    counter("jrisc_runs_total", "Runs of the interpreter loop.", runs);
+    text += "# HELP jrisc_host_seconds_total Host time spent running.\n# TYPE jrisc_host_seconds_total counter\n";
+    text += "jrisc_host_seconds_total " + QByteArray::number(hostNanoseconds / 1e9, 'f', 6) + '\n';
+    counter("jrisc_bank_switches_total", "Register bank switches.", bankSwitches);
+    counter("jrisc_delay_slot_jumps_total", "Jumps taken after their delay slot.", delaySlotJumps);
+    counter("jrisc_diagnostics_total", "Warnings and errors reported.", diagnostics);
+    counter("jrisc_bus_fetch_cycles_total", "Wait states of instruction fetches outside local RAM.", busFetchCycles);
+    counter("jrisc_bus_data_cycles_total", "Wait states of data accesses outside local RAM.", busDataCycles);
+    counter("jrisc_uninitialized_reads_total", "Shadow check: reads of bytes never written.", uninitializedReads);
+    counter("jrisc_bounds_violations_total", "Shadow check: accesses in the red zone of a declared buffer.", boundsViolations);
+    counter("jrisc_idle_skips_total", "Idle loops fast-forwarded.", idleSkips);
+    counter("jrisc_idle_instructions_total", "Instructions of idle loops accounted for without being run.", idleInstructions);
+    counter("jrisc_hook_calls_total", "Native hooks run in place of routines.", hookCalls);
+    counter("jrisc_hook_cycles_total", "Modelled cycles charged by the native hooks.", hookCycles);
+
+    text += "# HELP jrisc_opcode_total Instructions retired per opcode.\n# TYPE jrisc_opcode_total counter\n";
+    uint64_t perOperation[InstructionMix::Operations];
+    OperationCounts(opcodes, operations, perOperation);
+    for (int i = 0; i < InstructionMix::Operations; ++i) {
+        if (perOperation[i])
+            text += QByteArray("jrisc_opcode_total{opcode=\"") + InstructionMix::operationName(i) + "\"} " + QByteArray::number(static_cast<qulonglong>(perOperation[i])) + '\n';
+    }
+    text += "# HELP jrisc_loads_total Data reads per memory region.\n# TYPE jrisc_loads_total counter\n";
+    for (int i = 0; i < RegionCount; ++i)
+        text += QByteArray("jrisc_loads_total{region=\"") + RegionNames[i] + "\"} " + QByteArray::number(static_cast<qulonglong>(loads[i])) + '\n';
+    text += "# HELP jrisc_stores_total Data writes per memory region.\n# TYPE jrisc_stores_total counter\n";
+    for (int i = 0; i < RegionCount; ++i)
+        text += QByteArray("jrisc_stores_total{region=\"") + RegionNames[i] + "\"} " + QByteArray::number(static_cast<qulonglong>(stores[i])) + '\n';
+    auto perSource = [&text, this](const char* name, const char* type, const char* help, const uint64_t* values) {
+        text += QByteArray("# HELP ") + name + ' ' + help + "\n# TYPE " + name + ' ' + type + '\n';
+        for (int i = 0; i < InterruptSources; ++i) {
+            if (interrupts[i])
+                text += QByteArray(name) + "{source=\"" + QByteArray::number(i) + "\"} " + QByteArray::number(static_cast<qulonglong>(values[i])) + '\n';
+        }
+    };
+    perSource("jrisc_interrupts_total", "counter", "Interrupts taken per source.", interrupts);
+    perSource("jrisc_interrupt_latency_cycles_total", "counter", "Cycles from the latch being set to the handler entry.", interruptLatency);
+    perSource("jrisc_interrupt_latency_cycles_max", "gauge", "Longest interrupt latency.", interruptLatencyMax);
+    perSource("jrisc_interrupt_handler_cycles_total", "counter", "Cycles from the handler entry to IMASK being cleared.", interruptHandler);
+    perSource("jrisc_interrupt_handler_cycles_max", "gauge", "Longest interrupt handler.", interruptHandlerMax);
+    return text;
+}
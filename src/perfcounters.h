@@ -0,0 +1,46 @@
+#pragma once
+#include <QByteArray>
+#include <cstdint>
+
+// Memory areas the load and store counters are split by
+enum MemoryRegion { RegionDRAM, RegionCartridge, RegionTOM, RegionGPURAM, RegionJERRY, RegionDSPRAM, RegionOther, RegionCount };
+
+// PerfCounters: statistics maintained by the interpreter; plain increments, no locking or timing per instruction.
+// Instructions retired is the sum of the per-opcode counts, so an instruction costs a single increment.
+struct PerfCounters {
+    static const int InterruptSources = 6; // most interrupt sources of a core, the DSP's
+
+    uint64_t opcodes[64];               // executed instructions per opcode
+    uint64_t loads[RegionCount];        // data reads per region
+    uint64_t stores[RegionCount];       // data writes per region
+    uint64_t bankSwitches;              // REGPAGE changes of the register bank
+    uint64_t delaySlotJumps;            // jumps taken after their delay slot
+    uint64_t diagnostics;               // warnings and errors reported
+    uint64_t busFetchCycles;            // wait states of instruction fetches outside local RAM
+    uint64_t busDataCycles;             // wait states of data accesses outside local RAM
+    uint64_t uninitializedReads;        // shadow check: reads of bytes never written
+    uint64_t boundsViolations;          // shadow check: accesses in the red zone of a declared buffer
+    uint64_t idleSkips;                 // idle loops fast-forwarded
+    uint64_t idleInstructions;          // instructions accounted for without being run
+    uint64_t hookCalls;                 // native hooks run in place of routines
+    uint64_t hookCycles;                // modelled cycles charged by the hooks
+    uint64_t interrupts[InterruptSources];        // interrupts taken per source
+    uint64_t interruptLatency[InterruptSources];  // cycles from the latch being set to the handler entry
+    uint64_t interruptLatencyMax[InterruptSources];
+    uint64_t interruptHandler[InterruptSources];  // cycles from the handler entry to IMASK being cleared
+    uint64_t interruptHandlerMax[InterruptSources];
+    uint64_t runs;                      // execute() calls
+    uint64_t hostNanoseconds;           // host time spent in execute()
+    uint64_t cycles;                    // modelled cycles, copied when exporting
+
+    PerfCounters() { reset(); }
+    void reset();
+
+    uint64_t instructions() const;
+    static MemoryRegion regionOf(int adrs);
+    static const char* regionName(int region);
+
+    // Exports; 'operations' is the decode table of the core that ran, which names the opcodes
+    QByteArray toJson(const uint8_t* operations) const;
+    QByteArray toPrometheus(const uint8_t* operations) const;
+};
@@ -0,0 +1,301 @@
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <algorithm>
+#include "profiler.h"
+
+// Parse the idioms; the ones not listed are off
+bool CallIdioms::parse(const QString& spec, QString* error) {
+    CallIdioms parsed;
+    parsed.symbols = parsed.link = false;
+    for (const QString& part : spec.split(',')) {
+        QString item = part.trimmed();
+        bool ok = true;
+        if (item == "symbols")
+            parsed.symbols = true;
+        else if (item == "link")
+            parsed.link = true;
+        else if (item.startsWith("window="))
+            parsed.returnWindow = item.mid(7).toInt(&ok, 0);
+        else if (item != "none")
+            ok = false;
+        if (!ok || (parsed.returnWindow < 0)) {
+            if (error)
+                *error = QString("Call idioms \"%1\": expected symbols, link, window=N or none").arg(spec);
+            return false;
+        }
+    }
+    *this = parsed;
+    return true;
+}
+
+
+// Quote a name for JSON
+static QString JsonString(const QString& text) {
+    QString out = "\"";
+    for (QChar c : text) {
+        if ((c == '"') || (c == '\\'))
+            out += '\\';
+        if (c.unicode() < 0x20)
+            out += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            out += c;
+    }
+    return out + "\"";
+}
+
+
+// Turning the profiler on starts from nothing recorded
+void Profiler::setEnabled(bool enable) {
+    enabled = enable;
+    if (!enabled) {
+        nodes.clear();
+        children.clear();
+        stack.clear();
+        trace.clear();
+    }
+}
+
+
+// Keep the sorted entries of the global code symbols
+void Profiler::setFunctions(const SymbolTable& symbols) {
+    functions.clear();
+    for (const Symbol& sym : symbols.all()) {
+        if ((sym.kind == SymbolKind::Code) && sym.global)
+            functions.push_back(sym.address);
+    }
+    std::sort(functions.begin(), functions.end());
+    functions.erase(std::unique(functions.begin(), functions.end()), functions.end());
+}
+
+
+// Whether a global code symbol starts at the address
+bool Profiler::isFunction(int adrs) const {
+    return std::binary_search(functions.begin(), functions.end(), adrs);
+}
+
+
+// Nearest global code symbol at or before the address
+int Profiler::functionOf(int adrs) const {
+    auto it = std::upper_bound(functions.begin(), functions.end(), adrs);
+    return (it == functions.begin()) ? -1 : *(it - 1);
+}
+
+
+// Start a new tree with a single root frame
+void Profiler::clear(int root, uint64_t instructions, uint64_t cycles) {
+    nodes.assign(1, Node{ root, -1, 1, 0, 0 });
+    children.clear();
+    stack.assign(1, Frame{ 0, -1, -1 });
+    trace.clear();
+    traceDropped = 0;
+    lastInstructions = instructions;
+    lastCycles = cycles;
+    trace.push_back({ cycles, 0, true });
+}
+
+
+// Close every frame but the root, as when the program restarts
+void Profiler::unwind(uint64_t instructions, uint64_t cycles) {
+    account(instructions, cycles);
+    while (stack.size() > 1)
+        Pop(cycles);
+}
+
+
+// Push a frame for the function at 'entry'; a return reaching [returnLow, returnHigh] pops it
+void Profiler::call(int entry, int returnLow, int returnHigh, uint64_t instructions, uint64_t cycles) {
+    account(instructions, cycles);
+    if (stack.empty() || (stack.size() >= static_cast<size_t>(MaxDepth)))
+        return;
+    int node = Child(stack.back().node, entry);
+    ++nodes[node].calls;
+    stack.push_back({ node, returnLow, returnHigh });
+    if (trace.size() < static_cast<size_t>(MaxTraceEvents))
+        trace.push_back({ cycles, node, true });
+    else
+        ++traceDropped;
+}
+
+
+// Pop the frames up to the innermost one returning to the address; false if none does
+bool Profiler::returnTo(int adrs, uint64_t instructions, uint64_t cycles) {
+    for (size_t i = stack.size(); i-- > 1;) {
+        if ((adrs >= stack[i].returnLow) && (adrs <= stack[i].returnHigh)) {
+            account(instructions, cycles);
+            while (stack.size() > i)
+                Pop(cycles);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Charge what ran since the last event to the innermost frame; totals going back (a counter reset) only resync
+void Profiler::account(uint64_t instructions, uint64_t cycles) {
+    if (!stack.empty() && (instructions >= lastInstructions) && (cycles >= lastCycles)) {
+        Node& node = nodes[stack.back().node];
+        node.instructions += instructions - lastInstructions;
+        node.cycles += cycles - lastCycles;
+    }
+    lastInstructions = instructions;
+    lastCycles = cycles;
+}
+
+
+// Node of a callee under a caller, created on its first call
+int Profiler::Child(int parent, int entry) {
+    qint64 key = (static_cast<qint64>(parent) << 32) | static_cast<uint32_t>(entry);
+    int node = children.value(key, -1);
+    if (node < 0) {
+        node = static_cast<int>(nodes.size());
+        nodes.push_back(Node{ entry, parent, 0, 0, 0 });
+        children.insert(key, node);
+    }
+    return node;
+}
+
+
+// Close the innermost frame
+void Profiler::Pop(uint64_t cycles) {
+    if (trace.size() < static_cast<size_t>(MaxTraceEvents))
+        trace.push_back({ cycles, stack.back().node, false });
+    else
+        ++traceDropped;
+    stack.pop_back();
+}
+
+
+// Inclusive totals: children come after their parent, so one backward pass adds each node to its parent
+void Profiler::Inclusive(std::vector<uint64_t>& instructions, std::vector<uint64_t>& cycles) const {
+    instructions.resize(nodes.size());
+    cycles.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        instructions[i] = nodes[i].instructions;
+        cycles[i] = nodes[i].cycles;
+    }
+    for (size_t i = nodes.size(); i-- > 1;) {
+        instructions[nodes[i].parent] += instructions[i];
+        cycles[nodes[i].parent] += cycles[i];
+    }
+}
+
+
+// Symbol of a function entry, without the separator of the collapsed format
+QString Profiler::Name(const SymbolTable& symbols, int entry) const {
+    return symbols.symbolize(entry).replace(';', ':');
+}
+
+
+// One line per call path with exclusive cycles
+bool Profiler::writeCollapsed(const QString& filename, const SymbolTable& symbols) const {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(filename));
+    QTextStream out(&file);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (!nodes[i].cycles)
+            continue;
+        QStringList path;
+        for (int n = static_cast<int>(i); n >= 0; n = nodes[n].parent)
+            path.prepend(Name(symbols, nodes[n].entry));
+        out << path.join(';') << " " << nodes[i].cycles << "\n";
+    }
+    out.flush();
+    if (file.error() != QFile::NoError)
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// Begin and end events on one track; the frames still open are closed at the last cycle accounted
+bool Profiler::writeTrace(const QString& filename, const SymbolTable& symbols, double clockHz) const {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(filename));
+    QTextStream out(&file);
+    auto event = [&](int node, bool begin, uint64_t cycle) {
+        out << "{\"name\":" << JsonString(Name(symbols, nodes[node].entry)) << ",\"cat\":\"call\",\"ph\":\""
+            << (begin ? "B" : "E") << "\",\"ts\":" << QString::number(cycle * 1e6 / clockHz, 'f', 3)
+            << ",\"pid\":1,\"tid\":1},\n";
+    };
+    out << "{\"traceEvents\":[\n";
+    std::vector<int> open;
+    for (const TraceEvent& e : trace) {
+        event(e.node, e.begin, e.cycle);
+        if (e.begin)
+            open.push_back(e.node);
+        else if (!open.empty())
+            open.pop_back();
+    }
+    while (!open.empty()) {
+        event(open.back(), false, lastCycles);
+        open.pop_back();
+    }
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Jaguar RISC\"}}\n";
+    out << "],\"displayTimeUnit\":\"ns\",\"droppedEvents\":" << traceDropped << "}\n";
+    out.flush();
+    if (file.error() != QFile::NoError)
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// Sum the nodes of each function; a node nested in a call of the same function is inside its inclusive cost already
+bool Profiler::writeReport(const QString& filename, const SymbolTable& symbols) const {
+    struct Totals {
+        int entry;
+        uint64_t calls, instructions, cycles, inclusiveInstructions, inclusiveCycles;
+    };
+    std::vector<uint64_t> inclusiveInstructions, inclusiveCycles;
+    Inclusive(inclusiveInstructions, inclusiveCycles);
+    std::vector<Totals> functionTotals;
+    QHash<int, int> index;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        int f = index.value(nodes[i].entry, -1);
+        if (f < 0) {
+            f = static_cast<int>(functionTotals.size());
+            functionTotals.push_back(Totals{ nodes[i].entry, 0, 0, 0, 0, 0 });
+            index.insert(nodes[i].entry, f);
+        }
+        Totals& t = functionTotals[f];
+        t.calls += nodes[i].calls;
+        t.instructions += nodes[i].instructions;
+        t.cycles += nodes[i].cycles;
+        bool nested = false;
+        for (int n = nodes[i].parent; (n >= 0) && !nested; n = nodes[n].parent)
+            nested = (nodes[n].entry == nodes[i].entry);
+        if (!nested) {
+            t.inclusiveInstructions += inclusiveInstructions[i];
+            t.inclusiveCycles += inclusiveCycles[i];
+        }
+    }
+    std::sort(functionTotals.begin(), functionTotals.end(), [](const Totals& a, const Totals& b) {
+        return a.inclusiveCycles > b.inclusiveCycles;
+    });
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return fail(QString("Cannot write %1").arg(filename));
+    QTextStream out(&file);
+    out << QString("%1 %2 %3 %4 %5 %6\n").arg("Function", -32).arg("Calls", 10).arg("Incl. cycles", 14)
+           .arg("Excl. cycles", 14).arg("Incl. instr", 14).arg("Excl. instr", 14);
+    for (const Totals& t : functionTotals) {
+        out << QString("%1 %2 %3 %4 %5 %6\n").arg(Name(symbols, t.entry), -32).arg(t.calls, 10)
+               .arg(t.inclusiveCycles, 14).arg(t.cycles, 14).arg(t.inclusiveInstructions, 14).arg(t.instructions, 14);
+    }
+    if (traceDropped)
+        out << "\n" << traceDropped << " trace events dropped after the first " << MaxTraceEvents << "\n";
+    out.flush();
+    if (file.error() != QFile::NoError)
+        return fail(QString("Error while writing %1").arg(filename));
+    return true;
+}
+
+
+// Record an error for errorString(); returns false
+bool Profiler::fail(const QString& message) const {
+    error = message;
+    return false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <QString>
+#include <QHash>
+#include <vector>
+#include <cstdint>
+#include "symbols.h"
+
+// Call and return idioms the profiler recognizes; the RISC cores have no call instruction
+struct CallIdioms {
+    bool symbols = true;    // a jump or jr to the entry of a global code symbol, from outside it, is a call
+    bool link = true;       // a jump (Rn) with a "move PC,Rm" in the 3 instructions before it is a call
+    int returnWindow = 16;  // a jump (Rn) landing up to this many bytes after a call's delay slot returns from it
+
+    // "symbols", "link" and "window=N", comma-separated; "none" turns the call idioms off
+    bool parse(const QString& spec, QString* error);
+};
+
+// Profiler: shadow call stack and call tree. The debugger reports taken jumps, interrupts and hooks; the
+// instructions and cycles between two events go to the function on top of the stack (exclusive), and up the
+// tree to its callers (inclusive). A return pops every frame above the one whose return address it reaches,
+// so tail calls and unwinds through a saved r31 stack keep the stack in step.
+class Profiler {
+public:
+    static const int MaxDepth = 256;              // calls deeper than this are not pushed
+    static const int MaxTraceEvents = 1 << 20;    // trace events kept; the profile itself is never truncated
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    void setIdioms(const CallIdioms& value) { callIdioms = value; }
+    const CallIdioms& idioms() const { return callIdioms; }
+    // Entries of the global code symbols, for the symbol idiom; local labels are branch targets, not functions
+    void setFunctions(const SymbolTable& symbols);
+    bool isFunction(int adrs) const;
+    // Entry of the function holding an address, -1 before the first one
+    int functionOf(int adrs) const;
+
+    // Forget the tree; the stack restarts with the function at 'root'
+    void clear(int root, uint64_t instructions, uint64_t cycles);
+    // Back to the root frame, keeping what was recorded
+    void unwind(uint64_t instructions, uint64_t cycles);
+
+    // Events, with the instruction and cycle totals at the time they happen
+    void call(int entry, int returnLow, int returnHigh, uint64_t instructions, uint64_t cycles);
+    bool returnTo(int adrs, uint64_t instructions, uint64_t cycles);
+    void account(uint64_t instructions, uint64_t cycles);
+
+    int depth() const { return static_cast<int>(stack.size()); }
+    int nodeCount() const { return static_cast<int>(nodes.size()); }
+
+    // Collapsed stacks for flamegraph.pl and speedscope: "root;caller;callee cycles", exclusive
+    bool writeCollapsed(const QString& filename, const SymbolTable& symbols) const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto), one begin/end pair per call, in microseconds
+    bool writeTrace(const QString& filename, const SymbolTable& symbols, double clockHz) const;
+    // Per-function calls, inclusive and exclusive instructions and cycles, the most expensive first
+    bool writeReport(const QString& filename, const SymbolTable& symbols) const;
+
+    QString errorString() const { return error; }
+
+private:
+    struct Node {
+        int entry;
+        int parent;
+        uint64_t calls;
+        uint64_t instructions;  // exclusive
+        uint64_t cycles;
+    };
+    struct Frame {
+        int node;
+        int returnLow;
+        int returnHigh;
+    };
+    struct TraceEvent {
+        uint64_t cycle;
+        int node;
+        bool begin;
+    };
+    int Child(int parent, int entry);
+    void Pop(uint64_t cycles);
+    void Inclusive(std::vector<uint64_t>& instructions, std::vector<uint64_t>& cycles) const;
+    QString Name(const SymbolTable& symbols, int entry) const;
+    bool fail(const QString& message) const;
+
+    bool enabled = false;
+    CallIdioms callIdioms;
+    std::vector<int> functions;         // sorted global code symbol entries
+    std::vector<Node> nodes;            // parents before children; node 0 is the root
+    QHash<qint64, int> children;        // (parent, entry) to node
+    std::vector<Frame> stack;
+    std::vector<TraceEvent> trace;
+    uint64_t lastInstructions = 0;
+    uint64_t lastCycles = 0;
+    uint64_t traceDropped = 0;
+    mutable QString error;
+};
@@ -0,0 +1,281 @@
+#include <QFile>
+#include <QByteArray>
+#include <algorithm>
+#include <cstring>
+#include "savestate.h"
+
+// Header flags
+static const uint32_t StateCompressed = 1;
+// Set in the kind field of a global symbol; the kinds themselves use the low bits
+static const uint32_t SymbolGlobal = 0x100;
+
+// Append big-endian values and length-prefixed UTF-8 strings
+static void Put32(QByteArray& out, uint32_t value) {
+    char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+    out.append(bytes, 4);
+}
+
+static void Put64(QByteArray& out, uint64_t value) {
+    Put32(out, static_cast<uint32_t>(value >> 32));
+    Put32(out, static_cast<uint32_t>(value));
+}
+
+static void PutString(QByteArray& out, const QString& text) {
+    QByteArray utf8 = text.toUtf8();
+    Put32(out, static_cast<uint32_t>(utf8.size()));
+    out.append(utf8);
+}
+
+// Bounds-checked reader over the mapped file; after the first overrun every read returns 0 and 'ok' stays false
+struct StateReader {
+    const uint8_t* data;
+    qint64 size;
+    qint64 pos = 0;
+    bool ok = true;
+
+    StateReader(const uint8_t* d, qint64 s) : data(d), size(s) {}
+
+    const uint8_t* take(qint64 length) {
+        if (!ok || (length < 0) || (length > size - pos)) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* p = data + pos;
+        pos += length;
+        return p;
+    }
+    uint32_t get32() {
+        const uint8_t* p = take(4);
+        return p ? (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3] : 0;
+    }
+    uint64_t get64() {
+        uint64_t high = get32();
+        return (high << 32) | get32();
+    }
+    QString getString() {
+        uint32_t length = get32();
+        const uint8_t* p = take(length);
+        return p ? QString::fromUtf8(reinterpret_cast<const char*>(p), static_cast<int>(length)) : QString();
+    }
+};
+
+
+// Write the state and the non-zero pages of the memory
+bool SaveStateFile::write(const QString& filename, const MachineState& state, const uint8_t* memory, int size, bool compress) {
+    error.clear();
+    pages = 0;
+    stored.assign(((size + PageSize - 1) / PageSize + 31) / 32, 0);
+
+    QByteArray header;
+    Put32(header, Magic);
+    Put32(header, Version);
+    Put32(header, compress ? StateCompressed : 0);
+    Put32(header, PageSize);
+    Put32(header, static_cast<uint32_t>(size));
+
+    Put32(header, state.gpuMode ? 1 : 0);
+    Put32(header, static_cast<uint32_t>(state.pc));
+    Put32(header, static_cast<uint32_t>(state.jumpTarget));
+    Put32(header, state.jumpPending ? 1 : 0);
+    Put32(header, static_cast<uint32_t>(state.loadAddress));
+    Put64(header, state.cycleCount);
+    for (int b = 0; b < 2; ++b) {
+        for (int r = 0; r < 32; ++r)
+            Put32(header, static_cast<uint32_t>(state.regs[b][r]));
+    }
+    Put32(header, static_cast<uint32_t>(state.bank));
+    Put32(header, state.zResult);
+    Put32(header, static_cast<uint32_t>(state.nResult));
+    Put64(header, state.carry);
+    Put64(header, static_cast<uint64_t>(state.accumulator));
+
+    Put32(header, static_cast<uint32_t>(state.segments.size()));
+    for (const Segment& seg : state.segments) {
+        PutString(header, seg.name);
+        Put32(header, static_cast<uint32_t>(seg.kind));
+        Put32(header, static_cast<uint32_t>(seg.address));
+        Put32(header, static_cast<uint32_t>(seg.size));
+    }
+    Put32(header, static_cast<uint32_t>(state.symbols.size()));
+    for (const Symbol& sym : state.symbols) {
+        PutString(header, sym.name);
+        Put32(header, static_cast<uint32_t>(sym.address));
+        Put32(header, static_cast<uint32_t>(sym.size));
+        Put32(header, static_cast<uint32_t>(sym.kind) | (sym.global ? SymbolGlobal : 0));
+    }
+
+    // Page table (index, stored size) then the page contents; a stored size of PageSize means raw
+    static const uint8_t zeroPage[PageSize] = {};
+    QByteArray table, contents;
+    int pageTotal = (size + PageSize - 1) / PageSize;
+    for (int i = 0; i < pageTotal; ++i) {
+        const uint8_t* page = memory + i * PageSize;
+        int length = std::min(PageSize, size - i * PageSize);
+        if (std::memcmp(page, zeroPage, length) == 0)
+            continue;
+        QByteArray packed;
+        if (compress && (length == PageSize))
+            packed = qCompress(page, length);
+        if (packed.isEmpty() || (packed.size() >= PageSize))
+            packed = QByteArray(reinterpret_cast<const char*>(page), length);
+        Put32(table, static_cast<uint32_t>(i));
+        Put32(table, static_cast<uint32_t>(packed.size()));
+        contents.append(packed);
+        Store(i);
+    }
+    Put32(header, static_cast<uint32_t>(pages));
+    header.append(table);
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(QString("Cannot write %1").arg(filename));
+    if ((file.write(header) != header.size()) || (file.write(contents) != contents.size())) {
+        file.close();
+        return fail(QString("Error while writing %1").arg(filename));
+    }
+    file.close();
+    return true;
+}
+
+
+// Read a state written by write(); the memory must have the size it was saved with
+bool SaveStateFile::read(const QString& filename, MachineState& state, uint8_t* memory, int size) {
+    error.clear();
+    pages = 0;
+    stored.assign(((size + PageSize - 1) / PageSize + 31) / 32, 0);
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(QString("Cannot open %1").arg(filename));
+    qint64 fileSize = file.size();
+    QByteArray fallback;
+    const uint8_t* data = (fileSize > 0) ? file.map(0, fileSize) : nullptr;
+    if (!data) {
+        fallback = file.readAll();
+        data = reinterpret_cast<const uint8_t*>(fallback.constData());
+        fileSize = fallback.size();
+    }
+
+    StateReader in(data, fileSize);
+    if (in.get32() != Magic)
+        return fail("Not a save state file.");
+    uint32_t version = in.get32();
+    if (version != Version)
+        return fail(QString("Save state version %1 is not supported (expected %2).").arg(version).arg(Version));
+    in.get32(); // flags: compression is recorded per page
+    if (in.get32() != static_cast<uint32_t>(PageSize))
+        return fail("Unsupported save state page size.");
+    uint32_t memorySize = in.get32();
+    if (memorySize != static_cast<uint32_t>(size))
+        return fail(QString("The save state holds $%1 bytes of memory, $%2 expected.")
+                    .arg(memorySize, 0, 16).arg(size, 0, 16));
+
+    MachineState loaded;
+    loaded.gpuMode = in.get32() != 0;
+    loaded.pc = static_cast<int>(in.get32());
+    loaded.jumpTarget = static_cast<int>(in.get32());
+    loaded.jumpPending = in.get32() != 0;
+    loaded.loadAddress = static_cast<int>(in.get32());
+    loaded.cycleCount = in.get64();
+    for (int b = 0; b < 2; ++b) {
+        for (int r = 0; r < 32; ++r)
+            loaded.regs[b][r] = static_cast<int32_t>(in.get32());
+    }
+    loaded.bank = static_cast<int>(in.get32() & 1);
+    loaded.zResult = in.get32();
+    loaded.nResult = static_cast<int32_t>(in.get32());
+    loaded.carry = in.get64() & (1ull << 32);
+    loaded.accumulator = static_cast<int64_t>(in.get64());
+
+    uint32_t count = in.get32();
+    for (uint32_t i = 0; in.ok && (i < count); ++i) {
+        Segment seg;
+        seg.name = in.getString();
+        uint32_t kind = in.get32();
+        seg.kind = (kind == 0) ? SegmentKind::Text : (kind == 1) ? SegmentKind::Data : SegmentKind::Bss;
+        seg.address = static_cast<int>(in.get32());
+        seg.size = static_cast<int>(in.get32());
+        if ((seg.address < 0) || (seg.size < 0) || (seg.size > size - seg.address))
+            return fail("Save state segment outside memory.");
+        loaded.segments.push_back(seg);
+    }
+    count = in.get32();
+    for (uint32_t i = 0; in.ok && (i < count); ++i) {
+        Symbol sym;
+        sym.name = in.getString();
+        sym.address = static_cast<int>(in.get32());
+        sym.size = static_cast<int>(in.get32());
+        uint32_t kind = in.get32();
+        sym.global = (kind & SymbolGlobal) != 0;
+        kind &= ~SymbolGlobal;
+        sym.kind = (kind == 0) ? SymbolKind::Code : (kind == 1) ? SymbolKind::Data
+                 : (kind == 2) ? SymbolKind::Absolute : SymbolKind::Label;
+        loaded.symbols.push_back(sym);
+    }
+
+    // Validate the page table, locate every page and inflate the compressed ones before touching the memory
+    struct Page { int index; int length; const uint8_t* data; size_t inflated; };
+    std::vector<Page> table;
+    count = in.get32();
+    int pageTotal = (size + PageSize - 1) / PageSize;
+    if (count > static_cast<uint32_t>(pageTotal))
+        return fail("Corrupt save state page table.");
+    table.reserve(count);
+    for (uint32_t i = 0; in.ok && (i < count); ++i) {
+        Page page;
+        page.index = static_cast<int>(in.get32());
+        page.length = static_cast<int>(in.get32());
+        page.data = nullptr;
+        page.inflated = 0;
+        if ((page.index < 0) || (page.index >= pageTotal) || (page.length <= 0) || (page.length > PageSize)
+            || (!table.empty() && (page.index <= table.back().index)))
+            return fail("Corrupt save state page table.");
+        table.push_back(page);
+    }
+    for (Page& page : table)
+        page.data = in.take(page.length);
+    if (!in.ok)
+        return fail("Truncated save state file.");
+    std::vector<uint8_t> inflated;
+    for (Page& page : table) {
+        int length = std::min(PageSize, size - page.index * PageSize);
+        if (page.length == length)
+            continue;
+        QByteArray unpacked = qUncompress(page.data, page.length);
+        if (unpacked.size() != length)
+            return fail(QString("Corrupt page at $%1 in the save state.").arg(page.index * PageSize, 0, 16));
+        page.inflated = inflated.size();
+        inflated.insert(inflated.end(), unpacked.constData(), unpacked.constData() + length);
+    }
+
+    // Pages are in increasing order: clear the gaps, copy the raw and the inflated pages
+    int next = 0;
+    for (const Page& page : table) {
+        if (page.index > next)
+            std::memset(memory + next * PageSize, 0, (page.index - next) * PageSize);
+        int length = std::min(PageSize, size - page.index * PageSize);
+        const uint8_t* source = (page.length == length) ? page.data : inflated.data() + page.inflated;
+        std::memcpy(memory + page.index * PageSize, source, length);
+        next = page.index + 1;
+        Store(page.index);
+    }
+    if (next < pageTotal)
+        std::memset(memory + next * PageSize, 0, size - next * PageSize);
+    file.close();
+    state = loaded;
+    return true;
+}
+
+
+// Count a page written or read, and mark it in the bitmap
+void SaveStateFile::Store(int page) {
+    stored[page >> 5] |= 1u << (page & 31);
+    ++pages;
+}
+
+
+// Record the error message
+bool SaveStateFile::fail(const QString& message) {
+    error = message;
+    return false;
+}
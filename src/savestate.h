@@ -0,0 +1,54 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <cstdint>
+#include "loader.h"
+#include "symbols.h"
+
+// Everything a save state restores besides memory
+struct MachineState {
+    bool gpuMode = true;
+    int pc = 0;
+    int jumpTarget = 0;         // delay-slot state: the jump taken after the next instruction
+    bool jumpPending = false;
+    int loadAddress = 0;        // reset PC
+    uint64_t cycleCount = 0;
+    int32_t regs[2][32] = {};
+    int bank = 0;
+    uint32_t zResult = 1;       // flags in the CoreState form
+    int32_t nResult = 0;
+    uint64_t carry = 0;
+    int64_t accumulator = 0;
+    std::vector<Segment> segments;
+    std::vector<Symbol> symbols;
+};
+
+// SaveStateFile: versioned machine snapshots. The header, registers, segment and symbol tables and the page
+// table are big-endian fields written by hand; the memory follows as 4 KB pages, only those holding a non-zero
+// byte, each raw or zlib-compressed. The reader memory-maps the file and copies raw pages straight into the
+// memory; pages missing from the file are cleared.
+class SaveStateFile {
+public:
+    static const uint32_t Magic = 0x4A525353;  // "JRSS"
+    static const uint32_t Version = 1;
+    static const int PageSize = 4096;
+
+    bool write(const QString& filename, const MachineState& state, const uint8_t* memory, int size, bool compress);
+    // The memory is only written once the whole page table is validated and every page inflated
+    bool read(const QString& filename, MachineState& state, uint8_t* memory, int size);
+
+    // Pages stored by the last write or read
+    int pageCount() const { return pages; }
+    // Bitmap of those pages, 32 per word
+    const std::vector<uint32_t>& storedPages() const { return stored; }
+    QString errorString() const { return error; }
+
+private:
+    bool fail(const QString& message);
+
+    void Store(int page);
+
+    int pages = 0;
+    std::vector<uint32_t> stored;
+    QString error;
+};
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "shadowmemory.h"
+
+// Allocate the bitmaps, nothing written; the red zones of the declared buffers are set again
+void ShadowMemory::resize(int size) {
+    memorySize = size;
+    size_t words = (static_cast<size_t>(size) + 63) / 64;
+    written.assign(words, 0);
+    poisoned.assign(words, 0);
+    if (size == 0) {
+        written.shrink_to_fit();
+        poisoned.shrink_to_fit();
+        return;
+    }
+    Poison();
+}
+
+
+// Forget every write
+void ShadowMemory::clear() {
+    std::fill(written.begin(), written.end(), 0);
+}
+
+
+// Mark a range as written, clipped to the memory
+void ShadowMemory::define(int adrs, int size) {
+    SetBits(written, adrs, size, true);
+}
+
+
+// Mark the whole memory as written
+void ShadowMemory::defineAll() {
+    std::fill(written.begin(), written.end(), ~uint64_t(0));
+}
+
+
+// Declare a buffer: the bytes around it become a red zone
+void ShadowMemory::addBuffer(int address, int length, const QString& name) {
+    buffers.push_back({ address, length, name });
+    Poison();
+}
+
+
+// Remove the declared buffers and their red zones
+void ShadowMemory::clearBuffers() {
+    buffers.clear();
+    Poison();
+}
+
+
+// Buffer whose red zone holds an address, the closest one if red zones overlap; -1 if none
+int ShadowMemory::bufferAt(int adrs) const {
+    int found = -1;
+    int distance = RedZone + 1;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const Buffer& b = buffers[i];
+        int d = (adrs < b.address) ? b.address - adrs : adrs - (b.address + b.length) + 1;
+        if ((d > 0) && (d < distance)) {
+            distance = d;
+            found = static_cast<int>(i);
+        }
+    }
+    return found;
+}
+
+
+// Set or clear the bits of a range, whole words at a time inside it
+void ShadowMemory::SetBits(std::vector<uint64_t>& bits, int adrs, int size, bool value) {
+    int start = std::max(adrs, 0);
+    int end = std::min(adrs + size, memorySize);
+    while (start < end) {
+        int count = std::min(end - start, 64 - (start & 63));
+        uint64_t mask = (count == 64) ? ~uint64_t(0) : (((uint64_t(1) << count) - 1) << (start & 63));
+        if (value)
+            bits[start >> 6] |= mask;
+        else
+            bits[start >> 6] &= ~mask;
+        start += count;
+    }
+}
+
+
+// Rebuild the red zones: RedZone bytes on each side of every buffer, except inside another buffer
+void ShadowMemory::Poison() {
+    std::fill(poisoned.begin(), poisoned.end(), 0);
+    if (poisoned.empty())
+        return;
+    for (const Buffer& b : buffers) {
+        SetBits(poisoned, b.address - RedZone, RedZone, true);
+        SetBits(poisoned, b.address + b.length, RedZone, true);
+    }
+    for (const Buffer& b : buffers)
+        SetBits(poisoned, b.address, b.length, false);
+}
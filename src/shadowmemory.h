@@ -0,0 +1,77 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <cstdint>
+
+// Problem found by the shadow memory check
+enum class ShadowKind { Uninitialized, OutOfBounds };
+
+// First access of a kind made by an instruction
+struct ShadowFinding {
+    ShadowKind kind;
+    int pc;         // instruction making the access
+    int address;
+    int size;
+    bool write;
+    int buffer;     // declared buffer the access overran, or -1
+};
+
+// ShadowMemory: one bit per byte of the memory buffer telling whether it was written (by the loader, a store or
+// the host), and one telling whether it lies in the red zone around a declared buffer. The data accesses of the
+// interpreter are aligned to their size, so the bits of one access always sit in a single 64-bit word: a check
+// is one load, a mask and a compare, whatever the access width.
+class ShadowMemory {
+public:
+    // A buffer declared by the user; accesses in the RedZone bytes around it, outside other buffers, are overruns
+    struct Buffer {
+        int address;
+        int length;
+        QString name;
+    };
+    static const int RedZone = 32;
+
+    // Allocate the shadow of 'size' bytes, nothing written yet; an empty size frees it
+    void resize(int size);
+    bool isEnabled() const { return !written.empty(); }
+    // Forget every write, keep the buffers
+    void clear();
+    // Mark a range as written, or the whole memory
+    void define(int adrs, int size);
+    void defineAll();
+
+    // True if every byte of an aligned access was written and none lies in a red zone
+    bool readable(int adrs, int size) const {
+        uint64_t mask = Mask(adrs, size);
+        size_t i = static_cast<size_t>(adrs) >> 6;
+        return ((written[i] & mask) == mask) && !(poisoned[i] & mask);
+    }
+    // Mark the bytes of an aligned store as written; false if one of them lies in a red zone
+    bool write(int adrs, int size) {
+        uint64_t mask = Mask(adrs, size);
+        size_t i = static_cast<size_t>(adrs) >> 6;
+        written[i] |= mask;
+        return !(poisoned[i] & mask);
+    }
+    // True if one byte of an aligned access lies in a red zone
+    bool isPoisoned(int adrs, int size) const {
+        return (poisoned[static_cast<size_t>(adrs) >> 6] & Mask(adrs, size)) != 0;
+    }
+
+    void addBuffer(int address, int length, const QString& name);
+    void clearBuffers();
+    const std::vector<Buffer>& getBuffers() const { return buffers; }
+    // Buffer whose red zone holds an address, or -1
+    int bufferAt(int adrs) const;
+
+private:
+    static uint64_t Mask(int adrs, int size) {
+        return (((uint64_t(1) << size) - 1)) << (adrs & 63);
+    }
+    void SetBits(std::vector<uint64_t>& bits, int adrs, int size, bool value);
+    void Poison();
+
+    std::vector<uint64_t> written;
+    std::vector<uint64_t> poisoned;
+    std::vector<Buffer> buffers;
+    int memorySize = 0;
+};
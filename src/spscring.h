@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// SpscRing: lock-free queue from one producer thread to one consumer thread, with a power-of-two capacity.
+// Each side owns one index and only reads the other's; the producer keeps a copy of the consumer's index and
+// reloads it only when the ring looks full, so a push is normally a store and a release. Neither side waits:
+// push() fails when the ring is full and pop() returns nothing when it is empty.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : values(capacity), mask(capacity - 1) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: append a value; false if the ring is full
+    bool push(const T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head - tailCache == values.size()) {
+            tailCache = tailIndex.load(std::memory_order_acquire);
+            if (head - tailCache == values.size())
+                return false;
+        }
+        values[head & mask] = value;
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: move up to 'max' values to 'out'; returns how many
+    size_t pop(T* out, size_t max) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t count = headIndex.load(std::memory_order_acquire) - tail;
+        if (count > max)
+            count = max;
+        for (size_t i = 0; i < count; ++i)
+            out[i] = values[(tail + i) & mask];
+        tailIndex.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Either side, only when the other is not running: forget the values queued
+    void reset() {
+        headIndex.store(0, std::memory_order_relaxed);
+        tailIndex.store(0, std::memory_order_relaxed);
+        tailCache = 0;
+    }
+
+private:
+    std::vector<T> values;
+    size_t mask;
+    alignas(64) std::atomic<size_t> headIndex{ 0 };    // written by the producer
+    size_t tailCache = 0;                               // producer's copy of tailIndex
+    alignas(64) std::atomic<size_t> tailIndex{ 0 };    // written by the consumer
+};
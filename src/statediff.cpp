@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstring>
+#include "statediff.h"
+#include "symbols.h"
+#include "debugger.h"
+
+// The page bitmaps of a snapshot come from the dirty pages of the debugger and index the pages of the file
+static_assert(SaveStateFile::PageSize == (1 << Debugger::DirtyPageShift), "The page diff needs the dirty page size");
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define STATEDIFF_SSE2 1
+#endif
+
+#ifdef STATEDIFF_SSE2
+// 0xFF in the lanes of the equal bytes
+static __m128i Equal16(const uint8_t* a, const uint8_t* b) {
+    return _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+}
+
+// Whether 64 bytes are equal: the four compares are folded into one mask
+static bool SameBlock(const uint8_t* a, const uint8_t* b) {
+    __m128i low = _mm_and_si128(Equal16(a, b), Equal16(a + 16, b + 16));
+    __m128i high = _mm_and_si128(Equal16(a + 32, b + 32), Equal16(a + 48, b + 48));
+    return _mm_movemask_epi8(_mm_and_si128(low, high)) == 0xFFFF;
+}
+#else
+static bool SameBlock(const uint8_t* a, const uint8_t* b) {
+    return std::memcmp(a, b, 64) == 0;
+}
+#endif
+
+
+// One bit per differing byte of up to 16
+static int DifferenceMask(const uint8_t* a, const uint8_t* b, int count) {
+#ifdef STATEDIFF_SSE2
+    if (count == 16)
+        return ~_mm_movemask_epi8(Equal16(a, b)) & 0xFFFF;
+#endif
+    int mask = 0;
+    for (int i = 0; i < count; ++i) {
+        if (a[i] != b[i])
+            mask |= 1 << i;
+    }
+    return mask;
+}
+
+
+// "$" and upper-case hex digits
+static QString Hex(uint64_t value, int digits) {
+    return "$" + QString("%1").arg(value, digits, 16, QChar('0')).toUpper();
+}
+
+
+// Compare the registers, flags and pending jump, then the pages marked in either snapshot
+void StateDiff::compare(const MachineSnapshot& before, const MachineSnapshot& after) {
+    registerDiffs.clear();
+    memorySpans.clear();
+    compared = differing = 0;
+
+    const MachineState& a = before.state;
+    const MachineState& b = after.state;
+    CompareRegister("core (1 = GPU)", a.gpuMode, b.gpuMode, 0);
+    CompareRegister("pc", static_cast<uint32_t>(a.pc), static_cast<uint32_t>(b.pc), 8);
+    CompareRegister("jump pending", a.jumpPending, b.jumpPending, 0);
+    if (a.jumpPending || b.jumpPending)
+        CompareRegister("jump target", static_cast<uint32_t>(a.jumpTarget), static_cast<uint32_t>(b.jumpTarget), 8);
+    CompareRegister("bank", a.bank, b.bank, 0);
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int r = 0; r < 32; ++r) {
+            if (a.regs[bank][r] != b.regs[bank][r])
+                CompareRegister(QString("bank %1 r%2").arg(bank).arg(r), static_cast<uint32_t>(a.regs[bank][r]),
+                                static_cast<uint32_t>(b.regs[bank][r]), 8);
+        }
+    }
+    CompareRegister("Z", a.zResult == 0, b.zResult == 0, 0);
+    CompareRegister("N", a.nResult < 0, b.nResult < 0, 0);
+    CompareRegister("C", (a.carry >> 32) & 1, (b.carry >> 32) & 1, 0);
+    CompareRegister("accumulator", static_cast<uint64_t>(a.accumulator), static_cast<uint64_t>(b.accumulator), 16);
+    CompareRegister("cycles", a.cycleCount, b.cycleCount, 0);
+
+    const int size = static_cast<int>(std::min(before.memory.size(), after.memory.size()));
+    const int pageTotal = (size + SaveStateFile::PageSize - 1) / SaveStateFile::PageSize;
+    for (int word = 0; word * 32 < pageTotal; ++word) {
+        uint32_t bits = 0;
+        if (word < static_cast<int>(before.pages.size()))
+            bits |= before.pages[word];
+        if (word < static_cast<int>(after.pages.size()))
+            bits |= after.pages[word];
+        for (int bit = 0; bits && (bit < 32); ++bit, bits >>= 1) {
+            int page = word * 32 + bit;
+            if (!(bits & 1) || (page >= pageTotal))
+                continue;
+            int address = page * SaveStateFile::PageSize;
+            int length = std::min(SaveStateFile::PageSize, size - address);
+            ComparePage(before.memory.data() + address, after.memory.data() + address, address, length);
+            ++compared;
+        }
+    }
+}
+
+
+// Record a register whose value changed
+void StateDiff::CompareRegister(const QString& name, uint64_t before, uint64_t after, int digits) {
+    if (before != after)
+        registerDiffs.push_back({ name, before, after, digits });
+}
+
+
+// Skip the equal 64-byte blocks of a page, then collect the differing bytes 16 at a time
+void StateDiff::ComparePage(const uint8_t* a, const uint8_t* b, int address, int length) {
+    for (int offset = 0; offset < length; offset += 64) {
+        int end = std::min(offset + 64, length);
+        if ((end - offset == 64) && SameBlock(a + offset, b + offset))
+            continue;
+        for (int i = offset; i < end; i += 16) {
+            int mask = DifferenceMask(a + i, b + i, std::min(16, end - i));
+            for (int bit = 0; mask; ++bit, mask >>= 1) {
+                if (mask & 1)
+                    AddByte(address + i + bit);
+            }
+        }
+    }
+}
+
+
+// Extend the last span with a differing byte, or start a new one; bytes arrive in increasing order
+void StateDiff::AddByte(int address) {
+    ++differing;
+    if (!memorySpans.empty()) {
+        MemorySpan& last = memorySpans.back();
+        if (address - (last.address + last.size) < MergeGap) {
+            last.size = address + 1 - last.address;
+            ++last.bytes;
+            return;
+        }
+    }
+    memorySpans.push_back({ address, 1, 1 });
+}
+
+
+// One line per register, a summary, then one line per span named from the symbols of the first snapshot
+QStringList StateDiff::report(const MachineSnapshot& before, int maxSpans) const {
+    SymbolTable symbols;
+    for (const Symbol& sym : before.state.symbols)
+        symbols.add(sym.name, sym.address, sym.kind, sym.size, sym.global);
+    symbols.finalize(before.state.segments);
+
+    QStringList lines;
+    for (const RegisterDiff& reg : registerDiffs) {
+        if (reg.digits)
+            lines << QString("%1: %2 -> %3").arg(reg.name, Hex(reg.before, reg.digits), Hex(reg.after, reg.digits));
+        else
+            lines << QString("%1: %2 -> %3").arg(reg.name).arg(reg.before).arg(reg.after);
+    }
+    lines << QString("Memory: %1 bytes differ in %2 spans (%3 pages compared)")
+             .arg(differing).arg(static_cast<int>(memorySpans.size())).arg(compared);
+    int shown = 0;
+    for (const MemorySpan& span : memorySpans) {
+        if (shown++ == maxSpans) {
+            lines << QString("... %1 more spans").arg(static_cast<int>(memorySpans.size()) - maxSpans);
+            break;
+        }
+        QString where = symbols.symbolize(span.address);
+        for (const Segment& seg : before.state.segments) {
+            if (seg.contains(span.address)) {
+                where += QString(" [%1]").arg(seg.name);
+                break;
+            }
+        }
+        lines << QString("%1-%2 (%3 bytes, %4 differ) %5").arg(Hex(span.address, 8), Hex(span.address + span.size - 1, 8))
+                 .arg(span.size).arg(span.bytes).arg(where);
+    }
+    return lines;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include <cstdint>
+#include "savestate.h"
+
+// A machine state with its memory; 'pages' has one bit per SaveStateFile::PageSize page that may hold a
+// non-zero byte, every other page of 'memory' is zero
+struct MachineSnapshot {
+    MachineState state;
+    std::vector<uint8_t> memory;
+    std::vector<uint32_t> pages;
+};
+
+// A register or flag whose value differs; shown with 'digits' hex digits, in decimal if 0
+struct RegisterDiff {
+    QString name;
+    uint64_t before;
+    uint64_t after;
+    int digits;
+};
+
+// A run of differing bytes; runs closer than StateDiff::MergeGap are one span, 'bytes' of its 'size' differ
+struct MemorySpan {
+    int address;
+    int size;
+    int bytes;
+};
+
+// StateDiff: what changed between two snapshots, live or saved. Only the pages marked in either snapshot
+// are compared, 64 bytes per step with SSE2 compares where available; a differing page is then scanned
+// 16 bytes at a time to build the spans.
+class StateDiff {
+public:
+    static const int MergeGap = 16;
+
+    void compare(const MachineSnapshot& before, const MachineSnapshot& after);
+    bool isEmpty() const { return registerDiffs.empty() && memorySpans.empty(); }
+
+    const std::vector<RegisterDiff>& registers() const { return registerDiffs; }
+    const std::vector<MemorySpan>& spans() const { return memorySpans; }
+    int pagesCompared() const { return compared; }
+    int bytesDiffering() const { return differing; }
+
+    // Registers, then at most 'maxSpans' spans, each with the symbol and segment of its start
+    QStringList report(const MachineSnapshot& before, int maxSpans = 200) const;
+
+private:
+    void CompareRegister(const QString& name, uint64_t before, uint64_t after, int digits);
+    void ComparePage(const uint8_t* a, const uint8_t* b, int address, int length);
+    void AddByte(int address);
+
+    std::vector<RegisterDiff> registerDiffs;
+    std::vector<MemorySpan> memorySpans;
+    int compared = 0;
+    int differing = 0;
+};
@@ -0,0 +1,205 @@
+#include <QFile>
+#include <QTextStream>
+#include <QRegExp>
+#include <QStringList>
+#include <algorithm>
+#include "symbols.h"
+
+// Remove all symbols
+void SymbolTable::clear() {
+    symbols.clear();
+    starts.clear();
+    ends.clear();
+    byName.clear();
+}
+
+
+// Add a symbol; finalize() must be called before lookups
+void SymbolTable::add(const QString& name, int address, SymbolKind kind, int size, bool global) {
+    if (name.isEmpty())
+        return;
+    symbols.push_back({ name, address, size, kind, global });
+}
+
+
+// Add the symbols extracted by the loader from the object file
+void SymbolTable::addImported(const std::vector<ImportedSymbol>& imported) {
+    for (const ImportedSymbol& sym : imported) {
+        SymbolKind kind = sym.absolute ? SymbolKind::Absolute
+            : (sym.section == SegmentKind::Text) ? SymbolKind::Code : SymbolKind::Data;
+        add(sym.name, sym.address, kind, sym.size, sym.global);
+    }
+}
+
+
+// Add a generated label for a branch target; real symbols at the same address take precedence
+void SymbolTable::addAutoLabel(int address) {
+    add(QString("L_%1").arg(QString::number(address, 16).toUpper().rightJustified(6, '0')), address, SymbolKind::Label);
+}
+
+
+// Import "name address" or "address name" pairs from a linker map or symbol listing. A plain hex token is
+// only taken as the address when another token on the line is a name, so names such as "facade" are kept;
+// a one-character name is accepted when it is the only one, as in "x = $10" but not "00F03000 T main".
+// Symbols in a text segment are code, in a data or bss segment data, and the others equates; a linker lists
+// the global symbols.
+int SymbolTable::importMapFile(const QString& filename, const std::vector<Segment>& segments, QString* error) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (error) *error = QString("Cannot open %1").arg(filename);
+        return -1;
+    }
+
+    QRegExp identifier("^[A-Za-z_.@][A-Za-z0-9_.@$]*$");
+    QRegExp hexPrefixed("^(\\$|0x|0X)([0-9A-Fa-f]{1,8})$");
+    QRegExp hexPlain("^[0-9A-Fa-f]{6,8}$");
+    QTextStream in(&file);
+    int count = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        int comment = line.indexOf(';');
+        if (comment >= 0)
+            line.truncate(comment);
+        QStringList tokens = line.split(QRegExp("[\\s=:,]+"), QString::SkipEmptyParts);
+
+        // The address: a prefixed hex token, else a plain one that cannot be a name, else one that could
+        int addressToken = -1;
+        int address = 0;
+        for (int i = 0; (i < tokens.size()) && (addressToken < 0); ++i) {
+            if (hexPrefixed.exactMatch(tokens[i])) {
+                addressToken = i;
+                address = static_cast<int>(hexPrefixed.cap(2).toUInt(nullptr, 16));
+            }
+        }
+        for (int pass = 0; (pass < 2) && (addressToken < 0); ++pass) {
+            for (int i = 0; (i < tokens.size()) && (addressToken < 0); ++i) {
+                if (hexPlain.exactMatch(tokens[i]) && ((pass == 1) || !identifier.exactMatch(tokens[i]))) {
+                    addressToken = i;
+                    address = static_cast<int>(tokens[i].toUInt(nullptr, 16));
+                }
+            }
+        }
+        if (addressToken < 0)
+            continue;
+
+        // The name: the first other identifier, preferring those longer than one character
+        QString name;
+        for (int i = 0; i < tokens.size(); ++i) {
+            if ((i == addressToken) || !identifier.exactMatch(tokens[i]))
+                continue;
+            if (tokens[i].size() > 1) {
+                name = tokens[i];
+                break;
+            }
+            if (name.isEmpty())
+                name = tokens[i];
+        }
+        if (name.isEmpty())
+            continue;
+
+        SymbolKind kind = SymbolKind::Absolute;
+        for (const Segment& seg : segments) {
+            if (seg.contains(address)) {
+                kind = (seg.kind == SegmentKind::Text) ? SymbolKind::Code : SymbolKind::Data;
+                break;
+            }
+        }
+        add(name, address, kind, 0, true);
+        ++count;
+    }
+    file.close();
+    return count;
+}
+
+
+// Sort the symbols, keep the best name per address and compute each symbol's interval. Absolute symbols are
+// equates rather than places: they are kept after the others, for name lookup only.
+void SymbolTable::finalize(const std::vector<Segment>& segments) {
+    byName.clear();
+    for (const Symbol& sym : symbols) {
+        if (!byName.contains(sym.name))
+            byName.insert(sym.name, sym.address);
+    }
+
+    // Real symbols before generated labels, code before data at the same address
+    std::stable_sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
+        bool aAbsolute = (a.kind == SymbolKind::Absolute), bAbsolute = (b.kind == SymbolKind::Absolute);
+        if (aAbsolute != bAbsolute) return bAbsolute;
+        if (a.address != b.address) return a.address < b.address;
+        return static_cast<int>(a.kind) < static_cast<int>(b.kind);
+    });
+    symbols.erase(std::unique(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
+        return (a.address == b.address) && (a.kind != SymbolKind::Absolute) && (b.kind != SymbolKind::Absolute);
+    }), symbols.end());
+    size_t indexed = 0;
+    while ((indexed < symbols.size()) && (symbols[indexed].kind != SymbolKind::Absolute))
+        ++indexed;
+
+    starts.resize(indexed);
+    ends.resize(indexed);
+    for (size_t i = 0; i < indexed; ++i) {
+        const Symbol& sym = symbols[i];
+        starts[i] = sym.address;
+        int end = (i + 1 < indexed) ? symbols[i + 1].address : sym.address + 1;
+        const Segment* holder = nullptr;
+        for (const Segment& seg : segments) {
+            if (seg.contains(sym.address)) {
+                holder = &seg;
+                break;
+            }
+        }
+        if (holder) {
+            if ((i + 1 == indexed) || (end > holder->address + holder->size))
+                end = holder->address + holder->size;
+        }
+        else if (sym.size == 0) {
+            end = sym.address + 1;              // out of image symbols only match exactly
+        }
+        if ((sym.size > 0) && (sym.address + sym.size < end))
+            end = sym.address + sym.size;
+        ends[i] = end;
+    }
+}
+
+
+// Find the symbol whose interval covers the address
+const Symbol* SymbolTable::lookup(int address, int* offset) const {
+    auto it = std::upper_bound(starts.begin(), starts.end(), address);
+    if (it == starts.begin())
+        return nullptr;
+    size_t i = (it - starts.begin()) - 1;
+    if (address >= ends[i])
+        return nullptr;
+    if (offset)
+        *offset = address - starts[i];
+    return &symbols[i];
+}
+
+
+// Find the symbol starting exactly at the address
+const Symbol* SymbolTable::at(int address) const {
+    int offset = 0;
+    const Symbol* sym = lookup(address, &offset);
+    return (sym && offset == 0) ? sym : nullptr;
+}
+
+
+// Resolve a symbol name to its address
+bool SymbolTable::find(const QString& name, int& address) const {
+    if (!byName.contains(name))
+        return false;
+    address = byName.value(name);
+    return true;
+}
+
+
+// Format the address as symbol+offset
+QString SymbolTable::symbolize(int address) const {
+    int offset = 0;
+    const Symbol* sym = lookup(address, &offset);
+    if (!sym)
+        return QString("$%1").arg(QString::number(static_cast<uint32_t>(address), 16).toUpper().rightJustified(8, '0'));
+    if (offset == 0)
+        return sym->name;
+    return QString("%1+$%2").arg(sym->name).arg(QString::number(offset, 16).toUpper());
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <QString>
+#include <QHash>
+#include <vector>
+#include "loader.h"
+
+// Origin of a symbol
+enum class SymbolKind { Code, Data, Absolute, Label };
+
+// A named address; 'size' is 0 when the object file does not give it
+struct Symbol {
+    QString name;
+    int address;
+    int size;
+    SymbolKind kind;
+    bool global;        // exported by its module; local labels and generated ones are not
+};
+
+// SymbolTable: symbols from object and map files plus generated branch labels.
+// Address lookups use a sorted interval index and cost O(log n), cheap enough for trace records.
+class SymbolTable {
+public:
+    void clear();
+    void add(const QString& name, int address, SymbolKind kind, int size = 0, bool global = false);
+    void addImported(const std::vector<ImportedSymbol>& imported);
+    void addAutoLabel(int address);
+    int importMapFile(const QString& filename, const std::vector<Segment>& segments, QString* error = nullptr);
+
+    // Sort and build the interval index; intervals never cross a segment end and equates stay out of it
+    void finalize(const std::vector<Segment>& segments);
+
+    // Symbol covering the address, with the distance from its start; nullptr if none
+    const Symbol* lookup(int address, int* offset = nullptr) const;
+    // Symbol starting exactly at the address; nullptr if none
+    const Symbol* at(int address) const;
+    bool find(const QString& name, int& address) const;
+    // "name", "name+$1C" or "$00F03000" when no symbol covers the address
+    QString symbolize(int address) const;
+
+    int size() const { return static_cast<int>(symbols.size()); }
+    const std::vector<Symbol>& all() const { return symbols; }
+
+private:
+    std::vector<Symbol> symbols;    // sorted by address once finalized, absolute symbols last
+    std::vector<int> starts;        // symbol start addresses, for the binary search
+    std::vector<int> ends;          // end of each symbol's interval
+    QHash<QString, int> byName;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// TripleBuffer: lock-free publication of the latest value from one writer thread to one reader thread.
+// The writer fills back() and publish() swaps it with the middle value; the reader's update() swaps the middle
+// value with front() when a newer value was published. Neither side waits or copies, a value is never read while
+// it is written, and values the reader had no time to see are simply overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer: the value to fill before publish()
+    T& back() { return values[backIndex]; }
+    void publish() {
+        backIndex = middle.exchange(static_cast<uint8_t>(backIndex | Fresh), std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Reader: take the newest published value; false if none was published since the last update()
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & Fresh))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+    const T& front() const { return values[frontIndex]; }
+
+private:
+    static const uint8_t IndexMask = 3;
+    static const uint8_t Fresh = 4;     // set in 'middle' by publish(), cleared by update()
+
+    T values[3];
+    alignas(64) std::atomic<uint8_t> middle{ 1 };
+    alignas(64) uint8_t backIndex = 0;  // writer only
+    alignas(64) uint8_t frontIndex = 2; // reader only
+};